@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <object_allocator.hpp>
+
+#include "bench.hpp"
+#include "shared_heap.hpp"
+
+using smallobject::detail::object_allocator;
+
+// on average every SAMPLE_RATE operation is timed, at random intervals so that
+// samples do not fall onto the same positions of a loop, clock read cost is included into the latency
+static const std::size_t SAMPLE_RATE = 16;
+static const std::size_t CHURN_OPS = 1 << 21;
+static const std::size_t CHURN_BATCH = 64;
+static const std::size_t WORKING_SET = 1 << 16;
+static const std::size_t WORKING_SET_OPS = 1 << 21;
+static const std::size_t PC_BATCH = 256;
+static const std::size_t PC_BATCHES = 2048;
+static const std::size_t PC_QUEUE_DEPTH = 64;
+static const std::size_t LARSON_SLOTS = 4096;
+static const std::size_t LARSON_OPS = 1 << 16;
+static const std::size_t LARSON_ROUNDS = 8;
+
+// smallobject allocator, sizes from the smallest to the largest size class
+struct smallobject_heap {
+	static const char* name() {
+		return "smallobject";
+	}
+	static BOOST_FORCEINLINE void* malloc BOOST_PREVENT_MACRO_SUBSTITUTION(const std::size_t size) {
+		return object_allocator::instance()->malloc(size);
+	}
+	static BOOST_FORCEINLINE void free BOOST_PREVENT_MACRO_SUBSTITUTION(void* const ptr, const std::size_t size) {
+		object_allocator::instance()->free(ptr, size);
+	}
+};
+
+// C runtime allocator, baseline
+struct libc_heap {
+	static const char* name() {
+		return "libc";
+	}
+	static BOOST_FORCEINLINE void* malloc BOOST_PREVENT_MACRO_SUBSTITUTION(const std::size_t size) {
+		return std::malloc(size);
+	}
+	static BOOST_FORCEINLINE void free BOOST_PREVENT_MACRO_SUBSTITUTION(void* const ptr, const std::size_t) {
+		std::free(ptr);
+	}
+};
+
+// allocator loaded from a shared library, libraries are measured one after another
+struct loaded_heap {
+	static const char* name() {
+		return _heap.name.c_str();
+	}
+	static BOOST_FORCEINLINE void* malloc BOOST_PREVENT_MACRO_SUBSTITUTION(const std::size_t size) {
+		return _heap.do_malloc(size);
+	}
+	static BOOST_FORCEINLINE void free BOOST_PREVENT_MACRO_SUBSTITUTION(void* const ptr, const std::size_t) {
+		_heap.do_free(ptr);
+	}
+	static bench::shared_heap _heap;
+};
+
+bench::shared_heap loaded_heap::_heap;
+
+static std::size_t size_class_bytes(const std::size_t size_class)
+{
+	return object_allocator::MAX_SIZE - (object_allocator::size_classes() - 1 - size_class) * sizeof(std::size_t);
+}
+
+static inline std::size_t random_size(bench::xorshift& rnd)
+{
+	return size_class_bytes( rnd.next( object_allocator::size_classes() ) );
+}
+
+// counts operations of a worker thread and samples their latency
+template<class H>
+class timed_heap {
+public:
+	timed_heap():
+		ops_(0),
+		countdown_(1),
+		rnd_(),
+		malloc_ns_(),
+		free_ns_()
+	{}
+	BOOST_FORCEINLINE void* malloc BOOST_PREVENT_MACRO_SUBSTITUTION(const std::size_t size) {
+		if( !sample() )
+			return touch( H::malloc(size), size );
+		bench::stopwatch sw;
+		void* result = H::malloc(size);
+		malloc_ns_.push_back( static_cast<uint32_t>( sw.elapsed_ns() ) );
+		return touch(result, size);
+	}
+	BOOST_FORCEINLINE void free BOOST_PREVENT_MACRO_SUBSTITUTION(void* const ptr, const std::size_t size) {
+		if( !sample() ) {
+			H::free(ptr, size);
+			return;
+		}
+		bench::stopwatch sw;
+		H::free(ptr, size);
+		free_ns_.push_back( static_cast<uint32_t>( sw.elapsed_ns() ) );
+	}
+	inline uint64_t ops() const {
+		return ops_;
+	}
+	inline std::vector<uint32_t>& malloc_ns() {
+		return malloc_ns_;
+	}
+	inline std::vector<uint32_t>& free_ns() {
+		return free_ns_;
+	}
+private:
+	BOOST_FORCEINLINE bool sample() {
+		++ops_;
+		if( 0 != --countdown_ )
+			return false;
+		countdown_ = 1 + rnd_.next(SAMPLE_RATE * 2 - 1);
+		return true;
+	}
+	// writes the first word as a real program does
+	static BOOST_FORCEINLINE void* touch(void* const ptr, const std::size_t size) {
+		std::memset(ptr, 0, sizeof(std::size_t) );
+		bench::do_not_optimize(size);
+		return ptr;
+	}
+private:
+	uint64_t ops_;
+	std::size_t countdown_;
+	bench::xorshift rnd_;
+	std::vector<uint32_t> malloc_ns_;
+	std::vector<uint32_t> free_ns_;
+};
+
+struct result {
+	std::string scenario;
+	std::size_t threads;
+	std::size_t size;
+	uint64_t ops;
+	double ns;
+	std::size_t rss;
+	bench::percentiles malloc_latency;
+	bench::percentiles free_latency;
+};
+
+// merges operation counters and latency samples of the worker threads
+template<class H>
+class collector {
+public:
+	explicit collector(const std::size_t threads):
+		heaps_(threads)
+	{}
+	inline timed_heap<H>& operator[](const std::size_t thread) {
+		return heaps_[thread];
+	}
+	result finish(const char* scenario, const std::size_t size, const double ns, const std::size_t rss) {
+		result r;
+		r.scenario = scenario;
+		r.threads = heaps_.size();
+		r.size = size;
+		r.ops = 0;
+		r.ns = ns;
+		r.rss = rss;
+		std::vector<uint32_t> malloc_ns, free_ns;
+		for(std::size_t i = 0; i < heaps_.size(); i++) {
+			r.ops += heaps_[i].ops();
+			malloc_ns.insert( malloc_ns.end(), heaps_[i].malloc_ns().begin(), heaps_[i].malloc_ns().end() );
+			free_ns.insert( free_ns.end(), heaps_[i].free_ns().begin(), heaps_[i].free_ns().end() );
+		}
+		r.malloc_latency = bench::summarize(malloc_ns);
+		r.free_latency = bench::summarize(free_ns);
+		return r;
+	}
+private:
+	std::vector< timed_heap<H> > heaps_;
+};
+
+template<class F>
+static double run_threads(const std::size_t threads, F routine)
+{
+	std::vector<std::thread> workers;
+	workers.reserve(threads);
+	bench::stopwatch sw;
+	for(std::size_t i = 0; i < threads; i++)
+		workers.push_back( std::thread(routine, i) );
+	for(std::size_t i = 0; i < threads; i++)
+		workers[i].join();
+	return sw.elapsed_ns();
+}
+
+// allocates a batch of objects and releases it in reverse order, size 0 means random sizes
+template<class H>
+static BOOST_NOINLINE result churn(const char* scenario, const std::size_t threads, const std::size_t size)
+{
+	collector<H> stat(threads);
+	const double ns = run_threads(threads, [&stat, size] (const std::size_t id) {
+		timed_heap<H>& heap = stat[id];
+		bench::xorshift rnd(id + 1);
+		void* ptrs[CHURN_BATCH];
+		std::size_t sizes[CHURN_BATCH];
+		for(std::size_t op = 0; op < CHURN_OPS; op += CHURN_BATCH * 2) {
+			for(std::size_t i = 0; i < CHURN_BATCH; i++) {
+				sizes[i] = 0 != size ? size : random_size(rnd);
+				ptrs[i] = heap.malloc( sizes[i] );
+			}
+			for(std::size_t i = CHURN_BATCH; i > 0; i--)
+				heap.free( ptrs[i-1], sizes[i-1] );
+		}
+	});
+	return stat.finish(scenario, size, ns, bench::rss_bytes() );
+}
+
+struct block {
+	void* ptr;
+	std::size_t size;
+};
+
+typedef std::vector<block> blocks;
+
+// bounded queue of the allocated blocks batches
+class batch_queue {
+public:
+	batch_queue():
+		mtx_(),
+		not_empty_(),
+		not_full_(),
+		batches_(),
+		producers_(0)
+	{}
+	void start_producer() {
+		std::lock_guard<std::mutex> lock(mtx_);
+		++producers_;
+	}
+	void stop_producer() {
+		std::lock_guard<std::mutex> lock(mtx_);
+		--producers_;
+		not_empty_.notify_all();
+	}
+	void push(blocks&& batch) {
+		std::unique_lock<std::mutex> lock(mtx_);
+		not_full_.wait(lock, [this] { return batches_.size() < PC_QUEUE_DEPTH; } );
+		batches_.push_back( std::move(batch) );
+		not_empty_.notify_one();
+	}
+	// returns false when all producers have finished and queue is empty
+	bool pop(blocks& batch) {
+		std::unique_lock<std::mutex> lock(mtx_);
+		not_empty_.wait(lock, [this] { return !batches_.empty() || 0 == producers_; } );
+		if( batches_.empty() )
+			return false;
+		batch = std::move( batches_.front() );
+		batches_.pop_front();
+		not_full_.notify_one();
+		return true;
+	}
+private:
+	std::mutex mtx_;
+	std::condition_variable not_empty_;
+	std::condition_variable not_full_;
+	std::deque<blocks> batches_;
+	std::size_t producers_;
+};
+
+// half of threads allocate, other half release the memory allocated by producers
+template<class H>
+static BOOST_NOINLINE result producer_consumer(const std::size_t pairs)
+{
+	collector<H> stat(pairs * 2);
+	batch_queue queue;
+	for(std::size_t i = 0; i < pairs; i++)
+		queue.start_producer();
+	const double ns = run_threads(pairs * 2, [&stat, &queue, pairs] (const std::size_t id) {
+		timed_heap<H>& heap = stat[id];
+		if(id < pairs) {
+			bench::xorshift rnd(id + 1);
+			for(std::size_t b = 0; b < PC_BATCHES; b++) {
+				blocks batch;
+				batch.reserve(PC_BATCH);
+				for(std::size_t i = 0; i < PC_BATCH; i++) {
+					const std::size_t size = random_size(rnd);
+					block blk = { heap.malloc(size), size };
+					batch.push_back(blk);
+				}
+				queue.push( std::move(batch) );
+			}
+			queue.stop_producer();
+		} else {
+			blocks batch;
+			while( queue.pop(batch) ) {
+				for(blocks::const_iterator it = batch.begin(); it != batch.end(); ++it)
+					heap.free(it->ptr, it->size);
+			}
+		}
+	});
+	return stat.finish("producer_consumer", 0, ns, bench::rss_bytes() );
+}
+
+// replaces random objects of a per thread working set, objects have random lifetime
+template<class H>
+static BOOST_NOINLINE result random_lifetime(const std::size_t threads)
+{
+	collector<H> stat(threads);
+	std::vector<blocks> sets(threads);
+	std::size_t rss = 0;
+	std::mutex rss_mtx;
+	const double ns = run_threads(threads, [&stat, &sets, &rss, &rss_mtx] (const std::size_t id) {
+		timed_heap<H>& heap = stat[id];
+		blocks& set = sets[id];
+		bench::xorshift rnd(id + 1);
+		set.reserve(WORKING_SET);
+		for(std::size_t i = 0; i < WORKING_SET; i++) {
+			const std::size_t size = random_size(rnd);
+			block blk = { heap.malloc(size), size };
+			set.push_back(blk);
+		}
+		for(std::size_t i = 0; i < WORKING_SET_OPS; i += 2) {
+			block& blk = set[ rnd.next(WORKING_SET) ];
+			heap.free(blk.ptr, blk.size);
+			blk.size = random_size(rnd);
+			blk.ptr = heap.malloc(blk.size);
+		}
+		// working set is live
+		std::lock_guard<std::mutex> lock(rss_mtx);
+		rss = std::max( rss, bench::rss_bytes() );
+	});
+	for(std::size_t t = 0; t < threads; t++) {
+		for(blocks::const_iterator it = sets[t].begin(); it != sets[t].end(); ++it)
+			H::free(it->ptr, it->size);
+	}
+	return stat.finish("random_lifetime", 0, ns, rss);
+}
+
+// Larson and Krishnan server simulation, every round a new generation of threads
+// takes over the objects allocated by the previous one, and replaces them in random order
+template<class H>
+static BOOST_NOINLINE result larson(const std::size_t threads)
+{
+	collector<H> stat(threads);
+	blocks slots(threads * LARSON_SLOTS);
+	bench::xorshift init(threads);
+	for(blocks::iterator it = slots.begin(); it != slots.end(); ++it) {
+		it->size = random_size(init);
+		it->ptr = H::malloc(it->size);
+	}
+	double ns = 0;
+	for(std::size_t round = 0; round < LARSON_ROUNDS; round++) {
+		ns += run_threads(threads, [&stat, &slots, threads, round] (const std::size_t id) {
+			timed_heap<H>& heap = stat[id];
+			block* const own = slots.data() + ( (id + round) % threads ) * LARSON_SLOTS;
+			bench::xorshift rnd( (round + 1) * (id + 1) );
+			for(std::size_t i = 0; i < LARSON_OPS; i += 2) {
+				block& blk = own[ rnd.next(LARSON_SLOTS) ];
+				heap.free(blk.ptr, blk.size);
+				blk.size = random_size(rnd);
+				blk.ptr = heap.malloc(blk.size);
+			}
+		});
+	}
+	const std::size_t rss = bench::rss_bytes();
+	for(blocks::const_iterator it = slots.begin(); it != slots.end(); ++it)
+		H::free(it->ptr, it->size);
+	return stat.finish("larson", 0, ns, rss);
+}
+
+static void print_latency(const char* name, const bench::percentiles& p)
+{
+	std::printf("\"%s\":{\"samples\":%zu,\"p50\":%.0f,\"p90\":%.0f,\"p99\":%.0f,\"p999\":%.0f,\"max\":%.0f}",
+				name, p.samples, p.p50, p.p90, p.p99, p.p999, p.max);
+}
+
+static void print_result(const char* heap, const result& r, const bool first)
+{
+	std::printf("%s\n\t\t{\"heap\":\"%s\",\"scenario\":\"%s\",\"threads\":%zu,\"size\":%zu,\"ops\":%llu,\"ops_per_sec\":%.0f,\"rss_kb\":%zu,\"latency_ns\":{",
+				first ? "" : ",", heap, r.scenario.c_str(), r.threads, r.size,
+				static_cast<unsigned long long>(r.ops), r.ops / r.ns * 1E9, r.rss / 1024);
+	print_latency("malloc", r.malloc_latency);
+	std::fputc(',', stdout);
+	print_latency("free", r.free_latency);
+	std::fputs("}}", stdout);
+}
+
+typedef std::vector<std::string> scenarios;
+
+static bool selected(const scenarios& filter, const char* scenario)
+{
+	return filter.empty() || filter.end() != std::find( filter.begin(), filter.end(), scenario );
+}
+
+struct heap_results {
+	std::string heap;
+	std::vector<result> results;
+};
+
+template<class H>
+static heap_results run_all(const scenarios& filter, const std::size_t max_threads)
+{
+	heap_results hr;
+	hr.heap = H::name();
+	std::vector<result>& results = hr.results;
+	if( selected(filter, "churn") )
+		results.push_back( churn<H>("churn", 1, 0) );
+	if( selected(filter, "thread_sweep") ) {
+		for(std::size_t threads = 1; threads <= max_threads; threads <<= 1)
+			results.push_back( churn<H>("thread_sweep", threads, 0) );
+	}
+	if( selected(filter, "producer_consumer") ) {
+		for(std::size_t pairs = 1; pairs * 2 <= max_threads; pairs <<= 1)
+			results.push_back( producer_consumer<H>(pairs) );
+	}
+	if( selected(filter, "random_lifetime") ) {
+		results.push_back( random_lifetime<H>(1) );
+		results.push_back( random_lifetime<H>(max_threads) );
+	}
+	if( selected(filter, "larson") )
+		results.push_back( larson<H>(max_threads) );
+	if( selected(filter, "size_class") ) {
+		for(std::size_t i = 0; i < object_allocator::size_classes(); i++)
+			results.push_back( churn<H>("size_class", 1, size_class_bytes(i) ) );
+	}
+	return hr;
+}
+
+// prints the same run of every heap side by side, all heaps run identical scenarios
+static void print_comparison(const std::vector<heap_results>& heaps)
+{
+	const std::vector<result>& runs = heaps.front().results;
+	for(std::size_t i = 0; i < runs.size(); i++) {
+		std::printf("%s\n\t\t{\"scenario\":\"%s\",\"threads\":%zu,\"size\":%zu,\"ops_per_sec\":{",
+					0 == i ? "" : ",", runs[i].scenario.c_str(), runs[i].threads, runs[i].size);
+		for(std::size_t h = 0; h < heaps.size(); h++) {
+			const result& r = heaps[h].results[i];
+			std::printf("%s\"%s\":%.0f", 0 == h ? "" : ",", heaps[h].heap.c_str(), r.ops / r.ns * 1E9);
+		}
+		std::fputs("},\"rss_kb\":{", stdout);
+		for(std::size_t h = 0; h < heaps.size(); h++)
+			std::printf("%s\"%s\":%zu", 0 == h ? "" : ",", heaps[h].heap.c_str(), heaps[h].results[i].rss / 1024);
+		std::fputs("},\"malloc_p99_ns\":{", stdout);
+		for(std::size_t h = 0; h < heaps.size(); h++)
+			std::printf("%s\"%s\":%.0f", 0 == h ? "" : ",", heaps[h].heap.c_str(), heaps[h].results[i].malloc_latency.p99);
+		std::fputs("}}", stdout);
+	}
+}
+
+// usage: allocator_bench [churn] [thread_sweep] [producer_consumer] [random_lifetime] [larson] [size_class] [--heap <allocator shared library>]...
+// without scenario arguments runs all scenarios, prints results as JSON.
+// Scenarios run against smallobject, the system allocator, and every allocator shared library given with --heap,
+// or installed jemalloc, tcmalloc and mimalloc when no library is given.
+// Libraries are loaded with dlopen, so that the process malloc stays the system one
+int main(int argc, const char** argv)
+{
+	std::size_t max_threads = std::thread::hardware_concurrency();
+	if(max_threads < 4)
+		max_threads = 4;
+	scenarios filter;
+	std::vector<bench::shared_heap> libraries;
+	bool explicit_libraries = false;
+	for(int i = 1; i < argc; i++) {
+		if( 0 != std::strcmp(argv[i], "--heap") ) {
+			filter.push_back(argv[i]);
+			continue;
+		}
+		if(++i == argc)
+			break;
+		explicit_libraries = true;
+		bench::shared_heap lib;
+		if( bench::load_shared_heap( bench::shared_heap_name(argv[i]).c_str(), argv[i], lib) )
+			libraries.push_back(lib);
+		else
+			std::fprintf(stderr, "can not load allocator %s\n", argv[i]);
+	}
+	if(!explicit_libraries)
+		libraries = bench::find_shared_heaps();
+	std::vector<heap_results> heaps;
+	heaps.push_back( run_all<smallobject_heap>(filter, max_threads) );
+	heaps.push_back( run_all<libc_heap>(filter, max_threads) );
+	for(std::size_t i = 0; i < libraries.size(); i++) {
+		loaded_heap::_heap = libraries[i];
+		heaps.push_back( run_all<loaded_heap>(filter, max_threads) );
+	}
+	std::printf("{\n\t\"benchmark\":\"allocator_bench\",\n\t\"sample_rate\":%zu,\n\t\"heaps\":[", SAMPLE_RATE);
+	for(std::size_t h = 0; h < heaps.size(); h++)
+		std::printf("%s\"%s\"", 0 == h ? "" : ",", heaps[h].heap.c_str() );
+	std::printf("],\n\t\"results\":[");
+	bool first = true;
+	for(std::size_t h = 0; h < heaps.size(); h++) {
+		for(std::vector<result>::const_iterator it = heaps[h].results.begin(); it != heaps[h].results.end(); ++it) {
+			print_result(heaps[h].heap.c_str(), *it, first);
+			first = false;
+		}
+	}
+	std::printf("\n\t],\n\t\"comparison\":[");
+	print_comparison(heaps);
+	std::printf("\n\t]\n}\n");
+	return 0;
+}
@@ -0,0 +1,262 @@
+#ifndef __SMALLOBJECT_BENCH_HPP_INCLUDED__
+#define __SMALLOBJECT_BENCH_HPP_INCLUDED__
+
+#include <boost/config.hpp>
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#ifdef __linux__
+#	include <time.h>
+#	include <unistd.h>
+#endif // __linux__
+
+#if defined(__x86_64__) || defined(__i386__)
+#	include <x86intrin.h>
+#endif // x86
+
+namespace bench {
+
+/// Prevents compiler to eliminate a computation result
+template<typename T>
+BOOST_FORCEINLINE void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile const T* sink;
+	sink = &value;
+#endif // __GNUC__
+}
+
+/// Monotonic wall clock stopwatch
+class stopwatch {
+public:
+	stopwatch():
+		start_( std::chrono::steady_clock::now() )
+	{}
+	inline void restart() {
+		start_ = std::chrono::steady_clock::now();
+	}
+	/// \return elapsed time in nanoseconds
+	inline double elapsed_ns() const {
+		return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start_ ).count();
+	}
+private:
+	std::chrono::steady_clock::time_point start_;
+};
+
+/// Fast xorshift pseudo random generator, good enough for benchmark inputs
+class xorshift {
+public:
+	explicit xorshift(uint64_t seed = 0x9E3779B97F4A7C15ULL):
+		state_(seed ? seed : 1)
+	{}
+	inline uint64_t next() {
+		state_ ^= state_ << 13;
+		state_ ^= state_ >> 7;
+		state_ ^= state_ << 17;
+		return state_;
+	}
+	inline std::size_t next(const std::size_t bound) {
+		return static_cast<std::size_t>( next() % bound );
+	}
+private:
+	uint64_t state_;
+};
+
+/// Latency percentiles of a sampled operation, in nanoseconds
+struct percentiles {
+	std::size_t samples;
+	double p50;
+	double p90;
+	double p99;
+	double p999;
+	double max;
+};
+
+/// Computes percentiles of the latency samples, samples are sorted in place
+inline percentiles summarize(std::vector<uint32_t>& samples)
+{
+	percentiles result = {samples.size(), 0, 0, 0, 0, 0};
+	if( samples.empty() )
+		return result;
+	std::sort( samples.begin(), samples.end() );
+	const std::size_t last = samples.size() - 1;
+	result.p50 = samples[ last * 50 / 100 ];
+	result.p90 = samples[ last * 90 / 100 ];
+	result.p99 = samples[ last * 99 / 100 ];
+	result.p999 = samples[ last * 999 / 1000 ];
+	result.max = samples[last];
+	return result;
+}
+
+/// Cheap clock for timing of a single call, time stamp counter on x86 and
+/// monotonic clock_gettime elsewhere
+class tick_clock {
+public:
+	static BOOST_FORCEINLINE uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#elif defined(__linux__)
+		struct timespec ts;
+		::clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#else
+		return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch() ).count() );
+#endif // x86
+	}
+	/// Measures ticks per nanosecond against the steady clock, takes about 20 milliseconds
+	static double ticks_per_ns() {
+		stopwatch sw;
+		const uint64_t start = now();
+		while( sw.elapsed_ns() < 20000000.0 )
+			;
+		const uint64_t ticks = now() - start;
+		return ticks / sw.elapsed_ns();
+	}
+};
+
+/// \brief Hook around measured regions, i.e. to read hardware performance counters
+class region_hook {
+public:
+	virtual ~region_hook()
+	{}
+	/// Called before the region starts
+	virtual void begin(const char* region) = 0;
+	/// Called after the region ends
+	/// \param ops count of operations done in the region
+	virtual void end(const char* region, const uint64_t ops) = 0;
+};
+
+/// \return hook installed for the measured regions, or NULL when there is no hook
+inline region_hook*& current_region_hook()
+{
+	static region_hook* hook = NULL;
+	return hook;
+}
+
+/// Measures a region with tick_clock, and calls the installed region hook around it
+/// \return ticks elapsed
+template<class F>
+inline uint64_t measure_region(const char* region, const uint64_t ops, F routine)
+{
+	region_hook* const hook = current_region_hook();
+	if(NULL != hook)
+		hook->begin(region);
+	const uint64_t start = tick_clock::now();
+	routine();
+	const uint64_t ticks = tick_clock::now() - start;
+	if(NULL != hook)
+		hook->end(region, ops);
+	return ticks;
+}
+
+/**
+ * \brief Log-linear histogram of non negative integer values, in the manner of HdrHistogram.
+ *  Values below 2 * HALF are counted exactly, greater values are counted in buckets
+ *  of the relative width 1 / HALF, so that every percentile has bounded relative error.
+ */
+class histogram {
+private:
+	static const unsigned SUB_BITS = 6;
+	static const uint64_t HALF = uint64_t(1) << (SUB_BITS - 1);
+	static const std::size_t BUCKETS = HALF * (64 - SUB_BITS + 1) + HALF * 2;
+public:
+	histogram():
+		total_(0),
+		max_(0)
+	{
+		std::fill(counts_, counts_ + BUCKETS, 0);
+	}
+	inline void record(const uint64_t value) {
+		++counts_[ index(value) ];
+		++total_;
+		if(value > max_)
+			max_ = value;
+	}
+	void merge(const histogram& other) {
+		for(std::size_t i = 0; i < BUCKETS; i++)
+			counts_[i] += other.counts_[i];
+		total_ += other.total_;
+		if(other.max_ > max_)
+			max_ = other.max_;
+	}
+	inline uint64_t count() const {
+		return total_;
+	}
+	inline uint64_t max() const {
+		return max_;
+	}
+	/// \return highest value equivalent to the value at the quantile, from 0 to 1
+	uint64_t percentile(const double quantile) const {
+		if(0 == total_)
+			return 0;
+		uint64_t rank = static_cast<uint64_t>( quantile * total_ + 0.5 );
+		if(rank < 1)
+			rank = 1;
+		uint64_t seen = 0;
+		for(std::size_t i = 0; i < BUCKETS; i++) {
+			seen += counts_[i];
+			if(seen >= rank)
+				return std::min( highest_equivalent(i), max_ );
+		}
+		return max_;
+	}
+	/// \return count of recorded values greater than the value
+	uint64_t count_above(const uint64_t value) const {
+		uint64_t result = 0;
+		for(std::size_t i = index(value) + 1; i < BUCKETS; i++)
+			result += counts_[i];
+		return result;
+	}
+private:
+	static inline std::size_t index(const uint64_t value) {
+		if(value < HALF * 2)
+			return static_cast<std::size_t>(value);
+#if defined(__GNUC__) || defined(__clang__)
+		const unsigned msb = 63 - static_cast<unsigned>( __builtin_clzll(value) );
+#else
+		unsigned msb = 63;
+		while( 0 == (value & (uint64_t(1) << msb) ) )
+			--msb;
+#endif // __GNUC__
+		const unsigned shift = msb - (SUB_BITS - 1);
+		return static_cast<std::size_t>( HALF * shift + (value >> shift) );
+	}
+	static inline uint64_t highest_equivalent(const std::size_t idx) {
+		if(idx < HALF * 2)
+			return idx;
+		const unsigned shift = static_cast<unsigned>(idx / HALF) - 1;
+		const uint64_t lowest = ( (idx % HALF) + HALF ) << shift;
+		return lowest + ( (uint64_t(1) << shift) - 1 );
+	}
+private:
+	uint64_t counts_[BUCKETS];
+	uint64_t total_;
+	uint64_t max_;
+};
+
+/// \return resident set size of the process in bytes, or 0 when it is unknown
+inline std::size_t rss_bytes()
+{
+#ifdef __linux__
+	std::FILE* f = std::fopen("/proc/self/statm", "r");
+	if(NULL == f)
+		return 0;
+	unsigned long size = 0, resident = 0;
+	const int read = std::fscanf(f, "%lu %lu", &size, &resident);
+	std::fclose(f);
+	return 2 == read ? resident * static_cast<std::size_t>( ::sysconf(_SC_PAGESIZE) ) : 0;
+#else
+	return 0;
+#endif // __linux__
+}
+
+} // namespace bench
+
+#endif // __SMALLOBJECT_BENCH_HPP_INCLUDED__
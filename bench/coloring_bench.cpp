@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <object_allocator.hpp>
+#include <perf_counters.hpp>
+#include <sys_allocator.hpp>
+
+#include "bench.hpp"
+
+using smallobject::detail::chunk;
+using smallobject::detail::object_allocator;
+
+static const std::size_t CHUNKS = 1024;
+// blocks in an emulated chunk
+static const std::size_t CHUNK_BLOCKS = 255;
+// chunks of the allocator grow up to _SOBJ_MAX_CHUNK_SIZE, so less of them are walked
+static const std::size_t ALLOCATOR_CHUNKS = 64;
+static const std::size_t WALKS = 256;
+static const std::size_t PAGE = 4096;
+// sets of a typical 32 KiB 8 way L1 data cache
+static const std::size_t L1_SETS = 64;
+
+// walks the first blocks of the chunks in a random cyclic order, every block holds the next one address
+class chase {
+public:
+	explicit chase(std::vector<void*>& blocks):
+		head_(NULL)
+	{
+		bench::xorshift rnd( blocks.size() );
+		for(std::size_t i = blocks.size() - 1; i > 0; i--)
+			std::swap( blocks[i], blocks[ rnd.next(i + 1) ] );
+		for(std::size_t i = 0; i < blocks.size(); i++)
+			*static_cast<void**>(blocks[i]) = blocks[ (i + 1) % blocks.size() ];
+		head_ = blocks.front();
+	}
+	// \return ticks per access, and fills L1 data cache misses per access when counters are available
+	double run(const std::size_t accesses, double& l1d_misses) const {
+		smallobject::perf_values before, after;
+		smallobject::perf_counters::read(before);
+		const uint64_t start = bench::tick_clock::now();
+		void* p = head_;
+		for(std::size_t i = 0; i < accesses; i++)
+			p = *static_cast<void**>(p);
+		const uint64_t ticks = bench::tick_clock::now() - start;
+		bench::do_not_optimize(p);
+		smallobject::perf_counters::read(after);
+		l1d_misses = static_cast<double>(after.values[smallobject::L1D_MISSES] - before.values[smallobject::L1D_MISSES]) / accesses;
+		return static_cast<double>(ticks) / accesses;
+	}
+private:
+	void* head_;
+};
+
+// \return count of distinct L1 cache sets the blocks map to, and the largest count of blocks in a set
+static std::size_t cache_sets(const std::vector<void*>& blocks, std::size_t& max_per_set)
+{
+	std::vector<std::size_t> sets(L1_SETS, 0);
+	for(std::size_t i = 0; i < blocks.size(); i++)
+		++sets[ (reinterpret_cast<std::size_t>(blocks[i]) / SO_CACHE_LINE_SIZE) % L1_SETS ];
+	max_per_set = *std::max_element( sets.begin(), sets.end() );
+	return L1_SETS - std::count( sets.begin(), sets.end(), std::size_t(0) );
+}
+
+static void print(const char* source, const std::size_t block_size, const std::size_t colors, std::vector<void*>& blocks, bool& first)
+{
+	std::size_t max_per_set = 0;
+	const std::size_t sets = cache_sets(blocks, max_per_set);
+	chase walk(blocks);
+	double l1d_misses = 0;
+	// warm up
+	walk.run(blocks.size(), l1d_misses);
+	const double ticks = walk.run(blocks.size() * WALKS, l1d_misses);
+	std::printf("%s\n\t\t{\"source\":\"%s\",\"block_size\":%zu,\"colors\":%zu,\"chunks\":%zu,\"l1_sets_used\":%zu,\"max_chunks_per_set\":%zu,"
+				"\"ticks_per_access\":%.2f,\"l1d_misses_per_access\":%.3f}",
+				first ? "" : ",", source, block_size, colors, blocks.size(), sets, max_per_set, ticks, l1d_misses);
+	first = false;
+}
+
+// chunks laid out as an allocator returning page aligned memory would do, i.e. an mmap based system allocator,
+// with the payload shifted by the color offset
+static void page_aligned(const std::size_t block_size, const std::size_t colors, bool& first)
+{
+	const std::size_t bytes = ( (chunk::header_size(CHUNK_BLOCKS) + (colors - 1) * SO_CACHE_LINE_SIZE + block_size * CHUNK_BLOCKS + PAGE - 1) / PAGE ) * PAGE;
+	std::vector<void*> regions(CHUNKS);
+	std::vector<void*> blocks(CHUNKS);
+	for(std::size_t i = 0; i < CHUNKS; i++) {
+		if( 0 != ::posix_memalign(&regions[i], PAGE, bytes) )
+			std::abort();
+		blocks[i] = static_cast<uint8_t*>(regions[i]) + chunk::header_size(CHUNK_BLOCKS) + (i % colors) * SO_CACHE_LINE_SIZE;
+	}
+	print("page_aligned", block_size, colors, blocks, first);
+	for(std::size_t i = 0; i < CHUNKS; i++)
+		std::free(regions[i]);
+}
+
+// first blocks of the chunks of the allocator, chunks are allocated by the calling thread
+// so that blocks are allocated in the chunk order, starting from a fresh chunk.
+// Blocks of a fresh chunk are contiguous, a gap means the next chunk
+static void allocator(const std::size_t block_size, bool& first)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	std::vector<void*> all;
+	std::vector<void*> blocks;
+	blocks.reserve(ALLOCATOR_CHUNKS);
+	// fills the current chunk, so that next allocation creates a new chunk
+	void* prev = alloc->malloc(block_size);
+	all.push_back(prev);
+	while( blocks.size() < ALLOCATOR_CHUNKS ) {
+		void* ptr = alloc->malloc(block_size);
+		all.push_back(ptr);
+		const std::ptrdiff_t distance = static_cast<uint8_t*>(ptr) - static_cast<uint8_t*>(prev);
+		prev = ptr;
+		if( distance != static_cast<std::ptrdiff_t>(block_size) )
+			blocks.push_back(ptr);
+	}
+	print("smallobject", block_size, _SOBJ_CHUNK_COLORS, blocks, first);
+	for(std::size_t i = 0; i < all.size(); i++)
+		alloc->free(all[i], block_size);
+}
+
+// touches the first block of many chunks, and prints how many L1 cache sets the blocks map to,
+// access cost and L1 data cache misses per access when hardware counters are available.
+// page_aligned rows compare uncolored and colored chunks placed at page boundaries, the worst case for set conflicts,
+// smallobject rows show the chunks of this library build, compare builds with -D_SOBJ_CHUNK_COLORS=1 and the default
+int main()
+{
+	std::printf("{\n\t\"benchmark\":\"coloring_bench\",\n\t\"counters\":%s,\n\t\"results\":[",
+				smallobject::perf_counters::available() ? "true" : "false");
+	bool first = true;
+	static const std::size_t SIZES[] = {16, 64, 128};
+	for(std::size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++) {
+		page_aligned(SIZES[i], 1, first);
+		page_aligned(SIZES[i], _SOBJ_CHUNK_COLORS, first);
+		page_aligned(SIZES[i], L1_SETS, first);
+		allocator(SIZES[i], first);
+	}
+	std::printf("\n\t]\n}\n");
+	return 0;
+}
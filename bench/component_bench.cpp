@@ -0,0 +1,272 @@
+#include <cassert>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include <boost/thread/tss.hpp>
+
+#include <sys_allocator.hpp>
+#include <chunk.hpp>
+#include <critical_section.hpp>
+#include <distributed_rwb.hpp>
+#include <lockfreelist.hpp>
+#include <range_map.hpp>
+#include <rw_barrier.hpp>
+
+#include "bench.hpp"
+#include "perf_hook.hpp"
+
+using smallobject::detail::chunk;
+
+static const std::size_t CHUNK_ROUNDS = 1 << 13;
+static const std::size_t CHUNK_BLOCKS = UCHAR_MAX;
+static const std::size_t MAP_LOOKUPS = 1 << 20;
+static const std::size_t LIST_PUSHES = 1 << 16;
+static const std::size_t LOCK_ROUNDS = 1 << 20;
+static const std::size_t CONTENDED_LOCK_ROUNDS = 1 << 18;
+static const std::size_t TSS_READS = 1 << 22;
+
+static double _ticks_per_ns = 1.0;
+static bench::perf_region_hook* _counters = NULL;
+
+// prints a table row, with hardware counters per operation of the region when they are available
+static void print(const char* component, const char* operation, const char* region, const std::size_t param, const uint64_t ticks, const uint64_t ops)
+{
+	const double per_op = static_cast<double>(ticks) / ops;
+	std::cout << std::setw(18) << component << std::setw(16) << operation << std::setw(10) << param
+		<< std::fixed << std::setprecision(2)
+		<< std::setw(14) << per_op << std::setw(12) << per_op / _ticks_per_ns;
+	bench::region_counters rc;
+	if( NULL != _counters && _counters->take(region, rc) ) {
+		for(std::size_t i = 0; i < smallobject::PERF_COUNTERS_COUNT; i++)
+			std::cout << std::setw(14) << static_cast<double>(rc.counters.values[i]) / rc.ops;
+	}
+	std::cout << std::endl;
+}
+
+// runs a routine in threads at once, returns wall ticks multiplied by threads,
+// i.e. the ticks spent by every thread. Every thread measures its own part of the region,
+// so that hardware counters of all threads are summed
+template<class F>
+static uint64_t run_threads(const char* region, const std::size_t threads, const uint64_t ops, F routine)
+{
+	const uint64_t start = bench::tick_clock::now();
+	std::vector<std::thread> workers;
+	workers.reserve(threads);
+	for(std::size_t i = 0; i < threads; i++) {
+		workers.push_back( std::thread( [region, threads, ops, &routine, i] () {
+			bench::measure_region(region, ops / threads, [&routine, i] () {
+				routine(i);
+			} );
+		} ) );
+	}
+	for(std::size_t i = 0; i < threads; i++)
+		workers[i].join();
+	return threads * (bench::tick_clock::now() - start);
+}
+
+// chunk allocate and release, CHUNK_BLOCKS blocks are in the chunk, all blocks of a chunk are allocated and released in LIFO or random order
+static void chunk_bench(const std::size_t block_size)
+{
+	const std::size_t bytes = chunk::header_size(CHUNK_BLOCKS) + block_size * CHUNK_BLOCKS;
+	// chunk header takes whole cache lines
+	void* mem = smallobject::sys::xmalloc_aligned(bytes, SO_CACHE_LINE_SIZE);
+	chunk* cnk = new (mem) chunk( block_size, CHUNK_BLOCKS, static_cast<uint8_t*>(mem) + chunk::header_size(CHUNK_BLOCKS), bytes );
+	uint8_t* blocks[CHUNK_BLOCKS];
+	const uint64_t ops = CHUNK_ROUNDS * CHUNK_BLOCKS;
+	uint64_t alloc_ticks = 0, release_ticks = 0;
+	for(std::size_t r = 0; r < CHUNK_ROUNDS; r++) {
+		alloc_ticks += bench::measure_region("chunk::allocate", CHUNK_BLOCKS, [cnk, &blocks, block_size] () {
+			for(std::size_t i = 0; i < CHUNK_BLOCKS; i++)
+				blocks[i] = cnk->allocate(block_size);
+		} );
+		bench::do_not_optimize(blocks);
+		release_ticks += bench::measure_region("chunk::release", CHUNK_BLOCKS, [cnk, &blocks, block_size] () {
+			for(std::size_t i = CHUNK_BLOCKS; i > 0; i--)
+				cnk->release(blocks[i-1], block_size);
+		} );
+	}
+	print("chunk", "allocate", "chunk::allocate", block_size, alloc_ticks, ops);
+	print("chunk", "release", "chunk::release", block_size, release_ticks, ops);
+	// random order release spreads the free list over the chunk
+	bench::xorshift rnd(block_size);
+	uint64_t random_ticks = 0;
+	for(std::size_t r = 0; r < CHUNK_ROUNDS; r++) {
+		for(std::size_t i = 0; i < CHUNK_BLOCKS; i++)
+			blocks[i] = cnk->allocate(block_size);
+		for(std::size_t i = CHUNK_BLOCKS - 1; i > 0; i--)
+			std::swap( blocks[i], blocks[ rnd.next(i + 1) ] );
+		random_ticks += bench::measure_region("chunk::release_random", CHUNK_BLOCKS, [cnk, &blocks, block_size] () {
+			for(std::size_t i = 0; i < CHUNK_BLOCKS; i++)
+				cnk->release(blocks[i], block_size);
+		} );
+	}
+	print("chunk", "release_random", "chunk::release_random", block_size, random_ticks, ops);
+	// chunk construction on already faulted memory, as arena does for a new chunk
+	const uint64_t create_ticks = bench::measure_region("chunk::create", CHUNK_ROUNDS, [mem, bytes, block_size] () {
+		for(std::size_t r = 0; r < CHUNK_ROUNDS; r++) {
+			chunk* c = new (mem) chunk( block_size, CHUNK_BLOCKS, static_cast<uint8_t*>(mem) + chunk::header_size(CHUNK_BLOCKS), bytes );
+			bench::do_not_optimize(c);
+		}
+	} );
+	print("chunk", "create", "chunk::create", block_size, create_ticks, CHUNK_ROUNDS);
+	smallobject::sys::xfree_aligned(mem);
+}
+
+typedef std::less<const uint8_t*> byte_ptr_less;
+typedef smallobject::range_map<const uint8_t*, std::size_t, byte_ptr_less> chunks_map;
+
+static const std::size_t CHUNK_STRIDE = 4096;
+static const std::size_t CHUNK_PAYLOAD = 4080;
+
+// ranges are never dereferenced, so fake addresses are safe
+static inline const uint8_t* chunk_begin(const std::size_t i)
+{
+	return reinterpret_cast<const uint8_t*>( (std::size_t(1) << 32) + i * CHUNK_STRIDE );
+}
+
+// range_map insert and find, with the map of the chunk index size
+static void range_map_bench(const std::size_t size)
+{
+	chunks_map* map = new chunks_map();
+	const uint64_t insert_ticks = bench::measure_region("range_map::insert", size, [map, size] () {
+		for(std::size_t i = 0; i < size; i++) {
+			const uint8_t* begin = chunk_begin(i);
+			const uint8_t* end = begin + CHUNK_PAYLOAD;
+			std::size_t value = i;
+			map->insert( boost::move(begin), boost::move(end), boost::move(value) );
+		}
+	} );
+	print("range_map", "insert", "range_map::insert", size, insert_ticks, size);
+	bench::xorshift rnd(size);
+	std::vector<const uint8_t*> keys(MAP_LOOKUPS);
+	for(std::size_t i = 0; i < MAP_LOOKUPS; i++)
+		keys[i] = chunk_begin( rnd.next(size) ) + rnd.next(CHUNK_PAYLOAD);
+	const uint64_t find_ticks = bench::measure_region("range_map::find", MAP_LOOKUPS, [map, &keys] () {
+		std::size_t sum = 0;
+		for(std::size_t i = 0; i < MAP_LOOKUPS; i++)
+			sum += map->find(keys[i])->second;
+		bench::do_not_optimize(sum);
+	} );
+	print("range_map", "find", "range_map::find", size, find_ticks, MAP_LOOKUPS);
+	delete map;
+}
+
+// lock free list push_front, threads push into the same list
+static void list_bench(const std::size_t threads)
+{
+	smallobject::list<std::size_t>* lst = new smallobject::list<std::size_t>();
+	const uint64_t ops = threads * LIST_PUSHES;
+	const uint64_t ticks = run_threads("list::push_front", threads, ops, [lst] (const std::size_t id) {
+		for(std::size_t i = 0; i < LIST_PUSHES; i++)
+			lst->push_front( id * LIST_PUSHES + i );
+	} );
+	print("list", "push_front", "list::push_front", threads, ticks, ops);
+	delete lst;
+}
+
+// read and write lock round trips, threads share the same barrier
+template<class B>
+static void barrier_bench(const char* name, const std::size_t threads)
+{
+	B* barrier = new B();
+	const std::size_t rounds = 1 == threads ? LOCK_ROUNDS : CONTENDED_LOCK_ROUNDS;
+	const uint64_t ops = threads * rounds;
+	const uint64_t read_ticks = run_threads("barrier::read", threads, ops, [barrier, rounds] (const std::size_t) {
+		for(std::size_t i = 0; i < rounds; i++) {
+			barrier->read_lock();
+			barrier->read_unlock();
+		}
+	} );
+	print(name, "read", "barrier::read", threads, read_ticks, ops);
+	const uint64_t write_ticks = run_threads("barrier::write", threads, ops, [barrier, rounds] (const std::size_t) {
+		for(std::size_t i = 0; i < rounds; i++) {
+			barrier->write_lock();
+			barrier->write_unlock();
+		}
+	} );
+	print(name, "write", "barrier::write", threads, write_ticks, ops);
+	delete barrier;
+}
+
+// critical section lock and unlock round trips, threads share the same lock
+static void critical_section_bench(const std::size_t threads)
+{
+	smallobject::sys::critical_section* cs = new smallobject::sys::critical_section();
+	const std::size_t rounds = 1 == threads ? LOCK_ROUNDS : CONTENDED_LOCK_ROUNDS;
+	const uint64_t ops = threads * rounds;
+	const uint64_t ticks = run_threads("critical_section", threads, ops, [cs, rounds] (const std::size_t) {
+		for(std::size_t i = 0; i < rounds; i++) {
+			cs->lock();
+			cs->unlock();
+		}
+	} );
+	print("critical_section", "lock_unlock", "critical_section", threads, ticks, ops);
+	delete cs;
+}
+
+static void no_cleanup(std::size_t*)
+{}
+
+// thread_specific_ptr get, as pool does on every malloc and free
+static void tss_bench()
+{
+	static std::size_t value = 1;
+	boost::thread_specific_ptr<std::size_t>* tss = new boost::thread_specific_ptr<std::size_t>(&no_cleanup);
+	tss->reset(&value);
+	const uint64_t ticks = bench::measure_region("thread_specific_ptr::get", TSS_READS, [tss] () {
+		std::size_t sum = 0;
+		for(std::size_t i = 0; i < TSS_READS; i++) {
+			sum += *tss->get();
+			bench::do_not_optimize(sum);
+		}
+	} );
+	print("thread_specific_ptr", "get", "thread_specific_ptr::get", 1, ticks, TSS_READS);
+	delete tss;
+}
+
+// prints cost of the allocator building blocks per operation, and hardware counters per operation
+// when perf events are available
+int main()
+{
+	std::size_t max_threads = std::thread::hardware_concurrency();
+	if(max_threads < 4)
+		max_threads = 4;
+	_ticks_per_ns = bench::tick_clock::ticks_per_ns();
+	const bool counters = smallobject::perf_counters::available();
+	std::cout << "Component costs, " << std::fixed << std::setprecision(3) << _ticks_per_ns << " reference cycles per nanosecond";
+	if(!counters)
+		std::cout << ", hardware counters are not available";
+	std::cout << std::endl;
+	std::cout << std::setw(18) << "component" << std::setw(16) << "operation" << std::setw(10) << "param"
+		<< std::setw(14) << "cycles/op" << std::setw(12) << "ns/op";
+	if(counters) {
+		for(std::size_t i = 0; i < smallobject::PERF_COUNTERS_COUNT; i++)
+			std::cout << std::setw(14) << smallobject::perf_counters::name( static_cast<smallobject::perf_counter>(i) );
+	}
+	std::cout << std::endl;
+	bench::perf_region_hook hook;
+	if(counters) {
+		_counters = &hook;
+		bench::current_region_hook() = &hook;
+	}
+	// param is block size
+	for(std::size_t block_size = 16; block_size <= 128; block_size <<= 1)
+		chunk_bench(block_size);
+	// param is count of chunks
+	for(std::size_t size = 16; size <= 65536; size <<= 4)
+		range_map_bench(size);
+	// param is count of threads
+	for(std::size_t threads = 1; threads <= max_threads; threads <<= 1)
+		list_bench(threads);
+	for(std::size_t threads = 1; threads <= max_threads; threads <<= 1)
+		barrier_bench<smallobject::sys::read_write_barrier>("read_write_barrier", threads);
+	for(std::size_t threads = 1; threads <= max_threads; threads <<= 1)
+		barrier_bench<smallobject::sys::distributed_read_write_barrier>("distributed_rwb", threads);
+	for(std::size_t threads = 1; threads <= max_threads; threads <<= 1)
+		critical_section_bench(threads);
+	tss_bench();
+	bench::current_region_hook() = NULL;
+	return 0;
+}
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+#include <object_allocator.hpp>
+#include <perf_counters.hpp>
+
+#include "bench.hpp"
+
+using smallobject::detail::object_allocator;
+
+static const std::size_t OWNER_OPS = 1 << 21;
+static const std::size_t BATCH = 64;
+// every REMOTE_SHARE block allocated by the owner is released by a remote thread
+static const std::size_t REMOTE_SHARE = 4;
+static const std::size_t RING_SIZE = 4096;
+static const std::size_t BLOCK_SIZE = 32;
+
+// single producer single consumer ring of blocks, head and tail are on separate cache lines
+class ring {
+public:
+	ring():
+		head_(0),
+		tail_(0)
+	{}
+	bool push(void* const ptr) {
+		const std::size_t tail = tail_.load(boost::memory_order_relaxed);
+		if( tail - head_.load(boost::memory_order_acquire) == RING_SIZE )
+			return false;
+		slots_[tail % RING_SIZE] = ptr;
+		tail_.store(tail + 1, boost::memory_order_release);
+		return true;
+	}
+	void* pop() {
+		const std::size_t head = head_.load(boost::memory_order_relaxed);
+		if( head == tail_.load(boost::memory_order_acquire) )
+			return NULL;
+		void* result = slots_[head % RING_SIZE];
+		head_.store(head + 1, boost::memory_order_release);
+		return result;
+	}
+private:
+	boost::atomic_size_t head_;
+	uint8_t head_padding_[SO_CACHE_LINE_SIZE];
+	boost::atomic_size_t tail_;
+	uint8_t tail_padding_[SO_CACHE_LINE_SIZE];
+	void* slots_[RING_SIZE];
+};
+
+struct owner_result {
+	uint64_t ticks;
+	uint64_t ops;
+	uint64_t remote;
+	smallobject::perf_values counters;
+};
+
+// owner allocates and releases batches of blocks in its own arena,
+// and hands a share of the blocks over to the remote threads
+static void owner(std::vector<ring>& rings, owner_result& r)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	void* blocks[BATCH];
+	std::size_t next = 0;
+	r.remote = 0;
+	smallobject::perf_values before, after;
+	smallobject::perf_counters::read(before);
+	const uint64_t start = bench::tick_clock::now();
+	for(std::size_t op = 0; op < OWNER_OPS; op += BATCH * 2) {
+		for(std::size_t i = 0; i < BATCH; i++) {
+			blocks[i] = alloc->malloc(BLOCK_SIZE);
+			*static_cast<std::size_t*>(blocks[i]) = i;
+		}
+		for(std::size_t i = BATCH; i > 0; i--) {
+			void* ptr = blocks[i - 1];
+			if( !rings.empty() && 0 == i % REMOTE_SHARE && rings[next].push(ptr) ) {
+				next = (next + 1) % rings.size();
+				++r.remote;
+				continue;
+			}
+			alloc->free(ptr, BLOCK_SIZE);
+		}
+	}
+	r.ticks = bench::tick_clock::now() - start;
+	smallobject::perf_counters::read(after);
+	for(std::size_t i = 0; i < smallobject::PERF_COUNTERS_COUNT; i++)
+		r.counters.values[i] = after.values[i] - before.values[i];
+	r.ops = OWNER_OPS;
+}
+
+// releases blocks of the owner arena, every release takes the arena read lock and queues the block to its chunk
+static void remote(ring& q, boost::atomic_bool& done)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	for(;;) {
+		void* ptr = q.pop();
+		if(NULL != ptr) {
+			alloc->free(ptr, BLOCK_SIZE);
+			continue;
+		}
+		if( done.load(boost::memory_order_acquire) ) {
+			// owner finished, drain the rest
+			while( NULL != ( ptr = q.pop() ) )
+				alloc->free(ptr, BLOCK_SIZE);
+			return;
+		}
+		std::this_thread::yield();
+	}
+}
+
+static void run(const std::size_t remotes, const double ticks_per_ns, const bool first)
+{
+	std::vector<ring> rings(remotes);
+	boost::atomic_bool done(false);
+	owner_result r;
+	std::thread own( [&rings, &r] () {
+		owner(rings, r);
+	} );
+	std::vector<std::thread> workers;
+	workers.reserve(remotes);
+	for(std::size_t i = 0; i < remotes; i++)
+		workers.push_back( std::thread( [&rings, &done, i] () {
+			remote(rings[i], done);
+		} ) );
+	own.join();
+	done.store(true, boost::memory_order_release);
+	for(std::size_t i = 0; i < remotes; i++)
+		workers[i].join();
+	std::printf("%s\n\t\t{\"remote_threads\":%zu,\"owner_ops\":%llu,\"remote_frees\":%llu,\"owner_ns_per_op\":%.2f",
+				first ? "" : ",", remotes, static_cast<unsigned long long>(r.ops), static_cast<unsigned long long>(r.remote),
+				r.ticks / ticks_per_ns / r.ops);
+	for(std::size_t i = 0; i < smallobject::PERF_COUNTERS_COUNT; i++)
+		std::printf(",\"owner_%s_per_op\":%.3f", smallobject::perf_counters::name( static_cast<smallobject::perf_counter>(i) ),
+					static_cast<double>(r.counters.values[i]) / r.ops);
+	std::fputc('}', stdout);
+	std::fflush(stdout);
+}
+
+// usage: false_sharing_bench [max remote threads]
+// owner thread allocates and releases in its arena while remote threads release a share of its blocks,
+// prints owner cost per operation, and owner cache misses per operation when hardware counters are available.
+// Owner cost growth with remote threads shows how much remote frees disturb the owner cache lines,
+// compare builds before and after a layout change
+int main(int argc, const char** argv)
+{
+	std::size_t max_remotes = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 0;
+	if(0 == max_remotes)
+		max_remotes = std::max<std::size_t>( 3, std::thread::hardware_concurrency() - 1 );
+	const double ticks_per_ns = bench::tick_clock::ticks_per_ns();
+	std::printf("{\n\t\"benchmark\":\"false_sharing_bench\",\n\t\"counters\":%s,\n\t\"cpus\":%u,\n\t\"results\":[",
+				smallobject::perf_counters::available() ? "true" : "false", std::thread::hardware_concurrency() );
+	run(0, ticks_per_ns, true);
+	for(std::size_t remotes = 1; remotes <= max_remotes; remotes++)
+		run(remotes, ticks_per_ns, false);
+	std::printf("\n\t]\n}\n");
+	return 0;
+}
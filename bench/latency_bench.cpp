@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <instrument.hpp>
+#include <object_allocator.hpp>
+
+#include "bench.hpp"
+#include "perf_hook.hpp"
+
+using smallobject::detail::object_allocator;
+using smallobject::instrument;
+using smallobject::slow_path_event;
+using smallobject::SLOW_PATH_EVENTS_COUNT;
+
+static const std::size_t SLOTS = 8192;
+static const std::size_t OPS = 1 << 17;
+static const std::size_t ROUNDS = 4;
+
+enum operation {
+	MALLOC = 0,
+	FREE,
+	OPERATIONS_COUNT
+};
+
+static const char* OPERATION_NAMES[OPERATIONS_COUNT] = { "malloc", "free" };
+
+// latency of an operation in ticks, for all calls and for the calls where slow path events happened
+struct op_latency {
+	bench::histogram all;
+	bench::histogram fast;
+	bench::histogram events[SLOW_PATH_EVENTS_COUNT];
+	void merge(const op_latency& other) {
+		all.merge(other.all);
+		fast.merge(other.fast);
+		for(std::size_t e = 0; e < SLOW_PATH_EVENTS_COUNT; e++)
+			events[e].merge(other.events[e]);
+	}
+};
+
+struct thread_latency {
+	op_latency ops[OPERATIONS_COUNT];
+};
+
+struct block {
+	void* ptr;
+	std::size_t size;
+};
+
+// times an allocator call, and attributes it to the slow path events counted by the current thread meanwhile
+template<class F>
+static BOOST_FORCEINLINE void timed(op_latency& lat, F call)
+{
+	uint64_t before[SLOW_PATH_EVENTS_COUNT];
+	for(std::size_t e = 0; e < SLOW_PATH_EVENTS_COUNT; e++)
+		before[e] = instrument::count( static_cast<slow_path_event>(e) );
+	const uint64_t start = bench::tick_clock::now();
+	call();
+	const uint64_t ticks = bench::tick_clock::now() - start;
+	lat.all.record(ticks);
+	bool slow = false;
+	for(std::size_t e = 0; e < SLOW_PATH_EVENTS_COUNT; e++) {
+		if( before[e] != instrument::count( static_cast<slow_path_event>(e) ) ) {
+			lat.events[e].record(ticks);
+			slow = true;
+		}
+	}
+	if(!slow)
+		lat.fast.record(ticks);
+}
+
+// Larson style workload with a single size class, every round a new generation of threads
+// takes over the blocks of the previous one, so that first frees of a round are remote
+static void run(const std::size_t size, const std::size_t threads, std::vector<thread_latency>& latency)
+{
+	std::vector<block> slots(threads * SLOTS);
+	for(std::vector<block>::iterator it = slots.begin(); it != slots.end(); ++it) {
+		it->ptr = NULL;
+		it->size = size;
+	}
+	for(std::size_t round = 0; round < ROUNDS; round++) {
+		std::vector<std::thread> workers;
+		workers.reserve(threads);
+		for(std::size_t id = 0; id < threads; id++) {
+			workers.push_back( std::thread( [&slots, &latency, threads, round, id] () {
+				object_allocator* const allocator = object_allocator::instance();
+				op_latency* const lat = latency[id].ops;
+				block* const own = slots.data() + ( (id + round) % threads ) * SLOTS;
+				bench::xorshift rnd( (round + 1) * (id + 1) );
+				for(std::size_t i = 0; i < OPS; i++) {
+					block& blk = own[ rnd.next(SLOTS) ];
+					if(NULL != blk.ptr)
+						timed(lat[FREE], [allocator, &blk] () { allocator->free(blk.ptr, blk.size); } );
+					timed(lat[MALLOC], [allocator, &blk] () { blk.ptr = allocator->malloc(blk.size); } );
+					bench::do_not_optimize(blk.ptr);
+				}
+			} ) );
+		}
+		for(std::size_t id = 0; id < threads; id++)
+			workers[id].join();
+	}
+	object_allocator* const allocator = object_allocator::instance();
+	for(std::vector<block>::const_iterator it = slots.begin(); it != slots.end(); ++it) {
+		if(NULL != it->ptr)
+			allocator->free(it->ptr, it->size);
+	}
+}
+
+static void print_percentiles(const bench::histogram& h, const double ticks_per_ns)
+{
+	std::printf("\"count\":%llu,\"p50\":%.0f,\"p99\":%.0f,\"p999\":%.0f,\"max\":%.0f",
+				static_cast<unsigned long long>( h.count() ),
+				h.percentile(0.5) / ticks_per_ns,
+				h.percentile(0.99) / ticks_per_ns,
+				h.percentile(0.999) / ticks_per_ns,
+				h.max() / ticks_per_ns);
+}
+
+// prints tail latency of an operation, outliers are the calls slower than p99.9,
+// an outlier is attributed to every slow path event happened during the call
+static void print_operation(const std::size_t size, const operation op, const op_latency& lat, const double ticks_per_ns, const bool first)
+{
+	std::printf("%s\n\t\t{\"size\":%zu,\"operation\":\"%s\",", first ? "" : ",", size, OPERATION_NAMES[op]);
+	print_percentiles(lat.all, ticks_per_ns);
+	const uint64_t threshold = lat.all.percentile(0.999);
+	std::printf(",\"outliers\":{\"threshold_ns\":%.0f,\"count\":%llu,\"none\":%llu",
+				threshold / ticks_per_ns,
+				static_cast<unsigned long long>( lat.all.count_above(threshold) ),
+				static_cast<unsigned long long>( lat.fast.count_above(threshold) ) );
+	for(std::size_t e = 0; e < SLOW_PATH_EVENTS_COUNT; e++) {
+		std::printf(",\"%s\":%llu", instrument::name( static_cast<slow_path_event>(e) ),
+					static_cast<unsigned long long>( lat.events[e].count_above(threshold) ) );
+	}
+	std::fputs("},\"slow_path\":{", stdout);
+	for(std::size_t e = 0; e < SLOW_PATH_EVENTS_COUNT; e++) {
+		std::printf("%s\"%s\":{", 0 == e ? "" : ",", instrument::name( static_cast<slow_path_event>(e) ) );
+		print_percentiles(lat.events[e], ticks_per_ns);
+		std::fputc('}', stdout);
+	}
+	std::fputs("}}", stdout);
+}
+
+// usage: latency_bench [threads]
+// prints malloc and free latency percentiles for every size class as JSON,
+// the library must be built with SO_INSTRUMENT to attribute outliers to the slow path events,
+// and with SO_PERF_COUNTERS to print hardware counters per allocator region
+int main(int argc, const char** argv)
+{
+	std::size_t threads = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 0;
+	if(0 == threads)
+		threads = std::max<std::size_t>( 4, std::thread::hardware_concurrency() );
+	const double ticks_per_ns = bench::tick_clock::ticks_per_ns();
+	std::printf("{\n\t\"benchmark\":\"latency_bench\",\n\t\"instrumented\":%s,\n\t\"threads\":%zu,\n\t\"ticks_per_ns\":%.3f,\n\t\"results\":[",
+				instrument::enabled() ? "true" : "false", threads, ticks_per_ns);
+	bool first = true;
+	for(std::size_t i = 0; i < object_allocator::size_classes(); i++) {
+		const std::size_t size = object_allocator::MAX_SIZE - (object_allocator::size_classes() - 1 - i) * sizeof(std::size_t);
+		std::vector<thread_latency> latency(threads);
+		run(size, threads, latency);
+		for(std::size_t op = 0; op < OPERATIONS_COUNT; op++) {
+			op_latency total;
+			for(std::size_t t = 0; t < threads; t++)
+				total.merge( latency[t].ops[op] );
+			print_operation(size, static_cast<operation>(op), total, ticks_per_ns, first);
+			first = false;
+		}
+		std::fflush(stdout);
+	}
+	std::printf("\n\t]");
+	// library built with SO_PERF_COUNTERS, latency includes counter reads
+	if( smallobject::perf_counters::enabled() ) {
+		std::printf(",\n\t\"regions\":");
+		bench::print_region_totals(stdout);
+	}
+	std::printf("\n}\n");
+	return 0;
+}
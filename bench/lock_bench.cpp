@@ -0,0 +1,73 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include <critical_section.hpp>
+
+#include "bench.hpp"
+
+static const std::size_t ACQUIRES_PER_THREAD = 1 << 18;
+// work done inside and outside of the critical section, in xorshift steps
+static const std::size_t INSIDE_WORK = 16;
+static const std::size_t OUTSIDE_WORK = 64;
+
+template<class L>
+struct shared_state {
+	L lock;
+	uint64_t counter;
+	shared_state():
+		lock(),
+		counter(0)
+	{}
+};
+
+template<class L>
+static void worker(shared_state<L>& state, const std::size_t seed)
+{
+	bench::xorshift rnd(seed);
+	for(std::size_t i = 0; i < ACQUIRES_PER_THREAD; i++) {
+		for(std::size_t j = 0; j < OUTSIDE_WORK; j++)
+			bench::do_not_optimize( rnd.next() );
+		state.lock.lock();
+		uint64_t value = state.counter;
+		for(std::size_t j = 0; j < INSIDE_WORK; j++)
+			value += rnd.next() & 1;
+		state.counter = value;
+		state.lock.unlock();
+	}
+}
+
+// returns average nanoseconds per acquire and release, for all threads
+template<class L>
+BOOST_NOINLINE double run(const std::size_t threads)
+{
+	shared_state<L> *state = new shared_state<L>();
+	std::vector<std::thread> workers;
+	workers.reserve(threads);
+	bench::stopwatch sw;
+	for(std::size_t i = 0; i < threads; i++)
+		workers.push_back( std::thread( &worker<L>, std::ref(*state), i + 1 ) );
+	for(std::size_t i = 0; i < threads; i++)
+		workers[i].join();
+	const double ns = sw.elapsed_ns();
+	bench::do_not_optimize(state->counter);
+	delete state;
+	return ns / (threads * ACQUIRES_PER_THREAD);
+}
+
+int main(int argc, const char** argv)
+{
+	std::size_t cores = std::thread::hardware_concurrency();
+	if(0 == cores)
+		cores = 1;
+	std::cout << "Lock contention, " << cores << " CPU cores, nanoseconds per lock/unlock pair" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(14) << "spinlock" << std::setw(14) << "futex_lock" << std::endl;
+	// oversubscription up to 4 threads per core, when spinlock owner is de-scheduled
+	for(std::size_t threads = 1; threads <= cores * 4; threads <<= 1) {
+		std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2)
+			<< std::setw(14) << run<smallobject::sys::spinlock>(threads)
+			<< std::setw(14) << run<smallobject::sys::futex_lock>(threads) << std::endl;
+	}
+	return 0;
+}
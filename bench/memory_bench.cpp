@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+#include <object.hpp>
+
+#if defined(__linux__)
+#	include <sys/wait.h>
+#	include <unistd.h>
+#endif // __linux__
+
+#if defined(__GLIBC__)
+#	include <malloc.h>
+#endif // __GLIBC__
+
+#include "bench.hpp"
+
+static const std::size_t LIVE_OBJECTS = 1 << 18;
+static const std::size_t STEADY_OPS = 1 << 20;
+static const std::size_t SAWTOOTH_CYCLES = 8;
+static const std::size_t IMBALANCE_THREADS = 4;
+
+// system allocator counterpart of smallobject::object, with the same layout
+class sys_object {
+protected:
+	sys_object():
+		ref_count_(0)
+	{}
+public:
+	virtual ~sys_object()
+	{}
+private:
+	boost::atomic_size_t ref_count_;
+};
+
+template<class B, std::size_t N>
+class node: public B {
+public:
+	node():
+		B()
+	{
+		std::memset(payload_, 0, N);
+	}
+private:
+	uint8_t payload_[N];
+};
+
+template<class B>
+struct factory {
+	typedef B* (*make_f)();
+	template<std::size_t N>
+	static B* make() {
+		return new node<B, N>();
+	}
+	static std::size_t size(const std::size_t kind) {
+		static const std::size_t SIZES[] = {
+			sizeof(node<B, 8>), sizeof(node<B, 24>), sizeof(node<B, 40>), sizeof(node<B, 56>),
+			sizeof(node<B, 72>), sizeof(node<B, 88>), sizeof(node<B, 104>)
+		};
+		return SIZES[kind];
+	}
+	static B* create(const std::size_t kind) {
+		static const make_f MAKE[] = {
+			&make<8>, &make<24>, &make<40>, &make<56>, &make<72>, &make<88>, &make<104>
+		};
+		return MAKE[kind]();
+	}
+	static const std::size_t KINDS = 7;
+};
+
+// small object allocator, objects are allocated with object::operator new
+struct smallobject_heap {
+	typedef smallobject::object base;
+	static const char* name() {
+		return "smallobject";
+	}
+	static void shrink() {
+		smallobject::detail::object_allocator::instance()->shrink();
+	}
+};
+
+// system allocator, objects are allocated with global operator new
+struct system_heap {
+	typedef sys_object base;
+	static const char* name() {
+		return "system";
+	}
+	static void shrink()
+	{}
+};
+
+struct live_object {
+	void* ptr;
+	std::size_t kind;
+};
+
+// set of live objects with the count of requested bytes
+template<class H>
+class live_set {
+public:
+	typedef typename H::base base;
+	typedef factory<base> objects;
+	explicit live_set(const uint64_t seed):
+		objects_(),
+		bytes_(0),
+		rnd_(seed)
+	{}
+	~live_set() {
+		resize(0);
+	}
+	void add() {
+		live_object obj;
+		obj.kind = rnd_.next(objects::KINDS);
+		obj.ptr = objects::create(obj.kind);
+		objects_.push_back(obj);
+		bytes_ += objects::size(obj.kind);
+	}
+	// releases a random object
+	void remove() {
+		const std::size_t idx = rnd_.next( objects_.size() );
+		live_object obj = objects_[idx];
+		objects_[idx] = objects_.back();
+		objects_.pop_back();
+		bytes_ -= objects::size(obj.kind);
+		delete static_cast<base*>(obj.ptr);
+	}
+	void resize(const std::size_t count) {
+		while(objects_.size() < count)
+			add();
+		while(objects_.size() > count)
+			remove();
+	}
+	void replace() {
+		remove();
+		add();
+	}
+	inline std::size_t bytes() const {
+		return bytes_;
+	}
+	inline std::size_t size() const {
+		return objects_.size();
+	}
+private:
+	std::vector<live_object> objects_;
+	std::size_t bytes_;
+	bench::xorshift rnd_;
+};
+
+// \return a field of /proc/self/smaps_rollup in kilobytes, or 0 when it is not available
+static std::size_t smaps_rollup_kb(const char* field)
+{
+	std::size_t result = 0;
+#ifdef __linux__
+	std::FILE* f = std::fopen("/proc/self/smaps_rollup", "r");
+	if(NULL == f)
+		return 0;
+	char line[256];
+	const std::size_t len = std::strlen(field);
+	while( NULL != std::fgets(line, sizeof(line), f) ) {
+		if( 0 == std::strncmp(line, field, len) && ':' == line[len] ) {
+			unsigned long kb = 0;
+			if( 1 == std::sscanf(line + len + 1, "%lu", &kb) )
+				result = kb;
+			break;
+		}
+	}
+	std::fclose(f);
+#endif // __linux__
+	return result;
+}
+
+struct report {
+	std::size_t baseline;
+	std::size_t live_objects;
+	std::size_t live_bytes;
+	std::size_t peak;
+	std::size_t peak_private_dirty_kb;
+	std::size_t drained;
+	std::size_t shrunk;
+	std::size_t trimmed;
+};
+
+static void sample_peak(report& r, const std::size_t live_objects, const std::size_t live_bytes)
+{
+	const std::size_t rss = bench::rss_bytes();
+	if(rss >= r.peak) {
+		r.peak = rss;
+		r.live_objects = live_objects;
+		r.live_bytes = live_bytes;
+		r.peak_private_dirty_kb = smaps_rollup_kb("Private_Dirty");
+	}
+}
+
+// measures memory retained after the live set was drained
+template<class H>
+static void sample_drained(report& r)
+{
+	r.drained = bench::rss_bytes();
+	H::shrink();
+	r.shrunk = bench::rss_bytes();
+#if defined(__GLIBC__)
+	// chunks are released into the system allocator, which may keep them
+	::malloc_trim(0);
+#endif // __GLIBC__
+	r.trimmed = bench::rss_bytes();
+}
+
+// live set is filled, and then random objects are replaced keeping its size
+template<class H>
+static void steady(report& r)
+{
+	{
+		live_set<H> set(1);
+		set.resize(LIVE_OBJECTS);
+		for(std::size_t i = 0; i < STEADY_OPS; i++)
+			set.replace();
+		sample_peak(r, set.size(), set.bytes() );
+	}
+	sample_drained<H>(r);
+}
+
+// live set grows to the peak, and then all objects are released in random order
+template<class H>
+static void ramp_drain(report& r)
+{
+	{
+		live_set<H> set(2);
+		set.resize(LIVE_OBJECTS);
+		sample_peak(r, set.size(), set.bytes() );
+		set.resize(0);
+	}
+	sample_drained<H>(r);
+}
+
+// live set grows to the peak, and drains to a quarter again and again
+template<class H>
+static void sawtooth(report& r)
+{
+	{
+		live_set<H> set(3);
+		for(std::size_t i = 0; i < SAWTOOTH_CYCLES; i++) {
+			set.resize(LIVE_OBJECTS);
+			sample_peak(r, set.size(), set.bytes() );
+			set.resize(LIVE_OBJECTS / 4);
+		}
+		set.resize(0);
+	}
+	sample_drained<H>(r);
+}
+
+// one thread holds most of the live set, others hold a small part of it,
+// every thread drains its own objects and exits
+template<class H>
+static void imbalance(report& r)
+{
+	boost::atomic_size_t filled(0);
+	boost::atomic_size_t bytes(0);
+	boost::atomic_bool drain(false);
+	std::vector<std::thread> workers;
+	workers.reserve(IMBALANCE_THREADS);
+	for(std::size_t t = 0; t < IMBALANCE_THREADS; t++) {
+		workers.push_back( std::thread( [&filled, &bytes, &drain, t] () {
+			live_set<H> set(t + 4);
+			// first thread holds a half, others share the rest
+			const std::size_t count = 0 == t ? LIVE_OBJECTS / 2 : LIVE_OBJECTS / 2 / (IMBALANCE_THREADS - 1);
+			set.resize(count);
+			bytes.fetch_add( set.bytes() );
+			filled.fetch_add(1);
+			while( !drain.load() )
+				std::this_thread::yield();
+			set.resize(0);
+		} ) );
+	}
+	while( filled.load() < IMBALANCE_THREADS )
+		std::this_thread::yield();
+	sample_peak(r, LIVE_OBJECTS / 2 + (LIVE_OBJECTS / 2 / (IMBALANCE_THREADS - 1) ) * (IMBALANCE_THREADS - 1), bytes.load() );
+	drain.store(true);
+	for(std::size_t t = 0; t < IMBALANCE_THREADS; t++)
+		workers[t].join();
+	sample_drained<H>(r);
+}
+
+typedef void (*scenario_f)(report&);
+
+template<class H>
+static void run(const char* scenario, scenario_f routine)
+{
+	report r;
+	std::memset( &r, 0, sizeof(r) );
+	r.baseline = bench::rss_bytes();
+	routine(r);
+	const std::size_t peak_extra = r.peak > r.baseline ? r.peak - r.baseline : 0;
+	std::printf("\t\t{\"heap\":\"%s\",\"scenario\":\"%s\",\"live_objects\":%zu,\"live_bytes\":%zu,"
+				"\"baseline_kb\":%zu,\"peak_kb\":%zu,\"peak_private_dirty_kb\":%zu,\"rss_per_live_byte\":%.3f,"
+				"\"drained_kb\":%zu,\"shrunk_kb\":%zu,\"trimmed_kb\":%zu}",
+				H::name(), scenario, r.live_objects, r.live_bytes,
+				r.baseline / 1024, r.peak / 1024, r.peak_private_dirty_kb,
+				r.live_bytes > 0 ? static_cast<double>(peak_extra) / r.live_bytes : 0.0,
+				r.drained / 1024, r.shrunk / 1024, r.trimmed / 1024);
+	std::fflush(stdout);
+}
+
+// runs every scenario in a separate process, so that resident set does not carry over
+template<class H>
+static void run_isolated(const char* scenario, scenario_f routine, bool& first)
+{
+	std::fputs(first ? "\n" : ",\n", stdout);
+	first = false;
+	std::fflush(stdout);
+#if defined(__linux__)
+	const pid_t pid = ::fork();
+	if(0 == pid) {
+		run<H>(scenario, routine);
+		::_exit(0);
+	}
+	if(pid > 0) {
+		int status;
+		::waitpid(pid, &status, 0);
+		return;
+	}
+#endif // __linux__
+	run<H>(scenario, routine);
+}
+
+template<class H>
+static void run_all(bool& first)
+{
+	run_isolated<H>("steady", &steady<H>, first);
+	run_isolated<H>("ramp_drain", &ramp_drain<H>, first);
+	run_isolated<H>("sawtooth", &sawtooth<H>, first);
+	run_isolated<H>("imbalance", &imbalance<H>, first);
+}
+
+// prints resident memory per live requested byte of the object live sets as JSON,
+// drained, shrunk and trimmed show RSS after release of all objects, after object_allocator::shrink
+// and after the system allocator returned free memory to the operating system
+int main(int argc, const char** argv)
+{
+	std::printf("{\n\t\"benchmark\":\"memory_bench\",\n\t\"results\":[");
+	bool first = true;
+	run_all<smallobject_heap>(first);
+	run_all<system_heap>(first);
+	std::printf("\n\t]\n}\n");
+	return 0;
+}
@@ -0,0 +1,96 @@
+#ifndef __SMALLOBJECT_BENCH_PERF_HOOK_HPP_INCLUDED__
+#define __SMALLOBJECT_BENCH_PERF_HOOK_HPP_INCLUDED__
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <perf_counters.hpp>
+
+#include "bench.hpp"
+
+namespace bench {
+
+/// Hardware counters accumulated in a measured region
+struct region_counters {
+	uint64_t ops;
+	smallobject::perf_values counters;
+};
+
+/**
+ * \brief Region hook reading perf_event hardware counters of the calling thread.
+ *  Regions may run in several threads at once, every thread counts its own part,
+ *  and the counts are summed per region name. When counters are not available hook does nothing.
+ */
+class perf_region_hook: public region_hook {
+public:
+	perf_region_hook():
+		region_hook(),
+		mtx_(),
+		regions_()
+	{}
+	virtual void begin(const char*) {
+		smallobject::perf_counters::read( start() );
+	}
+	virtual void end(const char* region, const uint64_t ops) {
+		smallobject::perf_values now;
+		if( !smallobject::perf_counters::read(now) )
+			return;
+		const smallobject::perf_values& started = start();
+		std::lock_guard<std::mutex> lock(mtx_);
+		region_counters& rc = regions_[region];
+		rc.ops += ops;
+		for(std::size_t i = 0; i < smallobject::PERF_COUNTERS_COUNT; i++)
+			rc.counters.values[i] += now.values[i] - started.values[i];
+	}
+	/// Takes counters accumulated for a region, and resets them
+	/// \return whether region has counters
+	bool take(const char* region, region_counters& result) {
+		std::lock_guard<std::mutex> lock(mtx_);
+		std::map<std::string, region_counters>::iterator it = regions_.find(region);
+		if( it == regions_.end() )
+			return false;
+		result = it->second;
+		regions_.erase(it);
+		return result.ops > 0;
+	}
+private:
+	// regions do not nest, so a thread needs a single start snapshot
+	static smallobject::perf_values& start() {
+		static thread_local smallobject::perf_values values;
+		return values;
+	}
+private:
+	std::mutex mtx_;
+	std::map<std::string, region_counters> regions_;
+};
+
+/// Prints counters per operation as a JSON object fields, i.e. "cycles":12.5,"instructions":30.0
+inline void print_counters(std::FILE* out, const smallobject::perf_values& counters, const uint64_t ops)
+{
+	for(std::size_t i = 0; i < smallobject::PERF_COUNTERS_COUNT; i++)
+		std::fprintf(out, "%s\"%s\":%.2f", 0 == i ? "" : ",", smallobject::perf_counters::name( static_cast<smallobject::perf_counter>(i) ),
+					ops > 0 ? static_cast<double>(counters.values[i]) / ops : 0.0);
+}
+
+/// Prints counters accumulated by the library built with SO_PERF_COUNTERS per allocator region,
+/// as a JSON object
+inline void print_region_totals(std::FILE* out)
+{
+	std::fputc('{', out);
+	for(std::size_t r = 0; r < smallobject::PERF_REGIONS_COUNT; r++) {
+		const smallobject::perf_region region = static_cast<smallobject::perf_region>(r);
+		smallobject::perf_values totals;
+		const uint64_t calls = smallobject::perf_counters::totals(region, totals);
+		std::fprintf(out, "%s\"%s\":{\"calls\":%llu,", 0 == r ? "" : ",", smallobject::perf_counters::name(region),
+					static_cast<unsigned long long>(calls) );
+		print_counters(out, totals, calls);
+		std::fputc('}', out);
+	}
+	std::fputc('}', out);
+}
+
+} // namespace bench
+
+#endif // __SMALLOBJECT_BENCH_PERF_HOOK_HPP_INCLUDED__
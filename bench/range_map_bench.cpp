@@ -0,0 +1,153 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <range_map.hpp>
+#include <flat_range_map.hpp>
+
+#include "bench.hpp"
+
+// chunk index emulation, range is a chunk [begin,end) and value is the chunk
+typedef std::less<const uint8_t*> byte_ptr_less;
+typedef smallobject::range_map<const uint8_t*, std::size_t, byte_ptr_less> avl_map;
+typedef smallobject::flat_range_map<const uint8_t*, std::size_t, byte_ptr_less> flat_map;
+
+// a page sized chunk of 16 bytes blocks, the smallest chunk of the smallest size class
+static const std::size_t CHUNK_STRIDE = 4096;
+static const std::size_t CHUNK_PAYLOAD = 4080;
+static const std::size_t LOOKUPS = 1 << 20;
+
+// ranges are never dereferenced, so fake addresses are safe
+static inline const uint8_t* chunk_begin(const std::size_t i)
+{
+	return reinterpret_cast<const uint8_t*>( (std::size_t(1) << 32) + i * CHUNK_STRIDE );
+}
+
+struct result {
+	double insert_ns;
+	double find_ns;
+	double iterate_ns;
+	double reinsert_ms;
+	double erase_if_ms;
+};
+
+// arena::shrink predicate emulation, every other chunk is empty
+static bool is_odd(const smallobject::movable_pair<const smallobject::range<const uint8_t*,byte_ptr_less>, std::size_t>& v)
+{
+	return 0 != (v.second & 1);
+}
+
+template<class M>
+static void fill(M& map, const std::size_t count)
+{
+	// chunks are inserted into an arena in the address order in most cases
+	for(std::size_t i = 0; i < count; i++) {
+		const uint8_t* begin = chunk_begin(i);
+		const uint8_t* end = begin + CHUNK_PAYLOAD;
+		std::size_t value = i;
+		map.insert( boost::move(begin), boost::move(end), boost::move(value) );
+	}
+}
+
+// shrink before erase_if: copy survivors, clear and insert them one by one
+template<class M>
+BOOST_NOINLINE double reinsert_shrink(const std::size_t count)
+{
+	M *map = new M();
+	fill(*map, count);
+	bench::stopwatch sw;
+	std::vector<std::size_t> survived;
+	for(typename M::iterator it = map->begin(); it != map->end(); ++it) {
+		if( !is_odd(*it) )
+			survived.push_back(it->second);
+	}
+	map->clear();
+	for(std::size_t i = 0; i < survived.size(); i++) {
+		const uint8_t* begin = chunk_begin( survived[i] );
+		const uint8_t* end = begin + CHUNK_PAYLOAD;
+		map->insert( boost::move(begin), boost::move(end), boost::move(survived[i]) );
+	}
+	double ret = sw.elapsed_ns() / 1000000;
+	delete map;
+	return ret;
+}
+
+template<class M>
+BOOST_NOINLINE double erase_if_shrink(const std::size_t count)
+{
+	M *map = new M();
+	fill(*map, count);
+	bench::stopwatch sw;
+	map->erase_if(&is_odd);
+	double ret = sw.elapsed_ns() / 1000000;
+	delete map;
+	return ret;
+}
+
+template<class M>
+BOOST_NOINLINE result run(const std::size_t count, const std::vector<const uint8_t*>& probes)
+{
+	result ret;
+	M *map = new M();
+	bench::stopwatch sw;
+	fill(*map, count);
+	ret.insert_ns = sw.elapsed_ns() / count;
+
+	std::size_t sum = 0;
+	sw.restart();
+	for(std::size_t i = 0; i < probes.size(); i++) {
+		typename M::iterator it = map->find( probes[i] );
+		if(it != map->end())
+			sum += it->second;
+	}
+	ret.find_ns = sw.elapsed_ns() / probes.size();
+	bench::do_not_optimize(sum);
+
+	std::size_t visited = 0;
+	sw.restart();
+	for(typename M::iterator it = map->begin(); it != map->end(); ++it) {
+		sum += it->second;
+		++visited;
+	}
+	ret.iterate_ns = sw.elapsed_ns() / count;
+	bench::do_not_optimize(sum);
+	if(visited != count)
+		std::cerr << "  iteration visited " << visited << " of " << count << " ranges" << std::endl;
+
+	delete map;
+	ret.reinsert_ms = reinsert_shrink<M>(count);
+	ret.erase_if_ms = erase_if_shrink<M>(count);
+	return ret;
+}
+
+static void print(const char* name, const result& r)
+{
+	std::cout << "  " << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(12) << r.insert_ns
+		<< std::setw(12) << r.find_ns
+		<< std::setw(12) << r.iterate_ns
+		<< std::setw(14) << r.reinsert_ms
+		<< std::setw(14) << r.erase_if_ms << std::endl;
+}
+
+int main(int argc, const char** argv)
+{
+	static const std::size_t SIZES[] = { 1000, 100000, 1000000 };
+	bench::xorshift rnd;
+	for(std::size_t s = 0; s < sizeof(SIZES) / sizeof(std::size_t); s++) {
+		const std::size_t count = SIZES[s];
+		// random addresses inside the chunks payload, with a few misses between them
+		std::vector<const uint8_t*> probes;
+		probes.reserve(LOOKUPS);
+		for(std::size_t i = 0; i < LOOKUPS; i++)
+			probes.push_back( chunk_begin( rnd.next(count) ) + rnd.next(CHUNK_STRIDE) );
+
+		std::cout << "Ranges: " << count << std::endl;
+		std::cout << "  " << std::left << std::setw(10) << "map" << std::right
+			<< std::setw(12) << "insert ns" << std::setw(12) << "find ns" << std::setw(12) << "iterate ns"
+			<< std::setw(14) << "reinsert ms" << std::setw(14) << "erase_if ms" << std::endl;
+		print("avl", run<avl_map>(count, probes) );
+		print("flat", run<flat_map>(count, probes) );
+	}
+	return 0;
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+#include <range_map.hpp>
+#include <rcu_range_map.hpp>
+
+#include "bench.hpp"
+
+typedef std::less<const uint8_t*> byte_ptr_less;
+typedef smallobject::synchronized_range_map<const uint8_t*, std::size_t, byte_ptr_less> rwlock_map;
+typedef smallobject::rcu_range_map<const uint8_t*, std::size_t, byte_ptr_less> rcu_map;
+
+static const std::size_t RANGES = 10000;
+static const std::size_t CHUNK_STRIDE = 4096;
+static const std::size_t CHUNK_PAYLOAD = 4080;
+static const std::size_t LOOKUPS_PER_THREAD = 1 << 21;
+
+static inline const uint8_t* chunk_begin(const std::size_t i)
+{
+	return reinterpret_cast<const uint8_t*>( (std::size_t(1) << 32) + i * CHUNK_STRIDE );
+}
+
+template<class M>
+static void fill(M& map)
+{
+	for(std::size_t i = 0; i < RANGES; i++) {
+		const uint8_t* begin = chunk_begin(i);
+		const uint8_t* end = begin + CHUNK_PAYLOAD;
+		std::size_t value = i;
+		map.insert( boost::move(begin), boost::move(end), boost::move(value) );
+	}
+}
+
+static inline bool lookup(rwlock_map& map, const uint8_t* key, std::size_t& result)
+{
+	rwlock_map::iterator it = map.find(key);
+	if(it == map.end())
+		return false;
+	result = it->second;
+	return true;
+}
+
+static inline bool lookup(rcu_map& map, const uint8_t* key, std::size_t& result)
+{
+	return map.find(key, result);
+}
+
+template<class M>
+static void reader(M& map, const std::size_t seed)
+{
+	bench::xorshift rnd(seed);
+	std::size_t sum = 0;
+	for(std::size_t i = 0; i < LOOKUPS_PER_THREAD; i++) {
+		std::size_t v;
+		if( lookup(map, chunk_begin( rnd.next(RANGES) ) + rnd.next(CHUNK_PAYLOAD), v) )
+			sum += v;
+	}
+	bench::do_not_optimize(sum);
+}
+
+// returns million lookups per second for all threads
+template<class M>
+BOOST_NOINLINE double run(M& map, const std::size_t threads)
+{
+	std::vector<std::thread> workers;
+	workers.reserve(threads);
+	bench::stopwatch sw;
+	for(std::size_t i = 0; i < threads; i++)
+		workers.push_back( std::thread( &reader<M>, std::ref(map), i + 1 ) );
+	for(std::size_t i = 0; i < threads; i++)
+		workers[i].join();
+	const double ns = sw.elapsed_ns();
+	return (threads * LOOKUPS_PER_THREAD) / ns * 1000;
+}
+
+int main(int argc, const char** argv)
+{
+	rwlock_map *rwmap = new rwlock_map();
+	rcu_map *rcumap = new rcu_map();
+	fill(*rwmap);
+	fill(*rcumap);
+
+	std::size_t max_threads = std::thread::hardware_concurrency();
+	if(max_threads < 4)
+		max_threads = 4;
+	std::cout << "Concurrent lookups in " << RANGES << " ranges, million lookups per second" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(14) << "rwlock" << std::setw(14) << "rcu" << std::endl;
+	for(std::size_t threads = 1; threads <= max_threads; threads <<= 1) {
+		std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2)
+			<< std::setw(14) << run(*rwmap, threads)
+			<< std::setw(14) << run(*rcumap, threads) << std::endl;
+	}
+	delete rcumap;
+	delete rwmap;
+	return 0;
+}
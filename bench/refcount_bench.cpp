@@ -0,0 +1,127 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include <object.hpp>
+
+#include "bench.hpp"
+
+static const std::size_t OBJECTS = 1000;
+static const std::size_t ROUNDS = 2000;
+
+template<class R>
+class node: public smallobject::basic_object<R> {
+public:
+	explicit node(const uint32_t value):
+		smallobject::basic_object<R>(),
+		value_(value)
+	{}
+	inline uint32_t value() const {
+		return value_;
+	}
+private:
+	uint32_t value_;
+};
+
+template<class R>
+inline void collect()
+{}
+
+// releases objects queued to the owner by other threads
+template<>
+inline void collect<smallobject::biased_ref_count>()
+{
+	smallobject::biased_ref_count::collect();
+}
+
+template<class R>
+struct workload {
+	typedef boost::intrusive_ptr< node<R> > pointer;
+	typedef std::vector<pointer> pointers;
+
+	static void fill(pointers& objects)
+	{
+		objects.reserve(OBJECTS);
+		for(std::size_t i = 0; i < OBJECTS; i++)
+			objects.push_back( pointer( new node<R>( static_cast<uint32_t>(i) ) ) );
+	}
+
+	// copies every pointer and passes it by value, as containers and callbacks do
+	static BOOST_NOINLINE uint64_t copy_round(const pointers& objects)
+	{
+		uint64_t sum = 0;
+		pointers copy(objects);
+		for(typename pointers::const_iterator it = copy.begin(); it != copy.end(); ++it) {
+			pointer tmp = *it;
+			sum += tmp->value();
+		}
+		return sum;
+	}
+
+	static void copy_loop(const pointers* objects)
+	{
+		uint64_t sum = 0;
+		for(std::size_t i = 0; i < ROUNDS; i++)
+			sum += copy_round(*objects);
+		bench::do_not_optimize(sum);
+	}
+
+	// returns nanoseconds per pointer copy and release, objects are created by the calling thread
+	static double run_owner()
+	{
+		pointers objects;
+		fill(objects);
+		bench::stopwatch sw;
+		copy_loop(&objects);
+		return sw.elapsed_ns() / (ROUNDS * OBJECTS * 2);
+	}
+
+	// returns nanoseconds per pointer copy and release, objects are shared by the calling thread
+	// with other threads
+	static double run_shared(const std::size_t threads)
+	{
+		pointers objects;
+		fill(objects);
+		std::vector<std::thread> workers;
+		workers.reserve(threads);
+		bench::stopwatch sw;
+		for(std::size_t i = 0; i < threads; i++)
+			workers.push_back( std::thread( &workload::copy_loop, &objects ) );
+		for(std::size_t i = 0; i < threads; i++)
+			workers[i].join();
+		const double result = sw.elapsed_ns() / (ROUNDS * OBJECTS * 2 * threads);
+		objects.clear();
+		collect<R>();
+		return result;
+	}
+};
+
+int main(int argc, const char** argv)
+{
+	using namespace smallobject;
+	std::cout << "Object size with 32 bit payload, bytes" << std::endl;
+	std::cout << std::setw(14) << "atomic" << std::setw(14) << "atomic32"
+		<< std::setw(14) << "plain" << std::setw(14) << "biased" << std::endl;
+	std::cout << std::setw(14) << sizeof( node<atomic_ref_count> )
+		<< std::setw(14) << sizeof( node<atomic_ref_count32> )
+		<< std::setw(14) << sizeof( node<plain_ref_count> )
+		<< std::setw(14) << sizeof( node<biased_ref_count> ) << std::endl;
+
+	std::cout << "Copy heavy workload on the creating thread, nanoseconds per add_ref/release" << std::endl;
+	std::cout << std::fixed << std::setprecision(2)
+		<< std::setw(14) << workload<atomic_ref_count>::run_owner()
+		<< std::setw(14) << workload<atomic_ref_count32>::run_owner()
+		<< std::setw(14) << workload<plain_ref_count>::run_owner()
+		<< std::setw(14) << workload<biased_ref_count>::run_owner() << std::endl;
+
+	std::size_t threads = std::thread::hardware_concurrency();
+	if(threads < 2)
+		threads = 2;
+	std::cout << "Copy heavy workload on " << threads << " threads sharing objects, nanoseconds per add_ref/release" << std::endl;
+	std::cout << std::setw(14) << workload<atomic_ref_count>::run_shared(threads)
+		<< std::setw(14) << workload<atomic_ref_count32>::run_shared(threads)
+		<< std::setw(14) << "-"
+		<< std::setw(14) << workload<biased_ref_count>::run_shared(threads) << std::endl;
+	return 0;
+}
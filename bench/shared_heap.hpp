@@ -0,0 +1,124 @@
+#ifndef __SMALLOBJECT_BENCH_SHARED_HEAP_HPP_INCLUDED__
+#define __SMALLOBJECT_BENCH_SHARED_HEAP_HPP_INCLUDED__
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#	include <dlfcn.h>
+#	include <link.h>
+#endif // __linux__
+
+namespace bench {
+
+typedef void* (*malloc_f)(std::size_t);
+typedef void (*free_f)(void*);
+
+/// Allocator loaded from a shared library
+struct shared_heap {
+	/// short name, i.e. jemalloc
+	std::string name;
+	/// library path or soname
+	std::string path;
+	malloc_f do_malloc;
+	free_f do_free;
+};
+
+#ifdef __linux__
+
+// \return whether a symbol is defined by the library itself, not by one of its dependencies
+inline bool defined_in(void* const lib, void* const sym)
+{
+	struct link_map* map = NULL;
+	Dl_info info;
+	if( NULL == sym || 0 != ::dlinfo(lib, RTLD_DI_LINKMAP, &map) || NULL == map || 0 == ::dladdr(sym, &info) )
+		return false;
+	return reinterpret_cast<ElfW(Addr)>(info.dli_fbase) == map->l_addr
+		|| ( NULL != info.dli_fname && NULL != map->l_name && 0 == std::strcmp(info.dli_fname, map->l_name) );
+}
+
+#endif // __linux__
+
+/// Loads an allocator shared library with dlopen, library symbols do not replace the process malloc.
+/// Allocator own entry points are preferred over malloc and free, i.e. mi_malloc or tc_malloc
+/// \param name short name reported in results
+/// \param path library path or soname
+/// \param result loaded allocator
+/// \return whether library was loaded and exports an allocation function pair
+inline bool load_shared_heap(const char* name, const char* path, shared_heap& result)
+{
+#ifdef __linux__
+	static const char* ENTRY_POINTS[][2] = {
+		{"mi_malloc", "mi_free"},
+		{"tc_malloc", "tc_free"},
+		{"je_malloc", "je_free"},
+		{"malloc", "free"}
+	};
+	void* lib = ::dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if(NULL == lib)
+		return false;
+	for(std::size_t i = 0; i < sizeof(ENTRY_POINTS) / sizeof(ENTRY_POINTS[0]); i++) {
+		void* m = ::dlsym(lib, ENTRY_POINTS[i][0]);
+		void* f = ::dlsym(lib, ENTRY_POINTS[i][1]);
+		// dlsym falls back to the dependencies, i.e. libc malloc
+		if( defined_in(lib, m) && defined_in(lib, f) ) {
+			result.name = name;
+			result.path = path;
+			result.do_malloc = reinterpret_cast<malloc_f>(m);
+			result.do_free = reinterpret_cast<free_f>(f);
+			// library is never unloaded, since it may own memory still referenced
+			return true;
+		}
+	}
+	::dlclose(lib);
+	return false;
+#else
+	return false;
+#endif // __linux__
+}
+
+/// Finds well known allocators installed into the library search path
+/// \return loaded allocators, empty when none is installed
+inline std::vector<shared_heap> find_shared_heaps()
+{
+	static const char* KNOWN[][2] = {
+		{"jemalloc", "libjemalloc.so.2"},
+		{"jemalloc", "libjemalloc.so"},
+		{"tcmalloc", "libtcmalloc_minimal.so.4"},
+		{"tcmalloc", "libtcmalloc.so.4"},
+		{"tcmalloc", "libtcmalloc_minimal.so"},
+		{"mimalloc", "libmimalloc.so.2"},
+		{"mimalloc", "libmimalloc.so"}
+	};
+	std::vector<shared_heap> result;
+	for(std::size_t i = 0; i < sizeof(KNOWN) / sizeof(KNOWN[0]); i++) {
+		bool loaded = false;
+		for(std::size_t j = 0; j < result.size(); j++)
+			loaded = loaded || result[j].name == KNOWN[i][0];
+		shared_heap heap;
+		if( !loaded && load_shared_heap(KNOWN[i][0], KNOWN[i][1], heap) )
+			result.push_back(heap);
+	}
+	return result;
+}
+
+/// \return short name of an allocator library path, i.e. jemalloc for /usr/lib/libjemalloc.so.2
+inline std::string shared_heap_name(const char* path)
+{
+	std::string result(path);
+	const std::size_t slash = result.rfind('/');
+	if(std::string::npos != slash)
+		result.erase(0, slash + 1);
+	if( 0 == result.compare(0, 3, "lib") )
+		result.erase(0, 3);
+	const std::size_t dot = result.find('.');
+	if(std::string::npos != dot)
+		result.erase(dot);
+	return result;
+}
+
+} // namespace bench
+
+#endif // __SMALLOBJECT_BENCH_SHARED_HEAP_HPP_INCLUDED__
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include <allocation_trace.hpp>
+#include <object_allocator.hpp>
+
+#include "bench.hpp"
+#include "shared_heap.hpp"
+
+using smallobject::trace_block_header;
+using smallobject::trace_file_header;
+using smallobject::trace_record;
+
+using bench::malloc_f;
+using bench::free_f;
+
+// allocator under test
+struct heap {
+	std::string name;
+	// NULL for the small object allocator
+	malloc_f do_malloc;
+	free_f do_free;
+	BOOST_FORCEINLINE void* malloc BOOST_PREVENT_MACRO_SUBSTITUTION(const std::size_t size) const {
+		if(NULL == do_malloc)
+			return smallobject::detail::object_allocator::instance()->malloc(size);
+		return do_malloc(size);
+	}
+	BOOST_FORCEINLINE void free BOOST_PREVENT_MACRO_SUBSTITUTION(void* const ptr, const std::size_t size) const {
+		if(NULL == do_free)
+			smallobject::detail::object_allocator::instance()->free(ptr, size);
+		else
+			do_free(ptr);
+	}
+};
+
+// replayed call, allocations are numbered in the trace order
+struct replay_op {
+	uint32_t id;
+	uint8_t size;
+	uint8_t op;
+};
+
+typedef std::vector<replay_op> replay_ops;
+
+struct ordered_record {
+	uint64_t timestamp;
+	uint32_t thread;
+	trace_record rec;
+};
+
+static bool timestamp_less(const ordered_record& lhs, const ordered_record& rhs)
+{
+	return lhs.timestamp < rhs.timestamp;
+}
+
+// reads the trace, and converts block addresses into allocation ids
+static bool load(const char* path, std::vector<replay_ops>& threads, std::vector<uint8_t>& sizes)
+{
+	std::FILE* f = std::fopen(path, "rb");
+	if(NULL == f)
+		return false;
+	trace_file_header header;
+	if( 1 != std::fread(&header, sizeof(header), 1, f) || 0 != std::memcmp(header.magic, "SOTRACE1", 8) ) {
+		std::fclose(f);
+		return false;
+	}
+	std::vector<ordered_record> records;
+	std::vector<trace_record> block_records;
+	uint64_t left = header.data_size;
+	trace_block_header block;
+	while( left >= sizeof(block) && 1 == std::fread(&block, sizeof(block), 1, f) ) {
+		left -= sizeof(block);
+		block_records.resize(block.count);
+		const std::size_t read = std::fread(block_records.data(), sizeof(trace_record), block.count, f);
+		left -= std::min<uint64_t>( left, read * sizeof(trace_record) );
+		for(std::size_t i = 0; i < read; i++) {
+			ordered_record r;
+			r.timestamp = block_records[i].timestamp;
+			r.thread = block.thread;
+			r.rec = block_records[i];
+			records.push_back(r);
+		}
+		if(read != block.count)
+			break;
+	}
+	std::fclose(f);
+	if(header.dropped > 0)
+		std::fprintf(stderr, "trace has %llu dropped records\n", static_cast<unsigned long long>(header.dropped) );
+	// records of a thread are ordered, and a free is always recorded after the allocation
+	std::stable_sort( records.begin(), records.end(), &timestamp_less );
+	threads.resize(header.threads);
+	boost::unordered_map<uint64_t, uint32_t> live;
+	sizes.clear();
+	for(std::vector<ordered_record>::const_iterator it = records.begin(); it != records.end(); ++it) {
+		replay_op op;
+		op.size = static_cast<uint8_t>( it->rec.size() );
+		op.op = static_cast<uint8_t>( it->rec.op() );
+		if(trace_record::MALLOC == it->rec.op() ) {
+			op.id = static_cast<uint32_t>( sizes.size() );
+			sizes.push_back(op.size);
+			live[ it->rec.address() ] = op.id;
+		} else {
+			boost::unordered_map<uint64_t, uint32_t>::iterator alloc = live.find( it->rec.address() );
+			// memory allocated before the trace start
+			if( alloc == live.end() )
+				continue;
+			op.id = alloc->second;
+			live.erase(alloc);
+		}
+		if( it->thread >= threads.size() )
+			threads.resize(it->thread + 1);
+		threads[it->thread].push_back(op);
+	}
+	return true;
+}
+
+static bool select_heap(const char* name, heap& result)
+{
+	result.name = name;
+	result.do_malloc = NULL;
+	result.do_free = NULL;
+	if( 0 == std::strcmp(name, "smallobject") )
+		return true;
+	if( 0 == std::strcmp(name, "glibc") ) {
+		result.do_malloc = &std::malloc;
+		result.do_free = &std::free;
+		return true;
+	}
+	// any allocator shared library exporting malloc and free
+	bench::shared_heap loaded;
+	if( !bench::load_shared_heap(name, name, loaded) )
+		return false;
+	result.do_malloc = loaded.do_malloc;
+	result.do_free = loaded.do_free;
+	return true;
+}
+
+static void replay(const heap& h, const replay_ops& ops, std::atomic<void*>* const blocks, std::atomic<std::size_t>& ready, const std::size_t threads)
+{
+	// start all threads at once
+	ready.fetch_add(1);
+	while( ready.load() < threads )
+		std::this_thread::yield();
+	for(replay_ops::const_iterator it = ops.begin(); it != ops.end(); ++it) {
+		std::atomic<void*>& blk = blocks[it->id];
+		if(trace_record::MALLOC == it->op) {
+			void* ptr = h.malloc(it->size);
+			bench::do_not_optimize(ptr);
+			blk.store(ptr, std::memory_order_release);
+		} else {
+			// allocation was made by another thread, which did not replay it yet
+			void* ptr;
+			while( NULL == ( ptr = blk.load(std::memory_order_acquire) ) )
+				std::this_thread::yield();
+			h.free(ptr, it->size);
+			blk.store(NULL, std::memory_order_relaxed);
+		}
+	}
+}
+
+// usage: trace_replay <trace file> [smallobject|glibc|<allocator shared library>]
+// replays a trace recorded with SO_TRACE using the same count of threads, prints throughput and RSS as JSON
+int main(int argc, const char** argv)
+{
+	if(argc < 2) {
+		std::fprintf(stderr, "usage: %s <trace file> [smallobject|glibc|<allocator shared library>]\n", argv[0]);
+		return 1;
+	}
+	heap h;
+	if( !select_heap(argc > 2 ? argv[2] : "smallobject", h) ) {
+		std::fprintf(stderr, "can not load allocator %s\n", h.name.c_str() );
+		return 1;
+	}
+	std::vector<replay_ops> threads;
+	std::vector<uint8_t> sizes;
+	if( !load(argv[1], threads, sizes) ) {
+		std::fprintf(stderr, "can not read trace %s\n", argv[1]);
+		return 1;
+	}
+	const std::size_t allocations = sizes.size();
+	std::vector< std::atomic<void*> > blocks(allocations);
+	for(std::size_t i = 0; i < allocations; i++)
+		blocks[i].store(NULL, std::memory_order_relaxed);
+	std::size_t ops = 0;
+	for(std::size_t t = 0; t < threads.size(); t++)
+		ops += threads[t].size();
+
+	const std::size_t baseline_rss = bench::rss_bytes();
+	// samples resident set size during the replay
+	std::atomic<bool> done(false);
+	std::size_t peak_rss = baseline_rss;
+	std::thread monitor( [&done, &peak_rss] () {
+		while( !done.load() ) {
+			peak_rss = std::max( peak_rss, bench::rss_bytes() );
+			std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+		}
+	} );
+	std::atomic<std::size_t> ready(0);
+	std::vector<std::thread> workers;
+	workers.reserve( threads.size() );
+	bench::stopwatch sw;
+	for(std::size_t t = 0; t < threads.size(); t++)
+		workers.push_back( std::thread( &replay, std::cref(h), std::cref(threads[t]), blocks.data(), std::ref(ready), threads.size() ) );
+	for(std::size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+	const double ns = sw.elapsed_ns();
+	done.store(true);
+	monitor.join();
+	peak_rss = std::max( peak_rss, bench::rss_bytes() );
+	// blocks still live at the end of the trace
+	for(std::size_t i = 0; i < allocations; i++) {
+		void* ptr = blocks[i].load(std::memory_order_relaxed);
+		if(NULL != ptr)
+			h.free(ptr, sizes[i]);
+	}
+
+	std::printf("{\"trace\":\"%s\",\"heap\":\"%s\",\"threads\":%zu,\"ops\":%zu,\"seconds\":%.6f,\"ops_per_sec\":%.0f,\"baseline_rss_kb\":%zu,\"peak_rss_kb\":%zu}\n",
+				argv[1], h.name.c_str(), threads.size(), ops, ns / 1E9, ops / ns * 1E9, baseline_rss / 1024, peak_rss / 1024);
+	return 0;
+}
@@ -0,0 +1,110 @@
+#ifndef __SMALL_OBJECT_ALLOCATION_TRACE_HPP_INCLUDED__
+#define __SMALL_OBJECT_ALLOCATION_TRACE_HPP_INCLUDED__
+
+#include "config.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+#ifndef _SOBJ_TRACE_BUFFER_RECORDS
+// count of records buffered by a thread before they are copied into the log
+#	define _SOBJ_TRACE_BUFFER_RECORDS 4096
+#endif // _SOBJ_TRACE_BUFFER_RECORDS
+
+namespace smallobject {
+
+/// Trace log file header, followed by the blocks of records
+struct trace_file_header {
+	/// "SOTRACE1"
+	char magic[8];
+	/// bytes of blocks following the header
+	uint64_t data_size;
+	/// count of records lost because the log was full
+	uint64_t dropped;
+	/// count of traced threads
+	uint64_t threads;
+};
+
+/// Block of the records of a single thread, in the order they happened
+struct trace_block_header {
+	/// traced thread index, from 0 in order of the first allocator call
+	uint32_t thread;
+	/// count of records following the block header
+	uint32_t count;
+};
+
+/// \brief Allocator call record, 16 bytes
+struct trace_record {
+	enum operation {
+		MALLOC = 0,
+		FREE = 1
+	};
+	/// nanoseconds since the trace start
+	uint64_t timestamp;
+	/// block address shifted by 3 in upper 48 bits, operation in bit 8 and size in lower 8 bits
+	uint64_t info;
+
+	BOOST_FORCEINLINE operation op() const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return static_cast<operation>( (info >> 8) & 1 );
+	}
+	BOOST_FORCEINLINE std::size_t size() const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return static_cast<std::size_t>(info & 0xFF);
+	}
+	/// \return block address, identifies an allocation until it is released
+	BOOST_FORCEINLINE uint64_t address() const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return (info >> 16) << 3;
+	}
+};
+
+/**
+ * \brief Records the small object allocator calls into a memory mapped log file, enabled by building
+ *  the library with SO_TRACE. Records small objects allocated outside of regions.
+ *  Every thread appends the records into its own buffer without waiting for other threads, and takes a lock
+ *  only to copy a full buffer into the log, so that recording perturbs allocation timing very little.
+ *  When recording is stopped, allocation cost is one relaxed load and branch per call.
+ *  Log can be replayed with bench/trace_replay against other allocator builds.
+ */
+class SYMBOL_VISIBLE allocation_trace
+{
+public:
+	/// Starts recording into a file, available on POSIX systems only
+	/// \param path log file path, file is truncated
+	/// \param capacity maximal log size in bytes, records beyond it are dropped
+	/// \return whether recording was started
+	static bool start(const char* path, const std::size_t capacity = std::size_t(1) << 30) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Stops recording, waits for the threads appending a record at the moment, flushes buffers
+	/// of all threads and closes the log. Calls made by other threads after the stop are not recorded,
+	/// buffers of already exited threads were flushed on thread exit
+	static void stop() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Allocation hook
+	static BOOST_FORCEINLINE void on_malloc(const void* const ptr, const std::size_t size) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if( BOOST_UNLIKELY( _recording.load(boost::memory_order_relaxed) ) )
+			record(trace_record::MALLOC, ptr, size);
+	}
+
+	/// Deallocation hook
+	static BOOST_FORCEINLINE void on_free(const void* const ptr, const std::size_t size) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if( BOOST_UNLIKELY( _recording.load(boost::memory_order_relaxed) ) )
+			record(trace_record::FREE, ptr, size);
+	}
+
+private:
+	static void record(const trace_record::operation op, const void* const ptr, const std::size_t size) BOOST_NOEXCEPT_OR_NOTHROW;
+private:
+	static boost::atomic_bool _recording;
+};
+
+} // namespace smallobject
+
+#endif // __SMALL_OBJECT_ALLOCATION_TRACE_HPP_INCLUDED__
@@ -1,13 +1,23 @@
 #ifndef __SMALLOBJECT_ARENA_HPP_INCLUDED__
 #define __SMALLOBJECT_ARENA_HPP_INCLUDED__
 
-#include <vector>
 #include <boost/atomic.hpp>
+#include <boost/core/no_exceptions_support.hpp>
 #include <boost/throw_exception.hpp>
 
 #include "chunk.hpp"
+#ifdef SO_CHUNK_PROVISIONING
+#	include "chunk_provider.hpp"
+#endif // SO_CHUNK_PROVISIONING
+#include "instrument.hpp"
 #include "noncopyable.hpp"
-#include "range_map.hpp"
+#include "occupancy.hpp"
+#include "perf_counters.hpp"
+#ifdef SO_FLAT_RANGE_MAP
+#	include "flat_range_map.hpp"
+#else
+#	include "range_map.hpp"
+#endif // SO_FLAT_RANGE_MAP
 #include "rw_barrier.hpp"
 
 #ifdef BOOST_HAS_PRAGMA_ONCE
@@ -18,6 +28,30 @@
 #error "Lock free atomics support needed for smallobject"
 #endif // BOOST_ATOMIC_FLAG_LOCK_FREE
 
+#ifndef _SOBJ_CHUNK_COLORS
+// count of cache line offsets chunk payloads are rotated through, 1 disables coloring
+#	define _SOBJ_CHUNK_COLORS 4
+#endif // _SOBJ_CHUNK_COLORS
+
+#ifndef _SOBJ_HUGE_PAGE_SIZE
+// huge page size, chunks of at least a huge page take whole huge pages
+#	define _SOBJ_HUGE_PAGE_SIZE 0x200000
+#endif // _SOBJ_HUGE_PAGE_SIZE
+
+#ifndef _SOBJ_MIN_CHUNK_SIZE
+// bytes of the first chunk of an arena, every next chunk of the arena is twice as large
+#	define _SOBJ_MIN_CHUNK_SIZE _SOBJ_PAGE_SIZE
+#endif // _SOBJ_MIN_CHUNK_SIZE
+
+#ifndef _SOBJ_MAX_CHUNK_SIZE
+// bytes chunks of an arena stop growing at, chunks are also limited by chunk::MAX_BLOCKS blocks
+#	define _SOBJ_MAX_CHUNK_SIZE _SOBJ_HUGE_PAGE_SIZE
+#endif // _SOBJ_MAX_CHUNK_SIZE
+
+#if _SOBJ_MIN_CHUNK_SIZE > _SOBJ_MAX_CHUNK_SIZE
+#error "_SOBJ_MIN_CHUNK_SIZE must not be greater than _SOBJ_MAX_CHUNK_SIZE"
+#endif
+
 namespace smallobject { namespace detail {
 
 /// compares two pointers on allocated memory regions
@@ -39,6 +73,15 @@ struct byte_ptr_less : public std::binary_function<uint8_t*, uint8_t*, bool>
  */
 class arena: public noncopyable {
 private:
+#ifdef SO_FLAT_RANGE_MAP
+	// chunks index in sorted contiguous arrays
+	typedef smallobject::flat_range_map<
+			const uint8_t*,
+			chunk*,
+			byte_ptr_less,
+			sys::allocator< movable_pair< const range<const uint8_t*, byte_ptr_less >, chunk* > >
+			> chunks_rmap;
+#else
 	// a free list (free binary search AVL tree)
 	typedef smallobject::range_map<
 			const uint8_t*,
@@ -46,17 +89,29 @@ private:
 			byte_ptr_less,
 			sys::allocator< movable_pair< const range<uint8_t*, byte_ptr_less >, chunk* > >
 			> chunks_rmap;
+#endif // SO_FLAT_RANGE_MAP
 	typedef chunks_rmap::range_type byte_ptr_range;
+	typedef sys::basic_read_lock<sys::read_mostly_barrier> read_lock;
+	typedef sys::basic_write_lock<sys::read_mostly_barrier> write_lock;
 public:
 
 	/// Constructs new arena of specific block size
 	/// and allocates first chunk of reved virtual memory
 	/// \param block_size size of fixed memory block in bytes
-	explicit arena(const std::size_t block_size);
+	/// \param first_chunk whether to allocate the first chunk, an arena constructed without it
+	/// takes chunks only on lend, and must only lend and reclaim chunks
+	explicit arena(const std::size_t block_size, const bool first_chunk = true);
 
 	/// Releases arena and all allocated virtual memory
 	~arena() BOOST_NOEXCEPT_OR_NOTHROW;
 
+	/// Allocates arena memory at a cache line boundary, so that hot fields,
+	/// synchronization and ownership flag lay on separate cache lines
+	/// \throw std::bad_alloc in case of system out of memory
+	static void* operator new(const std::size_t size);
+
+	static void operator delete(void* const ptr) BOOST_NOEXCEPT_OR_NOTHROW;
+
 	/// Allocates a single memory block of fixed size
 	/// do system lock when thread releases memory allocated by this thread,
 	/// or a thread previusly use this arena
@@ -65,25 +120,27 @@ public:
 	/// calls user provided global boost::throw_exception in noexception mode
 	void* malloc BOOST_PREVENT_MACRO_SUBSTITUTION();
 
-	/// Releases previesly allocated block of memory
-	/// do system lock when thread releases memory allocated by another thread
+	/// Releases previesly allocated block of memory, must be called by the owner thread.
+	/// No lock is taken, since other threads never modify the chunks free stacks, see synch_free
 	/// \param ptr pointer to the allocated memory
 	/// \throw never trows
 	inline bool free BOOST_PREVENT_MACRO_SUBSTITUTION(void const *ptr) BOOST_NOEXCEPT_OR_NOTHROW
 	{
-		const uint8_t *p = static_cast<const uint8_t*>(ptr);
-		if( !try_to_free(p, free_current_) ) {
-			return lookup_chunk_and_free(p);
-		}
-		return true;
+		return do_free( static_cast<const uint8_t*>(ptr) );
 	}
 
 	/// Synchronized version of free, used when one thread is
-	/// allocating memory, and another releasing it
+	/// allocating memory, and another releasing it.
+	/// Block is queued to its chunk, and the owner thread takes it back when it runs out of free blocks
+	/// do read lock
+	/// \return false when block does not belong to this arena
 	BOOST_FORCEINLINE bool synch_free(void const *ptr) BOOST_NOEXCEPT_OR_NOTHROW
 	{
-		sys::write_lock lock(rwb_);
-		return free(ptr);
+		read_lock lock(rwb_);
+		chunks_rmap::iterator it = chunks_.find( static_cast<const uint8_t*>(ptr) );
+		if( it == chunks_.end() )
+			return false;
+		return it->second->release_remote( static_cast<const uint8_t*>(ptr), block_size_ );
 	}
 
 	/// Makes attemp to reserve this arena for thread
@@ -102,11 +159,74 @@ public:
 	/// Shinks no longer used memory, and returns it back to operating system
 	void shrink() BOOST_NOEXCEPT_OR_NOTHROW;
 
+	/// Adds occupancy of this arena chunks into the statistic
+	/// do read lock, counters of the chunks modified by the owner thread at the same time are approximate,
+	/// blocks queued by other threads are counted as used until the owner collects them
+	/// \param stat statistic to update
+	void occupancy(occupancy_stat& stat) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Makes sure the arena has at least the count of free blocks, creates chunks when needed,
+	/// and faults in the pages of the free blocks, so that the next allocations of the owner
+	/// neither call the system allocator nor fault, until the arena is shrunk.
+	/// Must be called by the owner thread
+	/// do system lock
+	/// \param blocks count of free blocks
+	/// \throw std::bad_alloc in case of system out of memory
+	void prepare(const std::size_t blocks);
+
+	/// Locks all chunks of the arena in RAM, and every chunk the arena takes later
+	/// do system lock
+	/// \return false when some chunks were not locked, i.e. the memory lock limit is reached
+	bool lock() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Lends an empty chunk for the exclusive use, i.e. bump pointer allocation.
+	/// Lent chunk is taken out of this arena until it is reclaimed
+	/// do system lock
+	/// \return an empty chunk
+	/// \throw std::bad_alloc in case of system out of memory
+	chunk* lend();
+
+	/// Takes back a chunk previously lent by this arena, all blocks of the chunk become free
+	/// do system lock
+	/// \param cnk lent chunk
+	/// \throw never throws
+	void reclaim(chunk* const cnk) BOOST_NOEXCEPT_OR_NOTHROW;
+
 private:
-	/// Allocates system virtual memory pages for chunk
+	/// Allocates system virtual memory pages for chunk, chunk payload starts
+	/// at the next color offset, slab allocator style.
+	/// Chunk takes the bytes snapped to whole pages, or whole huge pages for the large chunks
+	/// do system lock
+	/// \param bytes size of the chunk
+	/// \param color color of the chunk, moved to the next color
+	/// \throw std::bad_alloc in case of system out of memory
+	BOOST_FORCEINLINE chunk* create_new_chunk(const std::size_t bytes, std::size_t& color);
+
+	/// Takes a spare chunk when there is one, otherwise creates new chunk of this arena
+	/// \throw std::bad_alloc in case of system out of memory
+	BOOST_FORCEINLINE chunk* next_chunk();
+
+	/// \return size of the chunk following a chunk of the bytes, up to _SOBJ_MAX_CHUNK_SIZE
+	static BOOST_FORCEINLINE std::size_t next_chunk_bytes(const std::size_t bytes) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return (bytes << 1) < _SOBJ_MAX_CHUNK_SIZE ? (bytes << 1) : _SOBJ_MAX_CHUNK_SIZE;
+	}
+
+#ifdef SO_CHUNK_PROVISIONING
+	friend class chunk_provider;
+
+	/// Takes a spare chunk, and queues this arena for refilling spares
+	/// do system lock
+	/// \return spare chunk or NULL when no spare chunks left
+	chunk* take_spare() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Creates spare chunks up to _SOBJ_SPARE_CHUNKS, called by the chunk provider thread
 	/// do system lock
-	/// \param size fixed chunk block size
-	static BOOST_FORCEINLINE chunk* create_new_chunk(const std::size_t size);
+	void provision() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Releases all spare chunks, write lock must be held
+	void release_spares() BOOST_NOEXCEPT_OR_NOTHROW;
+#endif // SO_CHUNK_PROVISIONING
 
 	/// Releases system virtual memory back
 	/// do system lock
@@ -114,7 +234,6 @@ private:
 	static BOOST_FORCEINLINE void release_chunk(chunk* const cnk) BOOST_NOEXCEPT_OR_NOTHROW;
 
 	/// Makes attempt to allocate a memory block of fixed size from chunk
-	/// do read lock
 	/// \return pointer on allocated memory block if success, otherwise NULL pointer
 	/// \throw never throws
 	BOOST_FORCEINLINE uint8_t* try_to_alloc(chunk* const cnk) BOOST_NOEXCEPT_OR_NOTHROW;
@@ -130,15 +249,55 @@ private:
 		return false;
 	}
 
+	inline bool do_free(const uint8_t* ptr) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if( !try_to_free(ptr, free_current_) ) {
+			return lookup_chunk_and_free(ptr);
+		}
+		return true;
+	}
+
 	bool lookup_chunk_and_free(const uint8_t* ptr) BOOST_NOEXCEPT_OR_NOTHROW;
 
+	/// Moves the blocks queued by other threads into the free stacks of all chunks, called by the owner
+	void collect() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Releases chunk when it have no allocated blocks
+	/// \return true when chunk was released and must be erased from chunks map
+	static bool release_if_empty(const chunks_rmap::value_type& v) BOOST_NOEXCEPT_OR_NOTHROW;
+
 private:
+	// Field groups start on their own cache lines, and the class size is a whole number of lines.
+	// hot fields used by the owner thread on every call, other threads only read the chunks index under the read lock
 	const std::size_t block_size_;
-	chunks_rmap chunks_;
+	// color of the next chunk
+	std::size_t color_;
+	// bytes of the next chunk, grows with every chunk the arena runs out of blocks for,
+	// written under the write lock
+	std::size_t chunk_bytes_;
 	chunk* alloc_current_;
 	chunk* free_current_;
-	boost::atomic_flag reserved_;
-	sys::read_write_barrier rwb_;
+	chunks_rmap chunks_;
+	// read locked by the threads releasing memory of this arena, the owner malloc and free do not
+	// touch this line, the owner takes the write lock only to change the chunks index
+	BOOST_ALIGNMENT(SO_CACHE_LINE_SIZE) sys::read_mostly_barrier rwb_;
+	// chunks are locked in RAM, under the write lock
+	bool locked_;
+#ifdef SO_CHUNK_PROVISIONING
+	// chunks created ahead by the provider thread, under the write lock
+	chunk* spares_[_SOBJ_SPARE_CHUNKS];
+	std::size_t spare_count_;
+	// color of the next spare chunk, used by the provider thread only
+	std::size_t spare_color_;
+#endif // SO_CHUNK_PROVISIONING
+	// written by the threads looking for a free arena
+	BOOST_ALIGNMENT(SO_CACHE_LINE_SIZE) boost::atomic_flag reserved_;
+#ifdef SO_CHUNK_PROVISIONING
+	// provider queue link, under the provider lock
+	arena* next_provision_;
+	// written under the provider lock, read by the owner without it
+	boost::atomic_bool provision_queued_;
+#endif // SO_CHUNK_PROVISIONING
 };
 
 
@@ -8,6 +8,8 @@
 #include <boost/cstdint.hpp>
 #include <critical_section.hpp>
 
+#include "config.hpp"
+
 #ifdef BOOST_HAS_PRAGMA_ONCE
 #pragma once
 #endif // BOOST_HAS_PRAGMA_ONCE
@@ -15,8 +17,15 @@
 namespace smallobject { namespace detail {
 
 /**
- * \brief A chunk of allocated memory divided on UCHAR_MAX of fixed blocks
- * Can only allocate UCHAR_MAX of fixed size blocks
+ * \brief A chunk of allocated memory divided on up to MAX_BLOCKS of fixed blocks
+ * Count of blocks is chosen by the arena for every chunk, so that chunks grow with the demand.
+ * Free list is a stack of free block indexes laying right after the chunk header, out of the blocks memory,
+ * so that allocating or releasing a block never reads or writes the block itself.
+ * Blocks released by other threads are queued into a lock free stack linked through an array of indexes
+ * following the free stack, with its top on a separate cache line of the header, and the owner moves
+ * them into the free stack with collect. So the owner alone modifies the free stack and counters.
+ * Blocks never allocated yet are handed out with a bump pointer, so that a new chunk
+ * is ready in constant time and its pages are touched only when blocks are used
  */
 class chunk
 {
@@ -30,9 +39,31 @@ class chunk
 #endif // no deleted functions
 public:
 
-	static const uint8_t MAX_BLOCKS;
+	/// index of a block in the chunk
+	typedef uint16_t index_type;
+
+	static const std::size_t MAX_BLOCKS = USHRT_MAX;
+
+	/// header bytes every block takes, its free stack slot and its remote queue link
+	static const std::size_t BLOCK_HEADER_BYTES = 2 * sizeof(index_type);
 
-	chunk(const uint8_t block_size, const uint8_t* begin) BOOST_NOEXCEPT_OR_NOTHROW;
+	/// alignment of the header size, so that blocks of a chunk placed at an aligned address
+	/// right after the header are aligned for any fundamental type
+	static const std::size_t ALIGNMENT = 16;
+
+	/// Constructs chunk in the memory starting with the header
+	/// \param block_size size of fixed memory block
+	/// \param blocks count of blocks, not greater than MAX_BLOCKS
+	/// \param begin first block, at least header_size(blocks) bytes after the chunk address
+	/// \param size bytes of system memory taken by the chunk, including the header
+	chunk(const std::size_t block_size, const std::size_t blocks, const uint8_t* begin, const std::size_t size) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// \return bytes taken by the header of a chunk with the blocks count, including the free stack
+	/// and the remote queue links, rounded up to ALIGNMENT
+	static BOOST_CONSTEXPR std::size_t header_size(const std::size_t blocks) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return ( sizeof(chunk) + blocks * BLOCK_HEADER_BYTES + ALIGNMENT - 1 ) & ~(ALIGNMENT - 1);
+	}
 
 	#if !defined(BOOST_NO_CXX11_DEFAULTED_FUNCTIONS) && !defined(BOOST_NO_CXX11_NON_PUBLIC_DEFAULTED_FUNCTIONS)
 	~chunk() = default;
@@ -47,10 +78,10 @@ public:
 	{
 		if (0 == free_blocks_)
 			return NULL;
-		uint8_t *result = const_cast<uint8_t*>( begin_ + (position_ * block_size) );
-		position_ = *result;
 		--free_blocks_;
-		return result;
+		// released blocks are reused first, since they are likely in cache
+		const std::size_t idx = 0 != top_ ? free_stack()[--top_] : bump_++;
+		return const_cast<uint8_t*>( begin_ + (idx * block_size) );
 	}
 	/**
 	 * Releases previusly allocated memory if pointer is from this chunk
@@ -60,18 +91,75 @@ public:
 	 */
 	BOOST_FORCEINLINE bool release(const uint8_t* ptr,const std::size_t block_size) BOOST_NOEXCEPT_OR_NOTHROW
 	{
-		if( ptr <= end_ && ptr >= begin_)
+		if( ptr < begin_ || ptr >= end_ )
 			return false;
-		*(const_cast<uint8_t*>(ptr)) = position_;
 		const std::size_t p =  ( reinterpret_cast<size_t>(ptr) - reinterpret_cast<size_t>(begin_) ) / block_size;
-		position_ =  static_cast<uint8_t>(p);
+		free_stack()[top_++] = static_cast<index_type>(p);
 		++free_blocks_;
 		return true;
 	}
 
+	/**
+	 * Queues a block released by a thread which does not own the chunk, the block stays allocated
+	 * until the owner collects it. Neither the block memory nor the owner fields are written
+	 * \param ptr pointer on allocated memory
+	 * \param bloc_size size of fixed allocated block
+	 * \return true when the block belongs to this chunk, otherwise false
+	 */
+	BOOST_FORCEINLINE bool release_remote(const uint8_t* ptr,const std::size_t block_size) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if( ptr < begin_ || ptr >= end_ )
+			return false;
+		const index_type idx = static_cast<index_type>( ( reinterpret_cast<size_t>(ptr) - reinterpret_cast<size_t>(begin_) ) / block_size );
+		index_type* const links = remote_links();
+		index_type top = remote_top_.load(boost::memory_order_relaxed);
+		do {
+			links[idx] = top;
+		} while( !remote_top_.compare_exchange_weak(top, idx, boost::memory_order_release, boost::memory_order_relaxed) );
+		return true;
+	}
+
+	/**
+	 * Moves the blocks queued by release_remote into the free stack, must be called by the owner
+	 */
+	BOOST_FORCEINLINE void collect() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if( NO_BLOCK != remote_top_.load(boost::memory_order_relaxed) )
+			collect_remote();
+	}
+
+	/**
+	 * Makes all blocks of the chunk free, regardless of whether they were allocated
+	 */
+	void reset() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/**
+	 * Writes every page of the never allocated blocks, and of the free stack above the top,
+	 * so that the next allocations and releases do not fault. Allocated blocks are not touched
+	 * \param block_size size of fixed allocated block
+	 */
+	void prefault(const std::size_t block_size) BOOST_NOEXCEPT_OR_NOTHROW;
+
 	BOOST_FORCEINLINE bool empty() BOOST_NOEXCEPT_OR_NOTHROW
 	{
-		return MAX_BLOCKS == free_blocks_;
+		return blocks_ == free_blocks_;
+	}
+
+	BOOST_FORCEINLINE std::size_t free_blocks() const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return free_blocks_;
+	}
+
+	/// \return count of blocks in the chunk
+	BOOST_FORCEINLINE std::size_t blocks() const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return blocks_;
+	}
+
+	/// \return bytes of system memory taken by the chunk, including the header
+	BOOST_FORCEINLINE std::size_t size() const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return size_;
 	}
 
 	BOOST_FORCEINLINE const uint8_t* begin() {
@@ -82,11 +170,38 @@ public:
 		return end_;
 	}
 
+private:
+	// empty remote queue mark, never a block index since indexes are less than MAX_BLOCKS
+	static const index_type NO_BLOCK = USHRT_MAX;
+
+	// indexes of released blocks, last released block is allocated first
+	BOOST_FORCEINLINE index_type* free_stack() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return reinterpret_cast<index_type*>(this + 1);
+	}
+
+	// index of the next queued block for every queued block
+	BOOST_FORCEINLINE index_type* remote_links() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return free_stack() + blocks_;
+	}
+
+	void collect_remote() BOOST_NOEXCEPT_OR_NOTHROW;
+
 private:
 	const uint8_t* begin_;
 	const uint8_t* end_;
-	uint8_t free_blocks_;
-	uint8_t position_;
+	uint32_t size_;
+	// count of blocks
+	index_type blocks_;
+	// count of free blocks, released and never allocated
+	index_type free_blocks_;
+	// top of the released blocks stack
+	index_type top_;
+	// index of the first never allocated block
+	index_type bump_;
+	// last queued block released by other threads, or NO_BLOCK
+	BOOST_ALIGNMENT(SO_CACHE_LINE_SIZE) boost::atomic<index_type> remote_top_;
 };
 
 } } // { namespace smallobject { namespace detail
@@ -0,0 +1,66 @@
+#ifndef __SMALL_OBJECT_CHUNK_PROVIDER_HPP_INCLUDED__
+#define __SMALL_OBJECT_CHUNK_PROVIDER_HPP_INCLUDED__
+
+#include "config.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "critical_section.hpp"
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+#ifndef _SOBJ_SPARE_CHUNKS
+// count of spare chunks an arena keeps ready when SO_CHUNK_PROVISIONING is defined
+#	define _SOBJ_SPARE_CHUNKS 2
+#endif // _SOBJ_SPARE_CHUNKS
+
+namespace smallobject { namespace detail {
+
+class arena;
+
+/**
+ * \brief Background thread creating spare chunks for the arenas, enabled by SO_CHUNK_PROVISIONING.
+ *  An arena running out of free blocks queues itself, and the provider thread refills the arena spares
+ *  up to _SOBJ_SPARE_CHUNKS, so that the system allocator calls and the chunk header page faults
+ *  happen out of the allocating threads.
+ *  Provider is never destroyed, since arenas are released by the atexit handlers
+ *  while the provider thread may still run
+ */
+class chunk_provider
+{
+private:
+	chunk_provider();
+	static chunk_provider* instance() BOOST_NOEXCEPT_OR_NOTHROW;
+	void run() BOOST_NOEXCEPT_OR_NOTHROW;
+public:
+	/// Queues the arena for refilling its spare chunks, starts the provider thread on the first call
+	/// \param ar arena to refill, queued only once until refilled
+	/// \throw never throws, arena stays without spare chunks when the thread can not be started
+	/// or the provider lock fails
+	static void request(arena* const ar) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Removes the arena from the queue, and waits until the provider thread finishes refilling it,
+	/// must be called before the arena is destroyed
+	/// \param ar arena to remove
+	static void cancel(arena* const ar) BOOST_NOEXCEPT_OR_NOTHROW;
+private:
+	boost::mutex mtx_;
+	// signaled when an arena is queued
+	boost::condition_variable queued_;
+	// signaled when an arena is refilled
+	boost::condition_variable refilled_;
+	arena* head_;
+	arena* tail_;
+	// arena the provider thread refills right now
+	arena* current_;
+	static sys::critical_section _smtx;
+	static boost::atomic<chunk_provider*> _instance;
+};
+
+} } // namespace smallobject { namespace detail
+
+#endif // __SMALL_OBJECT_CHUNK_PROVIDER_HPP_INCLUDED__
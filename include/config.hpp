@@ -21,4 +21,25 @@
 #	define SYMBOL_VISIBLE BOOST_SYMBOL_VISIBLE
 #endif // win32
 
+// CPU data cache line size, used to keep data modified by different threads in separate lines
+#ifndef SO_CACHE_LINE_SIZE
+#	define SO_CACHE_LINE_SIZE 64
+#endif // SO_CACHE_LINE_SIZE
+
+// system memory page size, chunks take whole pages
+#ifndef _SOBJ_PAGE_SIZE
+#	define _SOBJ_PAGE_SIZE 0x1000
+#endif // _SOBJ_PAGE_SIZE
+
+// thread local storage class specifier
+#ifndef SO_THREAD_LOCAL
+#	if defined(__GNUC__) || defined(__clang__)
+#		define SO_THREAD_LOCAL __thread
+#	elif defined(_MSC_VER)
+#		define SO_THREAD_LOCAL __declspec(thread)
+#	else
+#		define SO_THREAD_LOCAL thread_local
+#	endif // compiler
+#endif // SO_THREAD_LOCAL
+
 #endif // CONFIG_HPP_INCLUDED
@@ -0,0 +1,125 @@
+#ifndef __SMALL_OBJECT_DISTRIBUTED_RWB_HPP_INCLUDED__
+#define __SMALL_OBJECT_DISTRIBUTED_RWB_HPP_INCLUDED__
+
+#include "config.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/thread/thread_only.hpp>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+#ifndef _SOBJ_RWB_SLOTS
+// count of reader slots in distributed barrier, must be power of 2
+#	define _SOBJ_RWB_SLOTS 16
+#endif // _SOBJ_RWB_SLOTS
+
+namespace smallobject { namespace sys {
+
+namespace detail {
+
+/// Returns a reader slot of the current thread, threads are assigned to slots in round robin
+inline std::size_t rwb_thread_slot() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	static boost::atomic_size_t next_slot(0);
+	static SO_THREAD_LOCAL std::size_t slot = 0;
+	// 0 means not assigned yet
+	if(0 == slot)
+		slot = ( next_slot.fetch_add(1, boost::memory_order_relaxed) & (_SOBJ_RWB_SLOTS - 1) ) + 1;
+	return slot - 1;
+}
+
+/// Busy wait with exponential back-off, gives up the time slice when waiting is long
+inline void rwb_backoff(unsigned int& count) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	if(count < 16) {
+		for(unsigned int i = 0; i < (1U << count); i++)
+			boost::atomic_signal_fence(boost::memory_order_seq_cst);
+		++count;
+	} else {
+		boost::this_thread::yield();
+	}
+}
+
+} // namespace detail
+
+/// \brief Slim reader/writer barrier for read mostly data.
+/// Readers announce themselves in one of the reader slots, each slot takes its own cache line,
+/// so that readers from different threads do not bounce a shared cache line.
+/// Writers are serialized, and wait for all slots to drain. Writer is expensive,
+/// since it scans all the slots, use it for data that rarely changes.
+class distributed_read_write_barrier
+{
+#ifndef BOOST_NO_CXX11_DELETED_FUNCTIONS
+	distributed_read_write_barrier(const distributed_read_write_barrier&) = delete;
+	distributed_read_write_barrier& operator=(const distributed_read_write_barrier&) = delete;
+#else
+private:
+	distributed_read_write_barrier(const distributed_read_write_barrier&);
+	distributed_read_write_barrier& operator=(const distributed_read_write_barrier&);
+#endif // BOOST_NO_CXX11_DELETED_FUNCTIONS
+private:
+	struct reader_slot {
+		boost::atomic_size_t readers;
+		uint8_t padding[SO_CACHE_LINE_SIZE - sizeof(boost::atomic_size_t)];
+		reader_slot():
+			readers(0)
+		{}
+	};
+public:
+	distributed_read_write_barrier() BOOST_NOEXCEPT_OR_NOTHROW:
+		writer_(false)
+	{}
+
+	inline void read_lock() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		boost::atomic_size_t& readers = slots_[ detail::rwb_thread_slot() ].readers;
+		unsigned int backoff = 0;
+		for(;;) {
+			// announce reader before checking writer, pairs with write_lock
+			readers.fetch_add(1, boost::memory_order_seq_cst);
+			if( !writer_.load(boost::memory_order_seq_cst) )
+				return;
+			// writer is active, step back and let it go
+			readers.fetch_sub(1, boost::memory_order_release);
+			while( writer_.load(boost::memory_order_relaxed) )
+				detail::rwb_backoff(backoff);
+		}
+	}
+
+	inline void read_unlock() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		slots_[ detail::rwb_thread_slot() ].readers.fetch_sub(1, boost::memory_order_release);
+	}
+
+	inline void write_lock() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		unsigned int backoff = 0;
+		bool expected = false;
+		while( !writer_.compare_exchange_weak(expected, true, boost::memory_order_seq_cst, boost::memory_order_relaxed) ) {
+			expected = false;
+			detail::rwb_backoff(backoff);
+		}
+		// new readers are stepping back now, wait for the active readers to leave
+		for(std::size_t i = 0; i < _SOBJ_RWB_SLOTS; i++) {
+			backoff = 0;
+			while( 0 != slots_[i].readers.load(boost::memory_order_seq_cst) )
+				detail::rwb_backoff(backoff);
+		}
+	}
+
+	inline void write_unlock() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		writer_.store(false, boost::memory_order_release);
+	}
+
+private:
+	reader_slot slots_[_SOBJ_RWB_SLOTS];
+	uint8_t padding_[SO_CACHE_LINE_SIZE];
+	boost::atomic_bool writer_;
+};
+
+}} // namespace smallobject { namespace sys
+
+#endif // __SMALL_OBJECT_DISTRIBUTED_RWB_HPP_INCLUDED__
@@ -0,0 +1,137 @@
+#ifndef __SMALLOBJECT_EPOCH_HPP_INCLUDED__
+#define __SMALLOBJECT_EPOCH_HPP_INCLUDED__
+
+#include "config.hpp"
+
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "noncopyable.hpp"
+#include "sys_allocator.hpp"
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+#ifndef _SOBJ_EPOCH_COLLECT_THRESHOLD
+// count of retired pointers in thread, which triggers reclamation attempt
+#	define _SOBJ_EPOCH_COLLECT_THRESHOLD 64
+#endif // _SOBJ_EPOCH_COLLECT_THRESHOLD
+
+namespace smallobject {
+
+/**
+ * \brief Epoch based memory reclamation domain
+ *  Readers enter a critical region with the guard, and only announce current
+ *  global epoch in the thread own cache line, so that they never write shared memory.
+ *  Writers unlink shared data, and retire it. Retired memory is released
+ *  when all threads which were in critical region at the moment of retire have left it,
+ *  i.e. when global epoch have been advanced twice.
+ */
+class SYMBOL_VISIBLE epoch_domain: public detail::noncopyable
+{
+public:
+	typedef void (*deleter_f)(void*);
+
+	/// \brief Intrusive limbo list link, lets to retire an object without allocating memory.
+	/// Embedded into the retired object, and filled by retire
+	struct retired_hook {
+		retired_hook* next;
+		deleter_f deleter;
+		std::size_t epoch;
+	};
+
+	/// \brief RAII read side critical region, can be nested
+	class guard: public detail::noncopyable {
+	public:
+		explicit guard(epoch_domain& domain):
+			domain_(domain)
+		{
+			domain_.enter();
+		}
+		~guard() BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			domain_.leave();
+		}
+	private:
+		epoch_domain& domain_;
+	};
+
+	/// Returns process wide epoch domain
+	static epoch_domain* instance();
+
+	epoch_domain();
+	~epoch_domain() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Enters read side critical region on current thread
+	void enter();
+
+	/// Leaves read side critical region on current thread
+	void leave() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Defers releasing of unlinked shared memory, until no reader can access it
+	/// \param ptr pointer to retire
+	/// \param deleter function to be called on pointer when it is safe
+	/// \throw std::bad_alloc when limbo list can not grow, pointer is not retired in this case
+	void retire(void* ptr, deleter_f deleter);
+
+	/// Defers releasing of an object which embeds the limbo list link, until no reader can access it
+	/// \param hook link embedded into the retired object
+	/// \param deleter function to be called on the hook address when it is safe
+	/// \throw never throws, hook is parked in the domain wide list when thread record can not be allocated
+	void retire(retired_hook* const hook, deleter_f deleter) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Makes an attempt to advance global epoch, and releases all
+	/// memory retired by current thread which can be safely released
+	void collect();
+
+private:
+	struct retired {
+		void *ptr;
+		deleter_f deleter;
+		std::size_t epoch;
+	};
+
+	typedef std::vector<retired, sys::allocator<retired> > limbo_list;
+
+	// each record is owned by only one thread at time,
+	// and padded so that records of different threads never share a cache line
+	struct thread_record {
+		boost::atomic_size_t epoch;
+		boost::atomic_bool in_use;
+		std::size_t nesting;
+		std::size_t retired_count;
+		thread_record* next;
+		limbo_list limbo;
+		retired_hook* hooks;
+		epoch_domain* domain;
+		uint8_t padding[SO_CACHE_LINE_SIZE];
+		explicit thread_record(epoch_domain* const owner);
+	};
+
+	thread_record* local_record();
+	bool try_advance() BOOST_NOEXCEPT_OR_NOTHROW;
+	void reclaim(thread_record* const rec, const bool all) BOOST_NOEXCEPT_OR_NOTHROW;
+	void reclaim_orphans(const std::size_t safe, const bool all) BOOST_NOEXCEPT_OR_NOTHROW;
+	void push_orphans(retired_hook* const first, retired_hook* const last) BOOST_NOEXCEPT_OR_NOTHROW;
+	static retired_hook* reclaim_hooks(retired_hook* it, const std::size_t safe, const bool all) BOOST_NOEXCEPT_OR_NOTHROW;
+	static void release_record(thread_record* rec) BOOST_NOEXCEPT_OR_NOTHROW;
+	static void release() BOOST_NOEXCEPT_OR_NOTHROW;
+
+private:
+	static sys::critical_section _smtx;
+	static boost::atomic<epoch_domain*> _instance;
+
+	uint8_t padding_[SO_CACHE_LINE_SIZE];
+	boost::atomic_size_t global_epoch_;
+	boost::atomic<thread_record*> records_;
+	// hooks retired by threads without a record, and memory retired by exited threads
+	boost::atomic<retired_hook*> orphans_;
+	boost::thread_specific_ptr<thread_record> local_;
+};
+
+} // namespace smallobject
+
+#endif // __SMALLOBJECT_EPOCH_HPP_INCLUDED__
@@ -0,0 +1,299 @@
+#ifndef __SMALL_OBJECT_FLAT_RANGE_MAP_HPP_INCLUDED__
+#define __SMALL_OBJECT_FLAT_RANGE_MAP_HPP_INCLUDED__
+
+#include "range_map.hpp"
+
+#include <algorithm>
+#include <new>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+namespace smallobject {
+
+namespace detail {
+
+/// Branchless binary search on the dense sorted array of the range minimal keys
+/// \param keys sorted array of range minimal keys
+/// \param size count of keys in array
+/// \param key a key to search
+/// \return index of the last key which is not greater then searching key,
+///  or size when searching key is less then all keys
+template<typename K, class C>
+BOOST_FORCEINLINE std::size_t flat_floor_index(const K* keys, const std::size_t size, const K& key) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	C cmp;
+	if(0 == size || cmp(key, keys[0]) )
+		return size;
+	const K* base = keys;
+	std::size_t n = size;
+	while(n > 1) {
+		const std::size_t half = n >> 1;
+#if defined(__GNUC__) || defined(__clang__)
+		// both possible next probes, so memory latency overlaps with comparison
+		__builtin_prefetch( base + (half >> 1) );
+		__builtin_prefetch( base + half + (half >> 1) );
+#endif // __GNUC__
+		// compilers emit conditional move here, no branch miss-predictions
+		base = cmp(key, base[half]) ? base : base + half;
+		n -= half;
+	}
+	return static_cast<std::size_t>(base - keys);
+}
+
+} // namespace detail
+
+/// \brief Flat version of range map, keeps ranges in the sorted contiguous arrays.
+/// Range minimal keys are stored in separate dense array, so that find
+/// touches only few cache lines and do not follow any pointers.
+/// Insert and erase are linear, optimized for the case when
+/// ranges inserted in ascending order i.e. appended.
+/// Iterators are invalidated by insert, erase and clear
+/// \param K key type
+/// \param V value type
+/// \param C key comparator, std::less<K> is default
+/// \param A allocator type, sys::allocator is default
+template<typename K, typename V, class C, class A>
+class basic_flat_range_map {
+#if !defined(BOOST_NO_CXX11_DELETED_FUNCTIONS)
+      basic_flat_range_map( const basic_flat_range_map& ) = delete;
+      basic_flat_range_map& operator=( const basic_flat_range_map& ) = delete;
+#else
+      basic_flat_range_map( const basic_flat_range_map& );
+      basic_flat_range_map& operator=( const basic_flat_range_map& );
+#endif // no deleted functions
+public:
+	typedef K key_type;
+	typedef C key_comparator_type;
+	typedef range<key_type, key_comparator_type> range_type;
+	typedef V mapped_type;
+	typedef A allocator_type;
+	typedef movable_pair<const range_type, mapped_type> value_type;
+	typedef value_type* iterator;
+private:
+	typedef typename allocator_type::template rebind<value_type>::other _values_allocator;
+	typedef typename allocator_type::template rebind<key_type>::other _keys_allocator;
+	static const std::size_t INITIAL_CAPACITY = 16;
+protected:
+	BOOST_CONSTEXPR basic_flat_range_map() BOOST_NOEXCEPT_OR_NOTHROW:
+		keys_(NULL),
+		values_(NULL),
+		size_(0),
+		capacity_(0),
+		keys_allocator_(),
+		values_allocator_()
+	{}
+public:
+
+	~basic_flat_range_map() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		clear();
+		release_storage();
+	}
+
+	inline bool insert(BOOST_FWD_REF(value_type) v)
+	{
+		const std::size_t pos = insert_position(v.first);
+		if(pos > size_)
+			return false;
+		if(size_ == capacity_)
+			grow();
+		shift_right(pos);
+		keys_[pos] = v.first.min();
+		new ( static_cast<void*>(values_ + pos) ) value_type( boost::forward<value_type>(v) );
+		++size_;
+		return true;
+	}
+
+	inline bool insert(BOOST_COPY_ASSIGN_REF(value_type) v)
+	{
+		return insert( BOOST_MOVE_BASE(value_type,v) );
+	}
+
+	inline bool insert(BOOST_FWD_REF(key_type) min, BOOST_FWD_REF(key_type) max, BOOST_FWD_REF(mapped_type) val)
+	{
+		range_type range( boost::forward<key_type>(min), boost::forward<key_type>(max) );
+		return insert( value_type( BOOST_MOVE_BASE(range_type,range), boost::forward<mapped_type>(val) ) );
+	}
+
+	inline iterator begin() BOOST_NOEXCEPT_OR_NOTHROW {
+		return values_;
+	}
+
+	inline iterator end() BOOST_NOEXCEPT_OR_NOTHROW {
+		return values_ + size_;
+	}
+
+	inline iterator find(const key_type& key) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		const std::size_t i = detail::flat_floor_index<key_type,key_comparator_type>(keys_, size_, key);
+		if(i < size_ && 0 == values_[i].first.compare_to_key(key) )
+			return values_ + i;
+		return end();
+	}
+
+	inline bool empty() const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return 0 == size_;
+	}
+
+	inline std::size_t size() const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return size_;
+	}
+
+	inline void erase(const iterator& position)
+	{
+		if(position < values_ || position >= end() )
+			return;
+		const std::size_t pos = static_cast<std::size_t>(position - values_);
+		position->~value_type();
+		std::copy(keys_ + pos + 1, keys_ + size_, keys_ + pos);
+		for(std::size_t i = pos + 1; i < size_; i++)
+			relocate(values_ + i - 1, values_ + i);
+		--size_;
+	}
+
+	inline void clear() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		for(std::size_t i = 0; i < size_; i++)
+			values_[i].~value_type();
+		size_ = 0;
+	}
+
+	/// Erases all elements satisfying the predicate with a single compacting pass in O(n)
+	/// \param pred unary predicate, called exactly once for each element in ascending order
+	/// \return count of erased elements
+	template<class P>
+	std::size_t erase_if(P pred)
+	{
+		std::size_t kept = 0;
+		for(std::size_t i = 0; i < size_; i++) {
+			if( pred( const_cast<const value_type&>(values_[i]) ) ) {
+				values_[i].~value_type();
+			} else {
+				if(kept != i) {
+					keys_[kept] = keys_[i];
+					relocate(values_ + kept, values_ + i);
+				}
+				++kept;
+			}
+		}
+		const std::size_t erased = size_ - kept;
+		size_ = kept;
+		return erased;
+	}
+
+	/// Replaces content with elements from a sorted sequence of non overlapping ranges in O(n)
+	/// \param first iterator on the first element of sorted sequence
+	/// \param last iterator after the last element of sorted sequence
+	template<class I>
+	void assign(I first, I last)
+	{
+		clear();
+		for(; first != last; ++first) {
+			if(size_ == capacity_)
+				grow();
+			new ( static_cast<void*>(values_ + size_) ) value_type(*first);
+			assert( 0 == size_ || 1 == values_[size_].first.compare_to( values_[size_-1].first ) );
+			keys_[size_] = values_[size_].first.min();
+			++size_;
+		}
+	}
+
+private:
+
+	static BOOST_FORCEINLINE void relocate(value_type* const dst, value_type* const src)
+	{
+		new ( static_cast<void*>(dst) ) value_type( boost::move(*src) );
+		src->~value_type();
+	}
+
+	// returns size_ + 1 when range overlaps with an existing one
+	std::size_t insert_position(const range_type& r) const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		std::size_t pos = detail::flat_floor_index<key_type,key_comparator_type>(keys_, size_, r.min());
+		pos = (pos == size_) ? 0 : pos + 1;
+		if(pos > 0 && 1 != r.compare_to(values_[pos-1].first) )
+			return size_ + 1;
+		if(pos < size_ && -1 != r.compare_to(values_[pos].first) )
+			return size_ + 1;
+		return pos;
+	}
+
+	void shift_right(const std::size_t pos)
+	{
+		if(pos == size_)
+			return;
+		std::copy_backward(keys_ + pos, keys_ + size_, keys_ + size_ + 1);
+		for(std::size_t i = size_; i > pos; i--)
+			relocate(values_ + i, values_ + i - 1);
+	}
+
+	void grow()
+	{
+		const std::size_t new_capacity = (0 == capacity_) ? INITIAL_CAPACITY : capacity_ << 1;
+		key_type* keys = keys_allocator_.allocate(new_capacity);
+		value_type* values = NULL;
+		BOOST_TRY {
+			values = values_allocator_.allocate(new_capacity);
+		} BOOST_CATCH(...) {
+			keys_allocator_.deallocate(keys, new_capacity);
+			BOOST_RETHROW
+		}
+		BOOST_CATCH_END
+		std::copy(keys_, keys_ + size_, keys);
+		for(std::size_t i = 0; i < size_; i++)
+			relocate(values + i, values_ + i);
+		release_storage();
+		keys_ = keys;
+		values_ = values;
+		capacity_ = new_capacity;
+	}
+
+	void release_storage() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if(NULL == keys_)
+			return;
+		keys_allocator_.deallocate(keys_, capacity_);
+		values_allocator_.deallocate(values_, capacity_);
+		keys_ = NULL;
+		values_ = NULL;
+		capacity_ = 0;
+	}
+
+private:
+	key_type* keys_;
+	value_type* values_;
+	std::size_t size_;
+	std::size_t capacity_;
+	_keys_allocator keys_allocator_;
+	_values_allocator values_allocator_;
+};
+
+/// \brief Associative sorted container where key can be in range of values
+/// Based on sorted contiguous arrays, optimized for search and iteration
+/// when insertion and erase operations are time expensive.
+/// Has the same interface as range_map
+/// \param K key type
+/// \param V value type
+/// \param C key comparator, std::less<K> is default
+/// \param A allocator type, sys::allocator is default
+template<
+		typename K, typename V,
+		class C = std::less<K>,
+		class A = sys::allocator< movable_pair< const range<K,C>, V > >
+		>
+class flat_range_map:public basic_flat_range_map<K,V,C,A>
+{
+private:
+	typedef basic_flat_range_map<K,V,C,A> base_type;
+public:
+	BOOST_CONSTEXPR flat_range_map()
+	{}
+};
+
+} // namespace smallobject
+
+#endif // __SMALL_OBJECT_FLAT_RANGE_MAP_HPP_INCLUDED__
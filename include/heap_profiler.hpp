@@ -0,0 +1,79 @@
+#ifndef __SMALL_OBJECT_HEAP_PROFILER_HPP_INCLUDED__
+#define __SMALL_OBJECT_HEAP_PROFILER_HPP_INCLUDED__
+
+#include "config.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+#ifndef _SOBJ_PROFILER_MAX_DEPTH
+// maximal count of stack frames captured for a sample
+#	define _SOBJ_PROFILER_MAX_DEPTH 32
+#endif // _SOBJ_PROFILER_MAX_DEPTH
+
+#ifndef _SOBJ_PROFILER_FILTER_SIZE
+// count of address filter cells, used to skip free of not sampled memory, must be power of 2
+#	define _SOBJ_PROFILER_FILTER_SIZE 4096
+#endif // _SOBJ_PROFILER_FILTER_SIZE
+
+namespace smallobject {
+
+/**
+ * \brief Sampling heap profiler for the small object allocator, enabled by building the library
+ *  with SO_HEAP_PROFILER. Samples small objects allocated outside of regions.
+ *  Captures a stack trace on average every sample period bytes, intervals between samples have
+ *  geometric distribution so that sampling is not biased by allocation patterns.
+ *  Live samples are kept until the memory is released, and can be dumped in gperftools
+ *  heap profile format, readable with pprof.
+ *  When profiler is stopped, allocation cost is one decrement and branch per malloc,
+ *  and one filter cell load and branch per free.
+ */
+class SYMBOL_VISIBLE heap_profiler
+{
+public:
+	/// Starts sampling
+	/// \param sample_period average count of allocated bytes between two samples
+	static void start(const std::size_t sample_period = 512 * 1024) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Stops sampling, live samples are kept until memory is released
+	static void stop() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Writes the current heap profile into a file
+	/// \param path profile file path
+	/// \return whether profile was written
+	static bool dump(const char* path) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Allocation hook
+	static BOOST_FORCEINLINE void on_malloc(void* const ptr, const std::size_t size) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		_bytes_until_sample -= static_cast<std::ptrdiff_t>(size);
+		if( BOOST_UNLIKELY(_bytes_until_sample < 0) )
+			sample(ptr, size);
+	}
+
+	/// Deallocation hook
+	static BOOST_FORCEINLINE void on_free(const void* const ptr) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if( BOOST_UNLIKELY( 0 != _filter[ filter_cell(ptr) ].load(boost::memory_order_relaxed) ) )
+			forget(ptr);
+	}
+
+private:
+	static BOOST_FORCEINLINE std::size_t filter_cell(const void* const ptr) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return ( reinterpret_cast<std::size_t>(ptr) >> 3 ) & (_SOBJ_PROFILER_FILTER_SIZE - 1);
+	}
+	static void sample(void* const ptr, const std::size_t size) BOOST_NOEXCEPT_OR_NOTHROW;
+	static void forget(const void* const ptr) BOOST_NOEXCEPT_OR_NOTHROW;
+private:
+	static SO_THREAD_LOCAL std::ptrdiff_t _bytes_until_sample;
+	static boost::atomic<uint16_t> _filter[_SOBJ_PROFILER_FILTER_SIZE];
+};
+
+} // namespace smallobject
+
+#endif // __SMALL_OBJECT_HEAP_PROFILER_HPP_INCLUDED__
@@ -0,0 +1,65 @@
+#ifndef __SMALL_OBJECT_INSTRUMENT_HPP_INCLUDED__
+#define __SMALL_OBJECT_INSTRUMENT_HPP_INCLUDED__
+
+#include "config.hpp"
+
+#include <boost/cstdint.hpp>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+namespace smallobject {
+
+/// Allocator slow path events
+enum slow_path_event {
+	/// new chunk was allocated from the system
+	NEW_CHUNK = 0,
+	/// current chunk was full, and arena scanned the chunks for a free block
+	CHUNK_SCAN,
+	/// memory was released by a thread which does not own the arena, and queued to its chunk under the read lock
+	REMOTE_FREE,
+	/// arena returned empty chunks to the system
+	SHRINK,
+	SLOW_PATH_EVENTS_COUNT
+};
+
+/**
+ * \brief Per thread counters of the allocator slow path events, enabled by SO_INSTRUMENT.
+ *  Counters are plain thread local integers, so that a benchmark can read them before and after
+ *  an allocator call, and attribute the call latency to the slow path events happened inside.
+ *  When SO_INSTRUMENT is not defined counters stay zero, and hooks compile to nothing.
+ */
+class SYMBOL_VISIBLE instrument
+{
+public:
+	/// \return whether the library was built with SO_INSTRUMENT
+	static bool enabled() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// \return event name
+	static const char* name(const slow_path_event ev) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// \return count of events happened in the current thread
+	static BOOST_FORCEINLINE uint64_t count(const slow_path_event ev) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return _events[ev];
+	}
+
+	/// Counts an event in the current thread
+	static BOOST_FORCEINLINE void record(const slow_path_event ev) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		++_events[ev];
+	}
+private:
+	static SO_THREAD_LOCAL uint64_t _events[SLOW_PATH_EVENTS_COUNT];
+};
+
+} // namespace smallobject
+
+#ifdef SO_INSTRUMENT
+#	define SO_INSTRUMENT_EVENT(ev) smallobject::instrument::record( smallobject::ev )
+#else
+#	define SO_INSTRUMENT_EVENT(ev)
+#endif // SO_INSTRUMENT
+
+#endif // __SMALL_OBJECT_INSTRUMENT_HPP_INCLUDED__
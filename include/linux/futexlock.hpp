@@ -0,0 +1,99 @@
+#ifndef __SMALLOBJECT_LINUX_FUTEXLOCK_HPP_INCLUDED__
+#define __SMALLOBJECT_LINUX_FUTEXLOCK_HPP_INCLUDED__
+
+#include <boost/config.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/static_assert.hpp>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+#ifndef _SOBJ_FUTEX_MAX_SPIN
+// upper bound of adaptive spinning iterations before parking on futex
+#	define _SOBJ_FUTEX_MAX_SPIN 1000
+#endif // _SOBJ_FUTEX_MAX_SPIN
+
+namespace smallobject { namespace sys {
+
+/// Hints CPU that current thread is in a spin wait loop
+BOOST_FORCEINLINE void cpu_relax() BOOST_NOEXCEPT_OR_NOTHROW
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield" ::: "memory");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif // cpu
+}
+
+/// !\brief Linux adaptive spin then park lock.
+/// Spins a bounded number of iterations learned from the previous acquisitions
+/// (like glibc PTHREAD_MUTEX_ADAPTIVE_NP), and then sleeps on futex so that
+/// waiters do not burn CPU time slices when lock holder is de-scheduled
+class futex_lock:private boost::noncopyable
+{
+	private:
+		BOOST_STATIC_ASSERT_MSG( sizeof(boost::atomic<int>) == sizeof(int), "futex word must be a plain int");
+		// lock states, according to U. Drepper "Futexes Are Tricky"
+		static const int UNLOCKED = 0;
+		static const int LOCKED = 1;
+		static const int CONTENDED = 2;
+	public:
+		futex_lock() BOOST_NOEXCEPT_OR_NOTHROW:
+			state_(UNLOCKED),
+			spin_(0)
+		{}
+		BOOST_FORCEINLINE void lock() BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			if( !try_lock() )
+				lock_slow();
+		}
+		BOOST_FORCEINLINE bool try_lock() BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			int expected = UNLOCKED;
+			return state_.compare_exchange_strong(expected, LOCKED, boost::memory_order_acquire, boost::memory_order_relaxed);
+		}
+		BOOST_FORCEINLINE void unlock() BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			if( CONTENDED == state_.exchange(UNLOCKED, boost::memory_order_release) )
+				futex(FUTEX_WAKE_PRIVATE, 1);
+		}
+	private:
+		BOOST_NOINLINE void lock_slow() BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			const int spin = spin_.load(boost::memory_order_relaxed);
+			const int max_spin = (spin * 2 + 10) < _SOBJ_FUTEX_MAX_SPIN ? (spin * 2 + 10) : _SOBJ_FUTEX_MAX_SPIN;
+			int count = 0;
+			for(; count < max_spin; count++) {
+				cpu_relax();
+				// test and test and set, do not bounce the cache line while owner holds the lock
+				if( UNLOCKED == state_.load(boost::memory_order_relaxed) && try_lock() ) {
+					spin_.store( spin + (count - spin) / 8, boost::memory_order_relaxed );
+					return;
+				}
+			}
+			spin_.store( spin + (count - spin) / 8, boost::memory_order_relaxed );
+			// park, mark lock as contended so that owner wakes us on unlock
+			while( UNLOCKED != state_.exchange(CONTENDED, boost::memory_order_acquire) )
+				futex(FUTEX_WAIT_PRIVATE, CONTENDED);
+		}
+		inline void futex(const int op, const int value) BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			::syscall(SYS_futex, reinterpret_cast<int*>(&state_), op, value, NULL, NULL, 0);
+		}
+	private:
+		boost::atomic<int> state_;
+		// adaptive spin count estimation, updated by waiters only
+		boost::atomic<int> spin_;
+};
+
+}} // namespace smallobject { namespace sys
+
+#endif // __SMALLOBJECT_LINUX_FUTEXLOCK_HPP_INCLUDED__
@@ -8,43 +8,73 @@
 #endif // BOOST_HAS_PRAGMA_ONCE
 
 #include "object_allocator.hpp"
+#include "ref_count.hpp"
 
 namespace smallobject {
 
-class SYMBOL_VISIBLE object
+namespace detail {
+
+/// Allocates memory for a small object
+SYMBOL_VISIBLE void* allocate_object(std::size_t bytes) BOOST_THROWS(std::bad_alloc);
+
+/// Releases memory of a small object
+SYMBOL_VISIBLE void release_object(void *ptr, std::size_t bytes) BOOST_NOEXCEPT_OR_NOTHROW;
+
+} // namespace detail
+
+/// \brief Base class for reference counted objects allocated by the small object allocator
+/// \param R reference count policy: atomic_ref_count, atomic_ref_count32, plain_ref_count, biased_ref_count
+/// or deferred_ref_count
+template<class R>
+class basic_object: public R
 {
 #if !defined(BOOST_NO_CXX11_DELETED_FUNCTIONS)
-	object( const object& ) = delete;
-	object& operator=( const object& ) = delete;
+	basic_object( const basic_object& ) = delete;
+	basic_object& operator=( const basic_object& ) = delete;
 #else
   private:  // emphasize the following members are private
-      object( const object& );
-      object& operator=( const object& );
+      basic_object( const basic_object& );
+      basic_object& operator=( const basic_object& );
 #endif // no deleted functions
 protected:
-	BOOST_CONSTEXPR object() BOOST_NOEXCEPT_OR_NOTHROW:
-		ref_count_(0)
+	basic_object():
+		R()
 	{}
 public:
-	virtual ~object() BOOST_NOEXCEPT_OR_NOTHROW = 0;
+	virtual ~basic_object() BOOST_NOEXCEPT_OR_NOTHROW
+	{}
 	// redefine new and delete operations for small object optimized memory allocation
-	void* operator new(std::size_t bytes) BOOST_THROWS(std::bad_alloc);
-	void operator delete(void *ptr,std::size_t bytes) BOOST_NOEXCEPT_OR_NOTHROW;
+	void* operator new(std::size_t bytes) BOOST_THROWS(std::bad_alloc)
+	{
+		return detail::allocate_object(bytes);
+	}
+	void operator delete(void *ptr,std::size_t bytes) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		detail::release_object(ptr, bytes);
+	}
 private:
-	boost::atomic_size_t ref_count_;
-	friend BOOST_FORCEINLINE void intrusive_ptr_add_ref(object* const obj) noexcept
+	friend BOOST_FORCEINLINE void intrusive_ptr_add_ref(basic_object* const obj) BOOST_NOEXCEPT_OR_NOTHROW
 	{
-		obj->ref_count_.fetch_add(1, boost::memory_order_relaxed);
+		obj->add_ref();
 	}
-	friend BOOST_FORCEINLINE void intrusive_ptr_release(object* const obj) noexcept
+	friend BOOST_FORCEINLINE void intrusive_ptr_release(basic_object* const obj) BOOST_NOEXCEPT_OR_NOTHROW
 	{
-		if (obj->ref_count_.fetch_sub(1, boost::memory_order_release) == 1) {
-			boost::atomic_thread_fence(boost::memory_order_acquire);
-			delete obj;
-		}
+		if( obj->release_ref() )
+			ref_count_disposer<R>::dispose(obj);
 	}
 };
 
+/// \brief Thread safe reference counted small object
+class SYMBOL_VISIBLE object: public basic_object<atomic_ref_count>
+{
+protected:
+	object() BOOST_NOEXCEPT_OR_NOTHROW:
+		basic_object<atomic_ref_count>()
+	{}
+public:
+	virtual ~object() BOOST_NOEXCEPT_OR_NOTHROW = 0;
+};
+
 typedef boost::intrusive_ptr<object> s_object;
 
 } // namesapce smallobject
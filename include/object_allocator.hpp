@@ -22,13 +22,13 @@ class object_allocator:public smallobject::detail::noncopyable
 {
 public:
 	// 64 for 32 bit and 128 for 64 bit instructions
-	static const std::size_t MAX_SIZE;
+	static BOOST_CONSTEXPR_OR_CONST std::size_t MAX_SIZE = sizeof(std::size_t) * 16;
 private:
 	// 8 bytes for 32 bit and 16 bytes for 64 bit
 	static const std::size_t MIN_SIZE;
 	// 2 since object size not changed
 	static const std::size_t SHIFT;
-	// 14 pools
+	// 15 pools
 	static const std::size_t POOLS_COUNT;
 public:
 	static object_allocator* instance();
@@ -36,10 +36,47 @@ public:
 	{
 		return get(size)->malloc(size);
 	}
-	BOOST_FORCEINLINE void free BOOST_PREVENT_MACRO_SUBSTITUTION(void *ptr, const std::size_t size) const BOOST_NOEXCEPT_OR_NOTHROW
+	/// \return false when the memory was not allocated by this allocator, i.e. it is memory of a region
+	BOOST_FORCEINLINE bool free BOOST_PREVENT_MACRO_SUBSTITUTION(void *ptr, const std::size_t size) const BOOST_NOEXCEPT_OR_NOTHROW
 	{
-		get(size)->free(ptr);
+		return get(size)->free(ptr);
 	}
+	/// Returns count of size classes
+	static std::size_t size_classes() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Collects memory occupancy and fragmentation statistic of a size class,
+	/// walks all arenas and chunks under per arena read locks
+	/// \param size_class size class index, less than size_classes(), statistic is all zeros for other values
+	/// \param stat statistic to fill
+	void occupancy(const std::size_t size_class, occupancy_stat& stat) const BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Returns empty chunks of all size classes back to the system, from the current thread arenas
+	/// and from the arenas not reserved by any thread. Arenas of other live threads are shrunk on thread exit
+	void shrink() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Prepares the calling thread arena of a size class, so that the next count of allocations
+	/// of the size class by this thread neither call the system allocator nor fault on memory pages,
+	/// until the memory is shrunk. Creates chunks when needed, and writes their free pages
+	/// \param size_class size class index, less than size_classes()
+	/// \param count count of allocations
+	/// \param lock whether to lock the thread arena memory in RAM as well, including chunks created later
+	/// \return false when the memory could not be locked, i.e. the memory lock limit is reached
+	/// \throw std::out_of_range when size_class is not less than size_classes()
+	/// \throw std::bad_alloc in case of system out of memory
+	bool reserve(const std::size_t size_class, const std::size_t count, const bool lock = false);
+
+	/// Prepares the calling thread arenas of all size classes, see reserve
+	/// \param count count of allocations in every size class
+	/// \param lock whether to lock the thread arenas memory in RAM as well
+	/// \return false when the memory could not be locked
+	/// \throw std::bad_alloc in case of system out of memory
+	bool prepare_thread(const std::size_t count, const bool lock = false);
+
+	/// Locks memory of all arenas of all size classes in RAM, so that it is never swapped out,
+	/// chunks and arenas created later are locked as well
+	/// \return false when some memory could not be locked, i.e. the memory lock limit is reached
+	bool lock_memory() BOOST_NOEXCEPT_OR_NOTHROW;
+
 	~object_allocator() BOOST_NOEXCEPT_OR_NOTHROW;
 private:
 	explicit object_allocator();
@@ -0,0 +1,134 @@
+#ifndef __SMALL_OBJECT_OBJECT_POOL_HPP_INCLUDED__
+#define __SMALL_OBJECT_OBJECT_POOL_HPP_INCLUDED__
+
+#include <boost/core/no_exceptions_support.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+#include "object_allocator.hpp"
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+namespace smallobject {
+
+/**
+ * \brief Typed pool of small objects.
+ *  Objects of the same type are allocated from own set of chunks, so that they are
+ *  placed near each other in memory.
+ *  Pool can keep a cache of released objects in constructed state, in the manner of
+ *  Bonwick slab allocator object caches, so that expensive constructor and destructor
+ *  are skipped on free and reallocate cycles. Object returned to the cache must be
+ *  restored to the state it had just after construction by the user.
+ * \param T object type, must be default constructible, and not bigger then the largest small object size class
+ */
+template<class T>
+class object_pool: public detail::noncopyable {
+	BOOST_STATIC_ASSERT_MSG( sizeof(T) <= detail::object_allocator::MAX_SIZE, "object_pool supports only small objects" );
+	BOOST_STATIC_ASSERT_MSG( boost::alignment_of<T>::value <= sizeof(std::size_t), "over aligned types are not supported" );
+public:
+	typedef T value_type;
+
+	/// Constructs new object pool
+	/// \param cache_limit maximum count of constructed objects kept in cache, 0 disables caching
+	/// \throw std::bad_alloc in case of system out of memory
+	explicit object_pool(const std::size_t cache_limit = 0):
+		mtx_(),
+		arena_( block_size() ),
+		cache_(NULL),
+		cached_(0),
+		cache_limit_(cache_limit)
+	{
+		if(0 != cache_limit_) {
+			cache_ = static_cast<T**>( sys::xmalloc( cache_limit_ * sizeof(T*) ) );
+			if(NULL == cache_)
+				boost::throw_exception( std::bad_alloc() );
+		}
+	}
+
+	/// Destroys all cached objects, and releases all pool memory.
+	/// Objects which were not destroyed become invalid
+	~object_pool() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		purge();
+		if(NULL != cache_)
+			sys::xfree(cache_);
+	}
+
+	/// Returns a cached constructed object, or constructs new one with the default constructor
+	/// \return pointer on object
+	/// \throw std::bad_alloc in case of system out of memory, or any exception thrown by T constructor
+	T* create()
+	{
+		void *ptr;
+		{
+			unique_lock lock(mtx_);
+			if(0 != cached_)
+				return cache_[--cached_];
+			ptr = arena_.malloc();
+		}
+		BOOST_TRY {
+			return new (ptr) T();
+		} BOOST_CATCH(...) {
+			unique_lock lock(mtx_);
+			arena_.free(ptr);
+			BOOST_RETHROW
+		}
+		BOOST_CATCH_END
+		return NULL;
+	}
+
+	/// Returns object into the cache, or destroys it and releases memory when cache is full
+	/// \param obj object created by this pool
+	void destroy(T* const obj) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		{
+			unique_lock lock(mtx_);
+			if(cached_ < cache_limit_) {
+				cache_[cached_++] = obj;
+				return;
+			}
+		}
+		obj->~T();
+		unique_lock lock(mtx_);
+		arena_.free(obj);
+	}
+
+	/// Destroys all cached objects in bulk, and returns no longer used memory
+	/// back to the operating system.
+	/// Destructor of T must not use this pool
+	void purge() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		unique_lock lock(mtx_);
+		while(0 != cached_) {
+			T* obj = cache_[--cached_];
+			obj->~T();
+			arena_.free(obj);
+		}
+		arena_.shrink();
+	}
+
+	/// Returns count of constructed objects kept in cache
+	inline std::size_t cached() const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return cached_;
+	}
+
+private:
+	static BOOST_CONSTEXPR std::size_t block_size() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return detail::align_up( boost::alignment_of<T>::value, sizeof(T) );
+	}
+
+private:
+	sys::critical_section mtx_;
+	detail::arena arena_;
+	T** cache_;
+	std::size_t cached_;
+	const std::size_t cache_limit_;
+};
+
+} // namespace smallobject
+
+#endif // __SMALL_OBJECT_OBJECT_POOL_HPP_INCLUDED__
@@ -0,0 +1,48 @@
+#ifndef __SMALL_OBJECT_OCCUPANCY_HPP_INCLUDED__
+#define __SMALL_OBJECT_OCCUPANCY_HPP_INCLUDED__
+
+#include <boost/config.hpp>
+#include <cstddef>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+#ifndef _SOBJ_OCCUPANCY_BUCKETS
+// count of occupancy histogram buckets
+#	define _SOBJ_OCCUPANCY_BUCKETS 16
+#endif // _SOBJ_OCCUPANCY_BUCKETS
+
+namespace smallobject {
+
+/// \brief Memory occupancy and fragmentation statistic of a size class
+struct occupancy_stat {
+	/// fixed block size of the size class
+	std::size_t block_size;
+	/// count of thread arenas
+	std::size_t arenas;
+	/// count of chunks in all arenas
+	std::size_t chunks;
+	/// count of chunks without allocated blocks
+	std::size_t empty_chunks;
+	/// count of spare chunks created ahead by the provider thread, not counted by the other fields,
+	/// always zero without SO_CHUNK_PROVISIONING
+	std::size_t spare_chunks;
+	/// count of allocated blocks
+	std::size_t used_blocks;
+	/// count of free blocks
+	std::size_t free_blocks;
+	/// bytes reserved from the system, including headers
+	std::size_t reserved_bytes;
+	/// bytes taken by chunk headers, free block stacks and remote queue links
+	std::size_t header_bytes;
+	/// bytes lost to page rounding and cache coloring of chunks
+	std::size_t alignment_bytes;
+	/// count of chunks by the share of allocated blocks, bucket i holds chunks with
+	/// [i / _SOBJ_OCCUPANCY_BUCKETS, (i + 1) / _SOBJ_OCCUPANCY_BUCKETS) of blocks used
+	std::size_t histogram[_SOBJ_OCCUPANCY_BUCKETS];
+};
+
+} // namespace smallobject
+
+#endif // __SMALL_OBJECT_OCCUPANCY_HPP_INCLUDED__
@@ -0,0 +1,125 @@
+#ifndef __SMALL_OBJECT_PERF_COUNTERS_HPP_INCLUDED__
+#define __SMALL_OBJECT_PERF_COUNTERS_HPP_INCLUDED__
+
+#include "config.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+namespace smallobject {
+
+/// Hardware performance counters
+enum perf_counter {
+	/// CPU cycles
+	CPU_CYCLES = 0,
+	/// retired instructions
+	INSTRUCTIONS,
+	/// level 1 data cache read misses
+	L1D_MISSES,
+	/// last level cache misses
+	LLC_MISSES,
+	/// data TLB read misses
+	DTLB_MISSES,
+	/// mispredicted branches
+	BRANCH_MISSES,
+	PERF_COUNTERS_COUNT
+};
+
+/// Allocator regions counters are attributed to, regions nest and outer region counts include inner ones
+enum perf_region {
+	/// object_allocator malloc and free calls made by the small objects, includes all the regions below
+	ALLOCATOR_CALL_REGION = 0,
+	/// arena::malloc after the current chunk was full, i.e. chunk scan and new chunk allocation
+	SLOW_PATH_REGION,
+	/// pool::thread_miss_free, memory released by a thread which does not own the arena
+	REMOTE_FREE_REGION,
+	/// arena::shrink
+	SHRINK_REGION,
+	PERF_REGIONS_COUNT
+};
+
+/// Snapshot or delta of the hardware counters, counters not supported by the CPU stay zero
+struct perf_values {
+	uint64_t values[PERF_COUNTERS_COUNT];
+};
+
+/**
+ * \brief Reads Linux perf_event_open hardware counters of the calling thread.
+ *  Counters are opened on the first read in every thread as a single pinned group
+ *  counting the user space only, and closed on the thread exit.
+ *  Where perf events are not supported or not permitted, i.e. perf_event_paranoid or a virtual
+ *  machine without PMU, reads fail and all counters stay zero, so callers need no special handling.
+ *  When the library is built with SO_PERF_COUNTERS, counters are read around the allocator
+ *  regions, and the differences are accumulated per region for all threads. Every read is a system call,
+ *  so this is a profiling mode which slows allocator calls a lot, counts show the cache
+ *  and TLB misses of a region, not its latency.
+ */
+class SYMBOL_VISIBLE perf_counters
+{
+public:
+	/// \return whether the library was built with SO_PERF_COUNTERS
+	static bool enabled() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// \return whether at least one hardware counter can be read in the calling thread
+	static bool available() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// \return counter name
+	static const char* name(const perf_counter counter) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// \return region name
+	static const char* name(const perf_region region) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Reads current counter values of the calling thread
+	/// \param result counter values, zeros when counters are not available
+	/// \return whether counters were read
+	static bool read(perf_values& result) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Counters accumulated in a region by all threads since the start or last reset
+	/// \param result accumulated counter values
+	/// \return count of times the region was entered
+	static uint64_t totals(const perf_region region, perf_values& result) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Resets accumulated region counters
+	static void reset() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Accumulates counters difference into a region
+	static void accumulate(const perf_region region, const perf_values& start, const perf_values& end) BOOST_NOEXCEPT_OR_NOTHROW;
+private:
+	static boost::atomic<uint64_t> _totals[PERF_REGIONS_COUNT][PERF_COUNTERS_COUNT];
+	static boost::atomic<uint64_t> _calls[PERF_REGIONS_COUNT];
+};
+
+/// Scope of an allocator region, counters are read on the scope enter and exit
+class perf_region_scope {
+	perf_region_scope(const perf_region_scope&) BOOST_NOEXCEPT_OR_NOTHROW;
+	perf_region_scope& operator=(const perf_region_scope&) BOOST_NOEXCEPT_OR_NOTHROW;
+public:
+	explicit perf_region_scope(const perf_region region) BOOST_NOEXCEPT_OR_NOTHROW:
+		region_(region),
+		started_( perf_counters::read(start_) )
+	{}
+	~perf_region_scope() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		perf_values end;
+		if( started_ && perf_counters::read(end) )
+			perf_counters::accumulate(region_, start_, end);
+	}
+private:
+	const perf_region region_;
+	perf_values start_;
+	const bool started_;
+};
+
+} // namespace smallobject
+
+#ifdef SO_PERF_COUNTERS
+#	define SO_PERF_REGION(region) smallobject::perf_region_scope region##_scope( smallobject::region )
+#else
+#	define SO_PERF_REGION(region)
+#endif // SO_PERF_COUNTERS
+
+#endif // __SMALL_OBJECT_PERF_COUNTERS_HPP_INCLUDED__
@@ -10,7 +10,9 @@ namespace smallobject { namespace detail {
 
 /// !\brief A pool of memory arenas for allocating
 /// small object of fixed size memory
-/// Reserves or creates one arena for each thread
+/// Reserves or creates one arena for each thread.
+/// Pool takes a whole number of cache lines, thread arena key read on every call
+/// and arenas list modified when a thread creates an arena are on separate lines
 class pool
 {
 public:
@@ -22,21 +24,40 @@ public:
 			reserve(size);
 		return arena_->malloc();
 	}
-	BOOST_FORCEINLINE void free BOOST_PREVENT_MACRO_SUBSTITUTION(void * const ptr) BOOST_NOEXCEPT_OR_NOTHROW
+	/// \return false when no arena of the pool owns the memory
+	BOOST_FORCEINLINE bool free BOOST_PREVENT_MACRO_SUBSTITUTION(void * const ptr) BOOST_NOEXCEPT_OR_NOTHROW
 	{
-	  if( ! arena_->free(ptr) ) {
-			// handle allocation from another thread
-			thread_miss_free(ptr);
-	  }
+		arena* const ar = arena_.get();
+		if( NULL != ar && ar->free(ptr) )
+			return true;
+		// handle allocation from another thread
+		return thread_miss_free(ptr);
 	}
+	/// Adds occupancy of all arenas into the statistic, without stopping allocating threads
+	void occupancy(occupancy_stat& stat) BOOST_NOEXCEPT_OR_NOTHROW;
+	/// Returns empty chunks of the current thread arena, and of the arenas
+	/// not reserved by any thread, back to the system
+	void shrink() BOOST_NOEXCEPT_OR_NOTHROW;
+	/// Prepares the current thread arena for the count of allocations, see arena::prepare
+	/// \param size block size
+	/// \param blocks count of free blocks
+	/// \param lock whether to lock the arena memory in RAM
+	/// \return false when the memory could not be locked
+	/// \throw std::bad_alloc in case of system out of memory
+	bool prepare(const std::size_t size, const std::size_t blocks, const bool lock);
+	/// Locks memory of all arenas in RAM, including arenas created later
+	/// \return false when some memory could not be locked
+	bool lock() BOOST_NOEXCEPT_OR_NOTHROW;
 private:
-	void thread_miss_free(void * const ptr) BOOST_NOEXCEPT_OR_NOTHROW;
+	bool thread_miss_free(void * const ptr) BOOST_NOEXCEPT_OR_NOTHROW;
 	void reserve(const std::size_t size);
 	static inline void release_arena(arena* ar) BOOST_NOEXCEPT_OR_NOTHROW;
 private:
 	typedef smallobject::list<arena*> arenas_pool;
 	boost::thread_specific_ptr<arena> arena_;
-	arenas_pool arenas_;
+	BOOST_ALIGNMENT(SO_CACHE_LINE_SIZE) arenas_pool arenas_;
+	// new arenas are locked in RAM
+	boost::atomic_bool locked_;
 };
 
 }} //  namespace smallobject { namespace detail
@@ -5,18 +5,22 @@
 #include <boost/thread/locks.hpp>
 #include <pthread.h>
 
+#if defined(__linux__) && !defined(SO_PTHREAD_SPINLOCK)
+#	include "../linux/futexlock.hpp"
+#endif // linux
+
 namespace smallobject { namespace sys {
 
-/// !\brief pthread spinlock based critical section
+/// !\brief pthread spinlock based
 /// synchronization primitive
-class critical_section:private boost::noncopyable
+class spinlock:private boost::noncopyable
 {
 	public:
-		critical_section()
+		spinlock()
 		{
 			::pthread_spin_init(&sl_, PTHREAD_PROCESS_PRIVATE);
 		}
-		~critical_section() BOOST_NOEXCEPT_OR_NOTHROW
+		~spinlock() BOOST_NOEXCEPT_OR_NOTHROW
 		{
 			::pthread_spin_destroy(&sl_);
 		}
@@ -26,7 +30,7 @@ class critical_section:private boost::noncopyable
 		}
 		BOOST_FORCEINLINE bool try_lock() BOOST_NOEXCEPT_OR_NOTHROW
 		{
-			return ::pthread_spin_trylock(&sl_);
+			return 0 == ::pthread_spin_trylock(&sl_);
 		}
 		BOOST_FORCEINLINE void unlock() BOOST_NOEXCEPT_OR_NOTHROW
 		{
@@ -36,6 +40,13 @@ class critical_section:private boost::noncopyable
 		::pthread_spinlock_t sl_;
 };
 
+#if defined(__linux__) && !defined(SO_PTHREAD_SPINLOCK)
+// spin then park on futex, waiters do not burn time slices when lock owner is de-scheduled
+typedef futex_lock critical_section;
+#else
+typedef spinlock critical_section;
+#endif // linux
+
 } //  namespace sys
 
 //typedef boost::unique_lock<sys::critical_section> unique_lock;
@@ -4,6 +4,7 @@
 #include <boost/throw_exception.hpp>
 
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 namespace smallobject { namespace sys {
@@ -25,6 +26,34 @@ BOOST_FORCEINLINE void xfree(void * const ptr)
     return ::free(ptr);
 }
 
+/// Posix system memory allocator, returns memory aligned to the power of two alignment
+BOOST_FORCEINLINE void* xmalloc_aligned(const std::size_t size, const std::size_t alignment)
+{
+	void* result = NULL;
+	if( 0 != ::posix_memalign(&result, alignment < _x_align ? _x_align : alignment, size) )
+		return NULL;
+	return result;
+}
+
+/// Releases memory allocated with xmalloc_aligned
+BOOST_FORCEINLINE void xfree_aligned(void * const ptr)
+{
+	xfree(ptr);
+}
+
+/// Locks memory pages in RAM, so that they are never swapped out
+/// \return true when locked, false when the memory lock limit is reached
+BOOST_FORCEINLINE bool xlock(void * const ptr, const std::size_t size)
+{
+	return 0 == ::mlock(ptr, size);
+}
+
+/// Unlocks memory pages locked with xlock
+BOOST_FORCEINLINE void xunlock(void * const ptr, const std::size_t size)
+{
+	::munlock(ptr, size);
+}
+
 }} /// namespace smallobject { namespace sys
 
 #endif // __POSIX_MMAP_ALLOC_HPP_INCLUDED__
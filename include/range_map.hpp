@@ -11,6 +11,7 @@
 #	define NULL reinterpret_cast<void*>(0)
 #endif // NULL
 
+#include <boost/core/no_exceptions_support.hpp>
 #include <boost/move/move.hpp>
 
 #include <functional>
@@ -272,14 +273,14 @@ public:
 		p->fix_height();
 		switch( b_factor(p) ) {
 		case 2: {
-					if ( b_factor( p->right() ) < 0 ) {
-						p->set_right( rotate_right( p->right() ) );
+					if ( b_factor( p->left() ) < 0 ) {
+						p->set_left( rotate_right( p->left() ) );
 					}
 					return rotate_left(p);
 				}
 		case -2: {
-					if ( b_factor( p->left() ) > 0 ) {
-						p->set_left( rotate_left( p->left() ) );
+					if ( b_factor( p->right() ) > 0 ) {
+						p->set_right( rotate_left( p->right() ) );
 					}
 					return rotate_right(p);
 				 }
@@ -287,7 +288,38 @@ public:
 		return p;
 	}
 
-	static self_type*  inc_node(self_type* const from) BOOST_NOEXCEPT_OR_NOTHROW {
+	/// Appends a node to the sorted single linked list of nodes, linked by right pointers
+	static inline void append(self_type*& head, self_type*& tail, self_type* const node) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		node->top_ = NULL;
+		node->left_ = NULL;
+		node->right_ = NULL;
+		if(NULL != tail)
+			tail->right_ = node;
+		else
+			head = node;
+		tail = node;
+	}
+
+	/// Builds a balanced tree from the sorted single linked list of nodes in O(n)
+	/// \param list head of the list, moved to the first node after the taken nodes
+	/// \param count count of nodes to take from list
+	/// \return root of the built tree
+	static self_type* build(self_type*& list, const std::size_t count) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if(0 == count)
+			return NULL;
+		self_type* left = build(list, count >> 1);
+		self_type* result = list;
+		list = list->right_;
+		result->top_ = NULL;
+		result->set_left(left);
+		result->set_right( build(list, count - (count >> 1) - 1) );
+		result->fix_height();
+		return result;
+	}
+
+	static self_type*  inc_node(self_type* from) BOOST_NOEXCEPT_OR_NOTHROW {
 		self_type *result = from;
 		if (from->right_ != NULL) {
 			result = result->right_;
@@ -295,17 +327,11 @@ public:
 				result = result->left_;
 			}
 		} else {
+			// climb up while comming from the right sub-tree
 			result = from->top_;
-			if(NULL != result) {
-				if(result->right_ == from) {
-					if(NULL == result->top_) {
-						result = NULL;
-					} else if(result == result->top_->left_ ) {
-						result = result->top_;
-					} else {
-						result = NULL;
-					}
-				}
+			while(NULL != result && result->right_ == from) {
+				from = result;
+				result = result->top_;
 			}
 		}
 		return result;
@@ -387,7 +413,7 @@ public:
 	{}
 
 	inline reference operator*() const BOOST_NOEXCEPT_OR_NOTHROW {
-		return *(node_->value());
+		return *( const_cast<value_type*>( node_->value() ) );
 	}
 
 	inline pointer operator->() const BOOST_NOEXCEPT_OR_NOTHROW {
@@ -508,6 +534,47 @@ public:
 		root_ = NULL;
 	}
 
+	/// Erases all elements satisfying the predicate and re-balances tree in O(n),
+	/// nodes are re-linked in place without any allocation
+	/// \param pred unary predicate, called exactly once for each element in ascending order
+	/// \return count of erased elements
+	template<class P>
+	std::size_t erase_if(P pred)
+	{
+		_node_t *head = NULL;
+		_node_t *tail = NULL;
+		std::size_t count = 0;
+		std::size_t erased = 0;
+		do_filter(root_, pred, head, tail, count, erased);
+		root_ = _node_t::build(head, count);
+		return erased;
+	}
+
+	/// Replaces content with elements from a sorted sequence of non overlapping ranges in O(n)
+	/// \param first iterator on the first element of sorted sequence
+	/// \param last iterator after the last element of sorted sequence
+	template<class I>
+	void assign(I first, I last)
+	{
+		clear();
+		_node_t *head = NULL;
+		_node_t *tail = NULL;
+		std::size_t count = 0;
+		BOOST_TRY {
+			for(; first != last; ++first) {
+				_node_t* node = create_node( value_type(*first) );
+				assert( NULL == tail || 1 == node->value()->first.compare_to( tail->value()->first ) );
+				_node_t::append(head, tail, node);
+				++count;
+			}
+		} BOOST_CATCH(...) {
+			root_ = _node_t::build(head, count);
+			BOOST_RETHROW
+		}
+		BOOST_CATCH_END
+		root_ = _node_t::build(head, count);
+	}
+
 	~basic_range_map() BOOST_NOEXCEPT_OR_NOTHROW
 	{
 		if(NULL == root_)
@@ -628,6 +695,24 @@ private:
 		}
 	}
 
+	// in-order walk, recursion depth is limited by the tree height
+	template<class P>
+	void do_filter(_node_t* const node, P& pred, _node_t*& head, _node_t*& tail, std::size_t& count, std::size_t& erased)
+	{
+		if(NULL == node)
+			return;
+		_node_t* const right = node->right();
+		do_filter(node->left(), pred, head, tail, count, erased);
+		if( pred( *(node->value()) ) ) {
+			destroy_node(node);
+			++erased;
+		} else {
+			_node_t::append(head, tail, node);
+			++count;
+		}
+		do_filter(right, pred, head, tail, count, erased);
+	}
+
 	inline _node_t* find_node(const K& key) const
 	{
 		_node_t *it = root_;
@@ -757,6 +842,8 @@ class synchronized_range_map:public basic_range_map<K,V,C,A>
 {
 private:
 	typedef basic_range_map<K,V,C,A> base_type;
+	typedef sys::basic_read_lock<sys::read_mostly_barrier> read_lock;
+	typedef sys::basic_write_lock<sys::read_mostly_barrier> write_lock;
 public:
 	typedef typename base_type::key_type key_type;
 	typedef typename base_type::range_type range_type;
@@ -770,7 +857,7 @@ public:
 	{}
 	inline bool insert(BOOST_FWD_REF(value_type) v)
 	{
-		sys::write_lock lock(rwb_);
+		write_lock lock(rwb_);
 		return base_type::insert( boost::forward<value_type>(v) );
 	}
 	inline bool insert(BOOST_FWD_REF(key_type) min, BOOST_FWD_REF(key_type) max, BOOST_FWD_REF(mapped_type) val)
@@ -780,26 +867,38 @@ public:
 	}
 	inline void erase(const iterator& position)
 	{
-		sys::write_lock lock(rwb_);
+		write_lock lock(rwb_);
 		base_type::erase(position);
 	}
+	template<class P>
+	inline std::size_t erase_if(P pred)
+	{
+		write_lock lock(rwb_);
+		return base_type::erase_if(pred);
+	}
+	template<class I>
+	inline void assign(I first, I last)
+	{
+		write_lock lock(rwb_);
+		base_type::assign(first, last);
+	}
 	inline const iterator find(const key_type& key)
 	{
-		sys::read_lock lock(rwb_);
+		read_lock lock(rwb_);
 		return base_type::find(key);
 	}
 	inline const iterator begin()
 	{
-		sys::read_lock lock(rwb_);
+		read_lock lock(rwb_);
 		return base_type::begin();
 	}
 	inline bool empty()
 	{
-		sys::read_lock lock(rwb_);
+		read_lock lock(rwb_);
 		return base_type::empty();
 	}
 private:
-	sys::read_write_barrier rwb_;
+	sys::read_mostly_barrier rwb_;
 };
 
 } // { namespace smallobject
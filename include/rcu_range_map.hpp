@@ -0,0 +1,461 @@
+#ifndef __SMALL_OBJECT_RCU_RANGE_MAP_HPP_INCLUDED__
+#define __SMALL_OBJECT_RCU_RANGE_MAP_HPP_INCLUDED__
+
+#include <vector>
+
+#include "range_map.hpp"
+#include "epoch.hpp"
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+namespace smallobject {
+
+namespace detail {
+
+/// Node of the persistent AVL tree. Node is immutable since it was published,
+/// only nodes created by the current write operation (the same generation) are modified in place.
+/// Embeds the limbo list link, so that publishing a new tree never allocates
+template<typename R, typename V>
+struct rcu_tree_node: public epoch_domain::retired_hook {
+#if !defined(BOOST_NO_CXX11_DELETED_FUNCTIONS)
+	rcu_tree_node( const rcu_tree_node& ) = delete;
+	rcu_tree_node& operator=( const rcu_tree_node& ) = delete;
+#else
+private:
+	rcu_tree_node( const rcu_tree_node& );
+	rcu_tree_node& operator=( const rcu_tree_node& );
+public:
+#endif // no deleted functions
+	typedef movable_pair<const R, V> value_type;
+
+	rcu_tree_node(BOOST_FWD_REF(value_type) v, const std::size_t generation):
+		epoch_domain::retired_hook(),
+		value( boost::forward<value_type>(v) ),
+		left(NULL),
+		right(NULL),
+		height(1),
+		gen(generation)
+	{}
+
+	/// path copy constructor
+	rcu_tree_node(const rcu_tree_node& other, const std::size_t generation):
+		epoch_domain::retired_hook(),
+		value(other.value),
+		left(other.left),
+		right(other.right),
+		height(other.height),
+		gen(generation)
+	{}
+
+	const value_type value;
+	rcu_tree_node* left;
+	rcu_tree_node* right;
+	int8_t height;
+	const std::size_t gen;
+};
+
+} // namespace detail
+
+/// \brief Read copy update version of the range map, for read mostly workloads.
+/// Readers follow atomically published root and never write any shared memory,
+/// so lookups scale with count of CPU cores.
+/// Writers are serialized, copy the modified path of the tree and retire
+/// replaced nodes to the epoch_domain.
+/// Map elements can't be addressed by iterators, since node can be reclaimed as soon
+/// as reader leaves the epoch critical region. Use find to copy mapped value, or for_each
+/// to visit elements.
+/// \param K key type
+/// \param V value type, must be copy constructable
+/// \param C key comparator, std::less<K> is default
+/// \param A allocator type, sys::allocator is default
+template<
+		typename K, typename V,
+		class C = std::less<K>,
+		class A = sys::allocator< movable_pair< const range<K,C>, V > >
+		>
+class rcu_range_map {
+#if !defined(BOOST_NO_CXX11_DELETED_FUNCTIONS)
+      rcu_range_map( const rcu_range_map& ) = delete;
+      rcu_range_map& operator=( const rcu_range_map& ) = delete;
+#else
+      rcu_range_map( const rcu_range_map& );
+      rcu_range_map& operator=( const rcu_range_map& );
+#endif // no deleted functions
+public:
+	typedef K key_type;
+	typedef C key_comparator_type;
+	typedef range<key_type, key_comparator_type> range_type;
+	typedef V mapped_type;
+	typedef A allocator_type;
+private:
+	typedef detail::rcu_tree_node<range_type, mapped_type> _node_t;
+	typedef typename allocator_type::template rebind<_node_t>::other _node_allocator;
+	typedef typename allocator_type::template rebind<_node_t*>::other _retired_allocator;
+	typedef std::vector<_node_t*, _retired_allocator> _retired_list;
+public:
+	typedef typename _node_t::value_type value_type;
+
+	explicit rcu_range_map(epoch_domain& domain = *epoch_domain::instance()):
+		root_(NULL),
+		domain_(domain),
+		wmtx_(),
+		gen_(0),
+		retired_(),
+		fresh_(),
+		allocator_()
+	{}
+
+	~rcu_range_map() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		// no readers are possible any longer
+		do_destroy_tree( root_.load(boost::memory_order_acquire) );
+	}
+
+	bool insert(BOOST_FWD_REF(value_type) v)
+	{
+		unique_lock lock(wmtx_);
+		_node_t* root = root_.load(boost::memory_order_relaxed);
+		if( overlaps(root, v.first) )
+			return false;
+		++gen_;
+		const std::size_t mark = retired_.size();
+		_node_t* fresh = create_node( boost::forward<value_type>(v) );
+		BOOST_TRY {
+			root = do_insert(root, fresh);
+		} BOOST_CATCH(...) {
+			rollback(mark);
+			BOOST_RETHROW
+		}
+		BOOST_CATCH_END
+		publish(root);
+		return true;
+	}
+
+	inline bool insert(BOOST_FWD_REF(key_type) min, BOOST_FWD_REF(key_type) max, BOOST_FWD_REF(mapped_type) val)
+	{
+		range_type range( boost::forward<key_type>(min), boost::forward<key_type>(max) );
+		return insert( value_type( BOOST_MOVE_BASE(range_type,range), boost::forward<mapped_type>(val) ) );
+	}
+
+	/// Erases a range which contains the key
+	/// \return whether range was found and erased
+	bool erase(const key_type& key)
+	{
+		unique_lock lock(wmtx_);
+		_node_t* root = root_.load(boost::memory_order_relaxed);
+		if(NULL == find_node(root, key) )
+			return false;
+		++gen_;
+		const std::size_t mark = retired_.size();
+		BOOST_TRY {
+			root = do_erase(root, key);
+		} BOOST_CATCH(...) {
+			rollback(mark);
+			BOOST_RETHROW
+		}
+		BOOST_CATCH_END
+		publish(root);
+		return true;
+	}
+
+	void clear()
+	{
+		unique_lock lock(wmtx_);
+		const std::size_t mark = retired_.size();
+		BOOST_TRY {
+			do_collect_tree( root_.load(boost::memory_order_relaxed) );
+		} BOOST_CATCH(...) {
+			// nothing is released, the tree stays published
+			retired_.resize(mark);
+			BOOST_RETHROW
+		}
+		BOOST_CATCH_END
+		publish(NULL);
+	}
+
+	/// Wait free lookup
+	/// \param key a key to search
+	/// \param result copy of mapped value when key was found
+	/// \return whether key was found
+	bool find(const key_type& key, mapped_type& result) const
+	{
+		epoch_domain::guard guard(domain_);
+		const _node_t* node = find_node( root_.load(boost::memory_order_acquire), key);
+		if(NULL == node)
+			return false;
+		result = node->value.second;
+		return true;
+	}
+
+	/// Visits elements of a consistent snapshot in ascending order
+	/// \param f unary function accepting const value_type&
+	template<class F>
+	void for_each(F f) const
+	{
+		epoch_domain::guard guard(domain_);
+		do_for_each( root_.load(boost::memory_order_acquire), f );
+	}
+
+	inline bool empty() const BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return NULL == root_.load(boost::memory_order_acquire);
+	}
+
+private:
+
+	static void destroy_retired(void* ptr) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		_node_allocator allocator;
+		_node_t* node = static_cast<_node_t*>( static_cast<epoch_domain::retired_hook*>(ptr) );
+		node->~_node_t();
+		allocator.deallocate(node, 1);
+	}
+
+	inline _node_t* create_node(BOOST_FWD_REF(value_type) v)
+	{
+		_node_t* result = allocator_.allocate(1);
+		BOOST_TRY {
+			new ( static_cast<void*>(result) ) _node_t( boost::forward<value_type>(v), gen_ );
+		} BOOST_CATCH(...) {
+			allocator_.deallocate(result, 1);
+			BOOST_RETHROW
+		}
+		BOOST_CATCH_END
+		return track(result);
+	}
+
+	// remembers a node created by current write operation, so that it can be rolled back
+	inline _node_t* track(_node_t* const node)
+	{
+		BOOST_TRY {
+			fresh_.push_back(node);
+		} BOOST_CATCH(...) {
+			destroy_node(node);
+			BOOST_RETHROW
+		}
+		BOOST_CATCH_END
+		return node;
+	}
+
+	inline void destroy_node(_node_t* const node) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		node->~_node_t();
+		allocator_.deallocate(node, 1);
+	}
+
+	// returns the node itself when it was created by current write operation,
+	// otherwise path copy of the node, and retires the original
+	inline _node_t* own(_node_t* const node)
+	{
+		if(gen_ == node->gen)
+			return node;
+		_node_t* result = allocator_.allocate(1);
+		BOOST_TRY {
+			new ( static_cast<void*>(result) ) _node_t( *node, gen_ );
+		} BOOST_CATCH(...) {
+			allocator_.deallocate(result, 1);
+			BOOST_RETHROW
+		}
+		BOOST_CATCH_END
+		track(result);
+		retired_.push_back(node);
+		return result;
+	}
+
+	// releases the nodes created by failed write operation, nothing was published
+	// and nodes of the published tree were never modified, so the tree stays intact
+	// \param mark count of retired nodes when the write operation started
+	void rollback(const std::size_t mark) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		for(typename _retired_list::const_iterator it = fresh_.begin(); it != fresh_.end(); ++it)
+			destroy_node(*it);
+		fresh_.clear();
+		retired_.resize(mark);
+	}
+
+	// nodes are retired through the embedded links, so the new tree is never published half way
+	void publish(_node_t* const new_root) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		fresh_.clear();
+		root_.store(new_root, boost::memory_order_seq_cst);
+		for(typename _retired_list::const_iterator it = retired_.begin(); it != retired_.end(); ++it)
+			domain_.retire( static_cast<epoch_domain::retired_hook*>(*it), &rcu_range_map::destroy_retired );
+		retired_.clear();
+	}
+
+	static inline int8_t height(const _node_t* const node) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return (NULL != node) ? node->height : 0;
+	}
+
+	static inline int8_t factor(const _node_t* const node) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return (NULL != node) ? height(node->left) - height(node->right) : 0;
+	}
+
+	static inline void fix_height(_node_t* const node) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		const int8_t hl = height(node->left);
+		const int8_t hr = height(node->right);
+		node->height = (hl > hr ? hl : hr) + 1;
+	}
+
+	inline _node_t* rotate_right(_node_t* const node)
+	{
+		_node_t* result = own(node->left);
+		node->left = result->right;
+		result->right = node;
+		fix_height(node);
+		fix_height(result);
+		return result;
+	}
+
+	inline _node_t* rotate_left(_node_t* const node)
+	{
+		_node_t* result = own(node->right);
+		node->right = result->left;
+		result->left = node;
+		fix_height(node);
+		fix_height(result);
+		return result;
+	}
+
+	// node must be owned by current write operation
+	_node_t* balance(_node_t* const node)
+	{
+		fix_height(node);
+		switch( factor(node) ) {
+		case 2:
+			if( factor(node->left) < 0 )
+				node->left = rotate_left( own(node->left) );
+			return rotate_right(node);
+		case -2:
+			if( factor(node->right) > 0 )
+				node->right = rotate_right( own(node->right) );
+			return rotate_left(node);
+		}
+		return node;
+	}
+
+	_node_t* do_insert(_node_t* node, _node_t* const fresh)
+	{
+		if(NULL == node)
+			return fresh;
+		node = own(node);
+		if( 1 == fresh->value.first.compare_to(node->value.first) )
+			node->right = do_insert(node->right, fresh);
+		else
+			node->left = do_insert(node->left, fresh);
+		return balance(node);
+	}
+
+	_node_t* do_remove_min(_node_t* node, _node_t*& min)
+	{
+		if(NULL == node->left) {
+			min = node;
+			return node->right;
+		}
+		node = own(node);
+		node->left = do_remove_min(node->left, min);
+		return balance(node);
+	}
+
+	_node_t* do_erase(_node_t* node, const key_type& key)
+	{
+		if(NULL == node)
+			return NULL;
+		switch( node->value.first.compare_to_key(key) ) {
+		case -1:
+			node = own(node);
+			node->left = do_erase(node->left, key);
+			return balance(node);
+		case 1:
+			node = own(node);
+			node->right = do_erase(node->right, key);
+			return balance(node);
+		}
+		retired_.push_back(node);
+		if(NULL == node->left)
+			return node->right;
+		if(NULL == node->right)
+			return node->left;
+		_node_t* min = NULL;
+		_node_t* right = do_remove_min(node->right, min);
+		min = own(min);
+		min->left = node->left;
+		min->right = right;
+		return balance(min);
+	}
+
+	static bool overlaps(const _node_t* it, const range_type& r) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		while(NULL != it) {
+			switch( r.compare_to(it->value.first) ) {
+			case 0:
+				return true;
+			case 1:
+				it = it->right;
+				break;
+			default:
+				it = it->left;
+			}
+		}
+		return false;
+	}
+
+	static const _node_t* find_node(const _node_t* it, const key_type& key) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		while(NULL != it) {
+			const int8_t compare = it->value.first.compare_to_key(key);
+			if(0 == compare)
+				return it;
+			it = (compare < 0) ? it->left : it->right;
+		}
+		return NULL;
+	}
+
+	template<class F>
+	static void do_for_each(const _node_t* const node, F& f)
+	{
+		if(NULL == node)
+			return;
+		do_for_each(node->left, f);
+		f(node->value);
+		do_for_each(node->right, f);
+	}
+
+	void do_collect_tree(_node_t* const node)
+	{
+		if(NULL == node)
+			return;
+		do_collect_tree(node->left);
+		do_collect_tree(node->right);
+		retired_.push_back(node);
+	}
+
+	void do_destroy_tree(_node_t* const node) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if(NULL == node)
+			return;
+		do_destroy_tree(node->left);
+		do_destroy_tree(node->right);
+		destroy_node(node);
+	}
+
+private:
+	boost::atomic<_node_t*> root_;
+	epoch_domain& domain_;
+	// writers state
+	sys::critical_section wmtx_;
+	std::size_t gen_;
+	_retired_list retired_;
+	// nodes created by current write operation
+	_retired_list fresh_;
+	_node_allocator allocator_;
+};
+
+} // namespace smallobject
+
+#endif // __SMALL_OBJECT_RCU_RANGE_MAP_HPP_INCLUDED__
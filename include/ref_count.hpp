@@ -0,0 +1,203 @@
+#ifndef __SMALL_OBJECT_REF_COUNT_HPP_INCLUDED__
+#define __SMALL_OBJECT_REF_COUNT_HPP_INCLUDED__
+
+#include "config.hpp"
+#include "epoch.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/core/no_exceptions_support.hpp>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+namespace smallobject {
+
+/// \brief Thread safe reference counter, default smallobject::object policy
+class atomic_ref_count {
+protected:
+	BOOST_CONSTEXPR atomic_ref_count() BOOST_NOEXCEPT_OR_NOTHROW:
+		ref_count_(0)
+	{}
+	BOOST_FORCEINLINE void add_ref() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		ref_count_.fetch_add(1, boost::memory_order_relaxed);
+	}
+	/// \return true when last reference was released
+	BOOST_FORCEINLINE bool release_ref() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if (ref_count_.fetch_sub(1, boost::memory_order_release) == 1) {
+			boost::atomic_thread_fence(boost::memory_order_acquire);
+			return true;
+		}
+		return false;
+	}
+private:
+	boost::atomic_size_t ref_count_;
+};
+
+/// \brief Thread safe 32 bit reference counter, lets small objects
+/// to fall into a smaller size class on 64 bit platforms
+class atomic_ref_count32 {
+protected:
+	BOOST_CONSTEXPR atomic_ref_count32() BOOST_NOEXCEPT_OR_NOTHROW:
+		ref_count_(0)
+	{}
+	BOOST_FORCEINLINE void add_ref() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		ref_count_.fetch_add(1, boost::memory_order_relaxed);
+	}
+	BOOST_FORCEINLINE bool release_ref() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if (ref_count_.fetch_sub(1, boost::memory_order_release) == 1) {
+			boost::atomic_thread_fence(boost::memory_order_acquire);
+			return true;
+		}
+		return false;
+	}
+private:
+	boost::atomic<uint32_t> ref_count_;
+};
+
+/// \brief Non atomic reference counter, for objects which never leave the thread created them
+class plain_ref_count {
+protected:
+	BOOST_CONSTEXPR plain_ref_count() BOOST_NOEXCEPT_OR_NOTHROW:
+		ref_count_(0)
+	{}
+	BOOST_FORCEINLINE void add_ref() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		++ref_count_;
+	}
+	BOOST_FORCEINLINE bool release_ref() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		return 0 == --ref_count_;
+	}
+private:
+	uint32_t ref_count_;
+};
+
+/**
+ * \brief Biased reference counter (J. Choi, T. Shull, J. Torrellas "Biased Reference Counting").
+ *  Thread which created an object is the owner, it counts references with a plain counter.
+ *  Other threads count references with an atomic shared counter, which can become negative.
+ *  When shared counter drops to zero or below, object is queued to the owner inbox, and owner
+ *  merges both counters. Once counters are merged all threads use the shared counter only.
+ *  Owner merges queued objects on release, or when collect is called. When owner thread exits
+ *  its inbox is closed, and the releasing thread merges the counters by itself.
+ */
+class SYMBOL_VISIBLE biased_ref_count {
+private:
+	struct owner_record {
+		boost::atomic<biased_ref_count*> inbox;
+	};
+	// shared counter layout, reference count is stored in upper bits
+	static const int32_t MERGED = 1;
+	static const int32_t QUEUED = 2;
+	static const int32_t FLAGS = MERGED | QUEUED;
+	static const int32_t ONE = 4;
+protected:
+	biased_ref_count();
+	virtual ~biased_ref_count() BOOST_NOEXCEPT_OR_NOTHROW;
+	BOOST_FORCEINLINE void add_ref() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		if( owner_ == _local_owner && !merged_ )
+			++biased_;
+		else
+			shared_.fetch_add(ONE, boost::memory_order_relaxed);
+	}
+	BOOST_FORCEINLINE bool release_ref() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		owner_record* const rec = _local_owner;
+		if( owner_ == rec && !merged_ ) {
+			if( 0 == --biased_ )
+				return merge_by_owner();
+			if( NULL != rec->inbox.load(boost::memory_order_relaxed) )
+				drain(rec, NULL);
+			return false;
+		}
+		return release_shared();
+	}
+public:
+	/// Merges counters of the objects queued by other threads into the current thread inbox,
+	/// and deletes no longer referenced objects
+	static void collect() BOOST_NOEXCEPT_OR_NOTHROW;
+private:
+	static owner_record* local_owner();
+	static void close_owner(owner_record* rec) BOOST_NOEXCEPT_OR_NOTHROW;
+	static void drain(owner_record* const rec, biased_ref_count* const replacement) BOOST_NOEXCEPT_OR_NOTHROW;
+	bool merge_by_owner() BOOST_NOEXCEPT_OR_NOTHROW;
+	bool merge_queued() BOOST_NOEXCEPT_OR_NOTHROW;
+	bool release_shared() BOOST_NOEXCEPT_OR_NOTHROW;
+	bool enqueue() BOOST_NOEXCEPT_OR_NOTHROW;
+private:
+	static SO_THREAD_LOCAL owner_record* _local_owner;
+	owner_record* const owner_;
+	uint32_t biased_;
+	bool merged_;
+	boost::atomic<int32_t> shared_;
+	biased_ref_count* next_;
+};
+
+template<class R>
+struct ref_count_disposer;
+
+/**
+ * \brief Thread safe reference counter with deferred deletion.
+ *  When the last reference is released, object is retired to the process epoch_domain
+ *  instead of synchronous delete. Retired objects are deleted in batches by the releasing thread,
+ *  after all threads which were inside epoch_domain::guard at the release moment have left it.
+ *  So that destructor and free costs are amortized, and lock-free readers can use raw pointers
+ *  inside a guard without holding a reference.
+ *  Limbo list link is embedded into the counter, so that releasing the last reference never allocates.
+ */
+class deferred_ref_count: public atomic_ref_count, private epoch_domain::retired_hook {
+	friend struct ref_count_disposer<deferred_ref_count>;
+protected:
+	BOOST_CONSTEXPR deferred_ref_count() BOOST_NOEXCEPT_OR_NOTHROW:
+		atomic_ref_count(),
+		epoch_domain::retired_hook()
+	{}
+};
+
+/// Disposes an object when its last reference was released, default is synchronous delete
+/// \param R reference count policy
+template<class R>
+struct ref_count_disposer {
+	template<class T>
+	static BOOST_FORCEINLINE void dispose(T* const obj) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		delete obj;
+	}
+};
+
+template<>
+struct ref_count_disposer<deferred_ref_count> {
+	template<class T>
+	static BOOST_FORCEINLINE void dispose(T* const obj) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		epoch_domain* domain = NULL;
+		BOOST_TRY {
+			domain = epoch_domain::instance();
+		} BOOST_CATCH(...) {
+			// process domain could not be created, so no reader can be inside its guard
+			delete obj;
+			return;
+		}
+		BOOST_CATCH_END
+		deferred_ref_count* const rc = obj;
+		domain->retire( static_cast<epoch_domain::retired_hook*>(rc), &ref_count_disposer::destroy<T> );
+	}
+private:
+	template<class T>
+	static void destroy(void* ptr) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		deferred_ref_count* const rc = static_cast<deferred_ref_count*>( static_cast<epoch_domain::retired_hook*>(ptr) );
+		delete static_cast<T*>(rc);
+	}
+};
+
+} // namespace smallobject
+
+#endif // __SMALL_OBJECT_REF_COUNT_HPP_INCLUDED__
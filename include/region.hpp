@@ -0,0 +1,89 @@
+#ifndef __SMALL_OBJECT_REGION_HPP_INCLUDED__
+#define __SMALL_OBJECT_REGION_HPP_INCLUDED__
+
+#include "config.hpp"
+
+#include <vector>
+
+#include "object_allocator.hpp"
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+#pragma once
+#endif // BOOST_HAS_PRAGMA_ONCE
+
+namespace smallobject {
+
+/**
+ * \brief Monotonic memory region for short living objects, i.e. request scoped.
+ *  Memory is allocated by bumping a pointer inside chunks borrowed from the region own arena,
+ *  and never released one by one. Region reset hands all chunks back to the arena at once,
+ *  time of reset depends only on count of chunks and not on count of allocated objects.
+ *  Region is not thread safe, it should be used by one thread at time.
+ *  Use region::scope to redirect smallobject::object allocations into a region.
+ *  Chunks of all regions are registered process wide, so that deleting an object
+ *  after the region scope has ended is recognized and ignored as well.
+ */
+class SYMBOL_VISIBLE region: public detail::noncopyable
+{
+public:
+	/// \brief RAII region activation for the current thread.
+	/// While scope is alive smallobject::object operator new allocates objects of
+	/// small size in the region, and operator delete ignores objects owned by the region.
+	/// Scopes can be nested, previously active region is restored when scope ends.
+	class SYMBOL_VISIBLE scope: public detail::noncopyable {
+	public:
+		explicit scope(region& r) BOOST_NOEXCEPT_OR_NOTHROW;
+		~scope() BOOST_NOEXCEPT_OR_NOTHROW;
+	private:
+		region* prev_;
+	};
+
+	region();
+
+	/// Resets region, all allocated memory is invalidated
+	~region() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Allocates memory in the region
+	/// \param bytes size of memory block, must not be greater then object_allocator::MAX_SIZE
+	/// \return pointer on memory block aligned to sizeof(std::size_t)
+	/// \throw std::bad_alloc in case of system out of memory
+	BOOST_FORCEINLINE void* allocate(std::size_t bytes)
+	{
+		bytes = detail::align_up( sizeof(std::size_t), bytes );
+		if( bytes > static_cast<std::size_t>(end_ - top_) )
+			next_chunk();
+		void* result = static_cast<void*>(top_);
+		top_ += bytes;
+		return result;
+	}
+
+	/// Returns whether memory was allocated in this region
+	/// \param ptr pointer on memory
+	bool owns(const void* ptr) const BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Returns the region memory was allocated in, whether a scope of the region is active or not
+	/// do system lock
+	/// \param ptr pointer on memory
+	/// \return owner region or NULL when memory does not belong to any region
+	static region* owner(const void* ptr) BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Releases all memory allocated in this region, and hands all chunks back to the arena
+	void reset() BOOST_NOEXCEPT_OR_NOTHROW;
+
+	/// Returns region active for the current thread
+	/// \return active region or NULL when there is no active region
+	static region* current() BOOST_NOEXCEPT_OR_NOTHROW;
+
+private:
+	typedef std::vector<detail::chunk*, sys::allocator<detail::chunk*> > chunks_list;
+	void next_chunk();
+private:
+	detail::arena arena_;
+	chunks_list chunks_;
+	uint8_t* top_;
+	uint8_t* end_;
+};
+
+} // namespace smallobject
+
+#endif // __SMALL_OBJECT_REGION_HPP_INCLUDED__
@@ -22,45 +22,63 @@
 #	include "shared_mutex_rwb.hpp"
 #endif // BOOST_POSIX_API
 
+#ifdef SO_DISTRIBUTED_RWB
+#	include "distributed_rwb.hpp"
+#endif // SO_DISTRIBUTED_RWB
+
 #ifdef BOOST_HAS_PRAGMA_ONCE
 #pragma once
 #endif // BOOST_HAS_PRAGMA_ONCE
 
 namespace smallobject { namespace sys {
 
+/// Barrier for read mostly data, select distributed barrier with SO_DISTRIBUTED_RWB
+#ifdef SO_DISTRIBUTED_RWB
+typedef distributed_read_write_barrier read_mostly_barrier;
+#else
+typedef read_write_barrier read_mostly_barrier;
+#endif // SO_DISTRIBUTED_RWB
+
 /// \brief Slim reader/writer shared lock
-class read_lock {
+/// \param B barrier type
+template<class B>
+class basic_read_lock {
 public:
-	explicit read_lock(read_write_barrier& barier):
+	explicit basic_read_lock(B& barier):
 		barier_(barier)
 	{
 		barier_.read_lock();
 	}
-	~read_lock() BOOST_NOEXCEPT_OR_NOTHROW
+	~basic_read_lock() BOOST_NOEXCEPT_OR_NOTHROW
 	{
 		barier_.read_unlock();
 	}
 private:
-	read_write_barrier& barier_;
+	B& barier_;
 };
 
 /// \brief Slim reader/writer exclusive lock
-class write_lock
+/// \param B barrier type
+template<class B>
+class basic_write_lock
 {
 public:
-	explicit write_lock(read_write_barrier& barier):
+	explicit basic_write_lock(B& barier):
 		barier_(barier)
 	{
 		barier_.write_lock();
 	}
-	~write_lock() BOOST_NOEXCEPT_OR_NOTHROW
+	~basic_write_lock() BOOST_NOEXCEPT_OR_NOTHROW
 	{
 		barier_.write_unlock();
 	}
 private:
-	read_write_barrier& barier_;
+	B& barier_;
 };
 
+typedef basic_read_lock<read_write_barrier> read_lock;
+typedef basic_write_lock<read_write_barrier> write_lock;
+
 }} //  smallobject { namespace sys {
 
 #endif // __SMALL_OBJECT_RW_BARIER_HPP_INCLUDED__
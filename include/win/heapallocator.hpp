@@ -5,6 +5,7 @@
 #include "criticalsection.hpp"
 
 #include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
 
 #ifdef BOOST_HAS_PRAGMA_ONCE
 #pragma once
@@ -51,6 +52,38 @@ BOOST_FORCEINLINE void xfree(void * const ptr)
 	heap_allocator::instance()->release(ptr);
 }
 
+/// Allocates memory aligned to the power of two alignment,
+/// heap block address is stored right before the aligned memory
+BOOST_FORCEINLINE void* xmalloc_aligned(const std::size_t size, const std::size_t alignment)
+{
+	uint8_t* block = static_cast<uint8_t*>( xmalloc( size + alignment + sizeof(void*) ) );
+	if(NULL == block)
+		return NULL;
+	const std::size_t aligned = ( reinterpret_cast<std::size_t>(block) + sizeof(void*) + alignment - 1 ) & ~(alignment - 1);
+	void** result = reinterpret_cast<void**>(aligned);
+	result[-1] = block;
+	return result;
+}
+
+/// Releases memory allocated with xmalloc_aligned
+BOOST_FORCEINLINE void xfree_aligned(void * const ptr)
+{
+	xfree( static_cast<void**>(ptr)[-1] );
+}
+
+/// Locks memory pages in RAM, so that they are never swapped out
+/// \return true when locked, false when the process working set is too small
+BOOST_FORCEINLINE bool xlock(void * const ptr, const std::size_t size)
+{
+	return FALSE != ::VirtualLock(ptr, size);
+}
+
+/// Unlocks memory pages locked with xlock
+BOOST_FORCEINLINE void xunlock(void * const ptr, const std::size_t size)
+{
+	::VirtualUnlock(ptr, size);
+}
+
 } } // namespace smallobject { namespace sys
 
 #endif // __SMALL_OBJECT_WIN_HEAP_ALLOCATOR_HPP_INCLUDED__
@@ -0,0 +1,224 @@
+#include "allocation_trace.hpp"
+#include "sys_allocator.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#include <boost/core/no_exceptions_support.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
+
+#if defined(unix) || defined(__unix) || defined(_XOPEN_SOURCE) || defined(_POSIX_SOURCE)
+#	define SO_TRACE_MMAP
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif // POSIX
+
+namespace smallobject {
+
+// allocation_trace
+
+// records of a thread not yet copied into the log
+struct trace_buffer {
+	trace_buffer* prev;
+	trace_buffer* next;
+	trace_block_header block;
+	trace_record records[_SOBJ_TRACE_BUFFER_RECORDS];
+	// set by the owner thread while it appends a record, stop waits for it before the flush
+	boost::atomic_bool writing;
+};
+
+static const char TRACE_MAGIC[8] = {'S','O','T','R','A','C','E','1'};
+
+static sys::critical_section _trace_mtx;
+// buffers of the live threads, guarded by _trace_mtx
+static trace_buffer* _buffers = NULL;
+static uint32_t _threads = 0;
+static uint8_t* _log = NULL;
+static std::size_t _log_capacity = 0;
+static std::size_t _log_size = 0;
+static uint64_t _dropped = 0;
+#ifdef SO_TRACE_MMAP
+static int _log_fd = -1;
+#endif // SO_TRACE_MMAP
+static boost::atomic<int64_t> _start_ns(0);
+static SO_THREAD_LOCAL trace_buffer* _local_buffer = NULL;
+
+static BOOST_FORCEINLINE int64_t monotonic_ns() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// copies buffered records into the log, must be called under _trace_mtx
+static void flush_buffer(trace_buffer* const buf) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	BOOST_STATIC_ASSERT_MSG( offsetof(trace_buffer, records) == offsetof(trace_buffer, block) + sizeof(trace_block_header), "records must follow the block header" );
+	const std::size_t count = buf->block.count;
+	if(0 == count)
+		return;
+	const std::size_t bytes = sizeof(trace_block_header) + count * sizeof(trace_record);
+	if(NULL != _log) {
+		if(_log_size + bytes <= _log_capacity) {
+			std::memcpy(_log + _log_size, &buf->block, bytes);
+			_log_size += bytes;
+		} else {
+			_dropped += count;
+		}
+	}
+	buf->block.count = 0;
+}
+
+// flushes and releases the buffer of an exiting thread
+static void release_buffer(trace_buffer* const buf) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	_local_buffer = NULL;
+	{
+		unique_lock lock(_trace_mtx);
+		flush_buffer(buf);
+		if(NULL != buf->prev)
+			buf->prev->next = buf->next;
+		else
+			_buffers = buf->next;
+		if(NULL != buf->next)
+			buf->next->prev = buf->prev;
+	}
+	buf->~trace_buffer();
+	sys::xfree(buf);
+}
+
+static trace_buffer* local_buffer() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	void* const mem = sys::xmalloc( sizeof(trace_buffer) );
+	if(NULL == mem)
+		return NULL;
+	// records are not initialized
+	trace_buffer* const buf = new (mem) trace_buffer;
+	buf->writing.store(false, boost::memory_order_relaxed);
+	buf->prev = NULL;
+	buf->block.count = 0;
+	BOOST_TRY {
+		// flushes the buffer on thread exit, never destroyed since threads may exit after static destructors
+		static boost::thread_specific_ptr<trace_buffer> *buffers = new boost::thread_specific_ptr<trace_buffer>(&release_buffer);
+		buffers->reset(buf);
+	} BOOST_CATCH(...) {
+		buf->~trace_buffer();
+		sys::xfree(buf);
+		return NULL;
+	}
+	BOOST_CATCH_END
+	unique_lock lock(_trace_mtx);
+	buf->block.thread = _threads++;
+	buf->next = _buffers;
+	if(NULL != _buffers)
+		_buffers->prev = buf;
+	_buffers = buf;
+	_local_buffer = buf;
+	return buf;
+}
+
+bool allocation_trace::start(const char* path, const std::size_t capacity) BOOST_NOEXCEPT_OR_NOTHROW
+{
+#ifdef SO_TRACE_MMAP
+	if(capacity < sizeof(trace_file_header) )
+		return false;
+	unique_lock lock(_trace_mtx);
+	if(NULL != _log)
+		return false;
+	const int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+		return false;
+	// sparse file, pages are allocated when records are written
+	if( 0 != ::ftruncate(fd, static_cast<off_t>(capacity) ) ) {
+		::close(fd);
+		return false;
+	}
+	void* log = ::mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(MAP_FAILED == log) {
+		::close(fd);
+		return false;
+	}
+	_log_fd = fd;
+	_log = static_cast<uint8_t*>(log);
+	_log_capacity = capacity;
+	_log_size = sizeof(trace_file_header);
+	_dropped = 0;
+	// threads are numbered from zero in every trace
+	_threads = 0;
+	for(trace_buffer* buf = _buffers; NULL != buf; buf = buf->next) {
+		buf->block.thread = _threads++;
+		buf->block.count = 0;
+	}
+	_start_ns.store( monotonic_ns(), boost::memory_order_relaxed );
+	_recording.store(true, boost::memory_order_release);
+	return true;
+#else
+	return false;
+#endif // SO_TRACE_MMAP
+}
+
+void allocation_trace::stop() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	// either a thread sees recording stopped, or it is seen writing below
+	_recording.store(false, boost::memory_order_seq_cst);
+#ifdef SO_TRACE_MMAP
+	unique_lock lock(_trace_mtx);
+	if(NULL == _log)
+		return;
+	for(trace_buffer* buf = _buffers; NULL != buf; buf = buf->next) {
+		// writers never wait for the lock while the flag is set
+		while( buf->writing.load(boost::memory_order_acquire) )
+			boost::this_thread::yield();
+		flush_buffer(buf);
+	}
+	trace_file_header header;
+	std::memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC) );
+	header.data_size = _log_size - sizeof(trace_file_header);
+	header.dropped = _dropped;
+	header.threads = _threads;
+	std::memcpy(_log, &header, sizeof(trace_file_header) );
+	::msync(_log, _log_size, MS_SYNC);
+	::munmap(_log, _log_capacity);
+	// cut not used sparse tail
+	if( 0 != ::ftruncate(_log_fd, static_cast<off_t>(_log_size) ) ) {
+		// log is still readable, tail is zero filled
+	}
+	::close(_log_fd);
+	_log_fd = -1;
+	_log = NULL;
+#endif // SO_TRACE_MMAP
+}
+
+void allocation_trace::record(const trace_record::operation op, const void* const ptr, const std::size_t size) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	trace_buffer* buf = _local_buffer;
+	if(NULL == buf) {
+		buf = local_buffer();
+		if(NULL == buf)
+			return;
+	}
+	buf->writing.store(true, boost::memory_order_seq_cst);
+	// stop may have flushed the buffer already
+	if( !_recording.load(boost::memory_order_seq_cst) ) {
+		buf->writing.store(false, boost::memory_order_release);
+		return;
+	}
+	trace_record& rec = buf->records[buf->block.count];
+	rec.timestamp = static_cast<uint64_t>( monotonic_ns() - _start_ns.load(boost::memory_order_relaxed) );
+	rec.info = ( ( static_cast<uint64_t>( reinterpret_cast<std::size_t>(ptr) ) >> 3 ) << 16 ) | (static_cast<uint64_t>(op) << 8) | (size & 0xFF);
+	const bool full = _SOBJ_TRACE_BUFFER_RECORDS == ++buf->block.count;
+	buf->writing.store(false, boost::memory_order_release);
+	if(full) {
+		// stop may flush the buffer before, then the count is zero here
+		unique_lock lock(_trace_mtx);
+		flush_buffer(buf);
+	}
+}
+
+boost::atomic_bool allocation_trace::_recording(false);
+
+} // namespace smallobject
@@ -1,45 +1,113 @@
 #include "arena.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+#include <boost/static_assert.hpp>
+
 namespace smallobject {
 
 namespace detail {
 
 //arena
-BOOST_FORCEINLINE chunk* arena::create_new_chunk(const std::size_t size)
+BOOST_FORCEINLINE chunk* arena::create_new_chunk(const std::size_t bytes, std::size_t& color)
 {
-	void *ptr = sys::xmalloc( sizeof(chunk) + (size * chunk::MAX_BLOCKS) );
-	const uint8_t *begin = static_cast<uint8_t*>(ptr) + sizeof(chunk);
-	return new (ptr) chunk(size, begin);
+	SO_INSTRUMENT_EVENT(NEW_CHUNK);
+	static const std::size_t COLOR_BYTES = (_SOBJ_CHUNK_COLORS - 1) * SO_CACHE_LINE_SIZE;
+	std::size_t granularity = bytes < _SOBJ_HUGE_PAGE_SIZE ? _SOBJ_PAGE_SIZE : _SOBJ_HUGE_PAGE_SIZE;
+	std::size_t size = (bytes + granularity - 1) & ~(granularity - 1);
+	// every block takes an index in the free stack and a remote queue link,
+	// and rounding the header up takes less than the alignment
+	std::size_t blocks = (size - chunk::header_size(0) - (chunk::ALIGNMENT - 1) - COLOR_BYTES) / (block_size_ + chunk::BLOCK_HEADER_BYTES);
+	if(blocks > chunk::MAX_BLOCKS) {
+		// out of block indexes, only the pages the blocks need are taken
+		blocks = chunk::MAX_BLOCKS;
+		granularity = _SOBJ_PAGE_SIZE;
+		size = ( chunk::header_size(blocks) + COLOR_BYTES + block_size_ * blocks + granularity - 1 ) & ~(granularity - 1);
+	}
+	void *ptr = sys::xmalloc_aligned(size, granularity);
+	if(NULL == ptr)
+		boost::throw_exception( std::bad_alloc() );
+	// payload of every next chunk starts at the next cache line color of the absolute address,
+	// so that first blocks of the chunks do not compete for the same cache sets
+	// wherever the system allocator places the chunks
+	const std::size_t header = chunk::header_size(blocks);
+	assert( header + COLOR_BYTES + block_size_ * blocks <= size );
+	const std::size_t line = ( reinterpret_cast<std::size_t>(ptr) + header ) / SO_CACHE_LINE_SIZE;
+	const std::size_t offset = ( (color + _SOBJ_CHUNK_COLORS - line % _SOBJ_CHUNK_COLORS) % _SOBJ_CHUNK_COLORS ) * SO_CACHE_LINE_SIZE;
+	color = (color + 1) % _SOBJ_CHUNK_COLORS;
+	const uint8_t *begin = static_cast<uint8_t*>(ptr) + header + offset;
+	return new (ptr) chunk(block_size_, blocks, begin, size);
 }
 
 BOOST_FORCEINLINE void arena::release_chunk(chunk* const cnk) BOOST_NOEXCEPT_OR_NOTHROW {
 	// assert(cnk);
 	cnk->~chunk();
-	sys::xfree( static_cast<void*>(cnk) );
+	sys::xfree_aligned( static_cast<void*>(cnk) );
 }
 
-arena::arena(const std::size_t block_size):
+BOOST_FORCEINLINE chunk* arena::next_chunk()
+{
+#ifdef SO_CHUNK_PROVISIONING
+	chunk* spare = take_spare();
+	if(NULL != spare)
+		return spare;
+#endif // SO_CHUNK_PROVISIONING
+	return create_new_chunk(chunk_bytes_, color_);
+}
+
+arena::arena(const std::size_t block_size, const bool first_chunk):
 	block_size_(block_size),
-	chunks_(),
+	// arenas of a size class start from different colors
+	color_( (reinterpret_cast<std::size_t>(this) / SO_CACHE_LINE_SIZE) % _SOBJ_CHUNK_COLORS ),
+	chunk_bytes_(_SOBJ_MIN_CHUNK_SIZE),
 	alloc_current_(NULL),
 	free_current_(NULL),
-	reserved_(),
-	rwb_()
+	chunks_(),
+	rwb_(),
+	locked_(false),
+#ifdef SO_CHUNK_PROVISIONING
+	spares_(),
+	spare_count_(0),
+	// spare chunks do not repeat the colors of the chunks created by the owner
+	spare_color_( (color_ + _SOBJ_CHUNK_COLORS / 2) % _SOBJ_CHUNK_COLORS ),
+#endif // SO_CHUNK_PROVISIONING
+	reserved_()
+#ifdef SO_CHUNK_PROVISIONING
+	,next_provision_(NULL)
+	,provision_queued_(false)
+#endif // SO_CHUNK_PROVISIONING
 {
+	BOOST_STATIC_ASSERT_MSG( 0 == offsetof(arena, rwb_) % SO_CACHE_LINE_SIZE, "synchronization fields must start a cache line" );
+	BOOST_STATIC_ASSERT_MSG( offsetof(arena, rwb_) >= offsetof(arena, chunks_) + sizeof(chunks_rmap), "synchronization fields must follow the hot fields" );
+	BOOST_STATIC_ASSERT_MSG( 0 == offsetof(arena, reserved_) % SO_CACHE_LINE_SIZE, "reserved flag must start a cache line" );
+	BOOST_STATIC_ASSERT_MSG( 0 == sizeof(arena) % SO_CACHE_LINE_SIZE, "arena must take whole cache lines" );
 	reserved_.test_and_set();
-	chunk* first = create_new_chunk( block_size_ );
-	alloc_current_ = first;
-	free_current_  = first;
-	chunks_.insert( first->begin(),  first->end(), BOOST_MOVE_BASE(chunk*,first) );
+	// lending arenas hand out whole chunks only, so the current chunks are never lent
+	if(first_chunk) {
+		chunk* first = create_new_chunk(chunk_bytes_, color_);
+		alloc_current_ = first;
+		free_current_  = first;
+		chunks_.insert( first->begin(),  first->end(), BOOST_MOVE_BASE(chunk*,first) );
+	}
+	// spare chunks are requested by the first slow path miss, so that cold size classes
+	// and the region arenas take no memory ahead
 }
 
 arena::~arena() BOOST_NOEXCEPT_OR_NOTHROW {
-	for(chunks_rmap::iterator it= chunks_.begin(); it != chunks_.end(); ++it)
+#ifdef SO_CHUNK_PROVISIONING
+	chunk_provider::cancel(this);
+	release_spares();
+#endif // SO_CHUNK_PROVISIONING
+	for(chunks_rmap::iterator it= chunks_.begin(); it != chunks_.end(); ++it) {
+		if(locked_)
+			sys::xunlock( it->second, it->second->size() );
 		release_chunk( it->second );
+	}
 }
 
 BOOST_FORCEINLINE uint8_t* arena::try_to_alloc(chunk* const chnk) BOOST_NOEXCEPT_OR_NOTHROW {
-	sys::read_lock lock(rwb_);
 	uint8_t *result = chnk->allocate(block_size_);
 	if(NULL != result)
 		alloc_current_ = chnk;
@@ -51,26 +119,46 @@ void* arena::malloc BOOST_PREVENT_MACRO_SUBSTITUTION()
 	uint8_t* result = try_to_alloc(alloc_current_);
 	if(NULL != result) return static_cast<void*>(result);
 	// search in reserved space
+	SO_INSTRUMENT_EVENT(CHUNK_SCAN);
+	SO_PERF_REGION(SLOW_PATH_REGION);
 	chunk* current = NULL;
 	chunks_rmap::iterator it = chunks_.begin();
 	chunks_rmap::iterator end = chunks_.end();
 	while( it != end ) {
 		current = it->second;
+		// blocks released by other threads are taken back here, rather than on every call
+		current->collect();
 		result = try_to_alloc(current);
 		if(result)
 			return static_cast<void*>(result);
 		++it;
 	}
-	// no free space left, create new chunk
-	current = create_new_chunk(block_size_);
+	// no free space left, take a spare chunk or create new one, the next one is larger
+	current = next_chunk();
 	result = current->allocate(block_size_);
-	sys::write_lock lock(rwb_);
+	write_lock lock(rwb_);
 	chunks_.insert(current->begin(), current->end(), BOOST_MOVE_BASE(chunk*,current) );
+	chunk_bytes_ = next_chunk_bytes(chunk_bytes_);
+	if(locked_)
+		sys::xlock( current, current->size() );
 	alloc_current_ = current;
 	free_current_ = current;
 	return static_cast<void*>(result);
 }
 
+void* arena::operator new(const std::size_t size)
+{
+	void* result = sys::xmalloc_aligned(size, SO_CACHE_LINE_SIZE);
+	if(NULL == result)
+		boost::throw_exception( std::bad_alloc() );
+	return result;
+}
+
+void arena::operator delete(void* const ptr) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	sys::xfree_aligned(ptr);
+}
+
 bool arena::lookup_chunk_and_free(const uint8_t *ptr) BOOST_NOEXCEPT_OR_NOTHROW {
 	chunks_rmap::iterator it = chunks_.find(ptr);
 	if(it == chunks_.end() )
@@ -79,36 +167,46 @@ bool arena::lookup_chunk_and_free(const uint8_t *ptr) BOOST_NOEXCEPT_OR_NOTHROW
 	return true;
 }
 
-void arena::shrink() BOOST_NOEXCEPT_OR_NOTHROW {
-	sys::write_lock lock(rwb_);
-	typedef std::vector<chunk*, sys::allocator<chunk*> > chvector;
-	chvector non_empty;
-	chunks_rmap::iterator it = chunks_.begin();
-	chunks_rmap::iterator end = chunks_.end();
-	while(it != end)
-	{
-		if(!it->second->empty()) {
-#if __cplusplus >= 201103L
-			non_empty.emplace_back( it->second );
-#else
-			non_empty.push_back( BOOST_MOVE_BASE(chunk*, it->second) );
-#endif // __cplusplus
-		} else
-			release_chunk( it->second );
-		++it;
+void arena::collect() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	for(chunks_rmap::iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+		it->second->collect();
+}
+
+bool arena::release_if_empty(const chunks_rmap::value_type& v) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	if( v.second->empty() ) {
+		release_chunk( v.second );
+		return true;
 	}
-	chunks_.clear();
-	chvector::iterator i = non_empty.begin();
-	chvector::iterator last = non_empty.end();
-	while(i != last)
-	{
-		chunks_.insert( (*i)->begin(), (*i)->end(), BOOST_MOVE_BASE(chunk*,*i) );
-		++i;
+	return false;
+}
+
+void arena::shrink() BOOST_NOEXCEPT_OR_NOTHROW {
+	SO_INSTRUMENT_EVENT(SHRINK);
+	SO_PERF_REGION(SHRINK_REGION);
+	write_lock lock(rwb_);
+	// no thread queues blocks under the write lock
+	collect();
+	if(locked_) {
+		for(chunks_rmap::iterator it = chunks_.begin(); it != chunks_.end(); ++it) {
+			if( it->second->empty() )
+				sys::xunlock( it->second, it->second->size() );
+		}
 	}
-	non_empty.clear();
+	// single pass, surviving nodes are re-linked in place
+	chunks_.erase_if( &arena::release_if_empty );
+#ifdef SO_CHUNK_PROVISIONING
+	release_spares();
+#endif // SO_CHUNK_PROVISIONING
+	// demand is dropping, so are the next chunks
+	chunk_bytes_ = (chunk_bytes_ >> 1) > _SOBJ_MIN_CHUNK_SIZE ? (chunk_bytes_ >> 1) : _SOBJ_MIN_CHUNK_SIZE;
 	if(chunks_.empty())
 	{
-		chunk* first = create_new_chunk( block_size_ );
+		chunk_bytes_ = _SOBJ_MIN_CHUNK_SIZE;
+		chunk* first = create_new_chunk(chunk_bytes_, color_);
+		if(locked_)
+			sys::xlock( first, first->size() );
 		alloc_current_ = first;
 		free_current_  = first;
 		chunks_.insert( first->begin(),  first->end(), BOOST_MOVE_BASE(chunk*,first) );
@@ -118,5 +216,165 @@ void arena::shrink() BOOST_NOEXCEPT_OR_NOTHROW {
 	}
 }
 
+void arena::occupancy(occupancy_stat& stat) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	read_lock lock(rwb_);
+	++stat.arenas;
+#ifdef SO_CHUNK_PROVISIONING
+	stat.spare_chunks += spare_count_;
+#endif // SO_CHUNK_PROVISIONING
+	for(chunks_rmap::iterator it = chunks_.begin(); it != chunks_.end(); ++it) {
+		const chunk* cnk = it->second;
+		const std::size_t blocks = cnk->blocks();
+		const std::size_t header_bytes = chunk::header_size(blocks);
+		const std::size_t free_blocks = cnk->free_blocks();
+		const std::size_t used_blocks = blocks - free_blocks;
+		++stat.chunks;
+		if(0 == used_blocks)
+			++stat.empty_chunks;
+		stat.used_blocks += used_blocks;
+		stat.free_blocks += free_blocks;
+		stat.reserved_bytes += cnk->size();
+		stat.header_bytes += header_bytes;
+		// color offset and the page tail
+		stat.alignment_bytes += cnk->size() - header_bytes - block_size_ * blocks;
+		// full chunks go to the last bucket
+		++stat.histogram[ std::min<std::size_t>( (used_blocks * _SOBJ_OCCUPANCY_BUCKETS) / blocks, _SOBJ_OCCUPANCY_BUCKETS - 1 ) ];
+	}
+}
+
+void arena::prepare(const std::size_t blocks)
+{
+	collect();
+	std::size_t free_blocks = 0;
+	for(chunks_rmap::iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+		free_blocks += it->second->free_blocks();
+	while(free_blocks < blocks) {
+		chunk* cnk = next_chunk();
+		write_lock lock(rwb_);
+		chunks_.insert( cnk->begin(), cnk->end(), BOOST_MOVE_BASE(chunk*,cnk) );
+		chunk_bytes_ = next_chunk_bytes(chunk_bytes_);
+		if(locked_)
+			sys::xlock( cnk, cnk->size() );
+		free_blocks += cnk->free_blocks();
+	}
+	// the owner is the caller, and other threads never modify the chunks free stacks
+	for(chunks_rmap::iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+		it->second->prefault(block_size_);
+}
+
+bool arena::lock() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	bool result = true;
+	write_lock lock(rwb_);
+	locked_ = true;
+	for(chunks_rmap::iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+		result &= sys::xlock( it->second, it->second->size() );
+#ifdef SO_CHUNK_PROVISIONING
+	for(std::size_t i = 0; i < spare_count_; i++)
+		result &= sys::xlock( spares_[i], spares_[i]->size() );
+#endif // SO_CHUNK_PROVISIONING
+	return result;
+}
+
+chunk* arena::lend()
+{
+	{
+		write_lock lock(rwb_);
+		collect();
+		for(chunks_rmap::iterator it = chunks_.begin(); it != chunks_.end(); ++it) {
+			chunk* cnk = it->second;
+			if( cnk->empty() && cnk != alloc_current_ && cnk != free_current_ ) {
+				chunks_.erase(it);
+				return cnk;
+			}
+		}
+	}
+	chunk* result = next_chunk();
+	// regions demand grows as well
+	write_lock lock(rwb_);
+	chunk_bytes_ = next_chunk_bytes(chunk_bytes_);
+	// empty chunks above were locked already, when they were taken into this arena
+	if(locked_)
+		sys::xlock( result, result->size() );
+	return result;
+}
+
+void arena::reclaim(chunk* const cnk) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	cnk->reset();
+	write_lock lock(rwb_);
+	BOOST_TRY {
+		chunks_.insert( cnk->begin(), cnk->end(), BOOST_MOVE_BASE(chunk*,cnk) );
+	} BOOST_CATCH(...) {
+		// no memory for the index, give chunk back to the system
+		if(locked_)
+			sys::xunlock( cnk, cnk->size() );
+		release_chunk(cnk);
+	}
+	BOOST_CATCH_END
+}
+
+#ifdef SO_CHUNK_PROVISIONING
+chunk* arena::take_spare() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	chunk* result = NULL;
+	{
+		write_lock lock(rwb_);
+		if(0 != spare_count_)
+			result = spares_[--spare_count_];
+	}
+	// the provider lock is taken only when the arena is not queued yet
+	if( !provision_queued_.load(boost::memory_order_acquire) )
+		chunk_provider::request(this);
+	return result;
+}
+
+void arena::provision() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	for(;;) {
+		std::size_t bytes;
+		bool locked;
+		{
+			read_lock lock(rwb_);
+			if(spare_count_ >= _SOBJ_SPARE_CHUNKS)
+				return;
+			// spares are taken last in first out, so the new spare is the next chunk
+			bytes = chunk_bytes_;
+			locked = locked_;
+		}
+		chunk* cnk = NULL;
+		BOOST_TRY {
+			cnk = create_new_chunk(bytes, spare_color_);
+		} BOOST_CATCH(...) {
+			// out of memory, owner creates chunks itself
+			return;
+		}
+		BOOST_CATCH_END
+		// pages are faulted in by the lock here, rather than by the owner
+		if(locked)
+			sys::xlock( cnk, cnk->size() );
+		write_lock lock(rwb_);
+		if(spare_count_ >= _SOBJ_SPARE_CHUNKS) {
+			if(locked)
+				sys::xunlock( cnk, cnk->size() );
+			release_chunk(cnk);
+			return;
+		}
+		spares_[spare_count_++] = cnk;
+	}
+}
+
+void arena::release_spares() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	while(0 != spare_count_) {
+		chunk* const cnk = spares_[--spare_count_];
+		if(locked_)
+			sys::xunlock( cnk, cnk->size() );
+		release_chunk(cnk);
+	}
+}
+#endif // SO_CHUNK_PROVISIONING
+
 }
 } //  namespace smallobject { namespace detail
@@ -1,21 +1,66 @@
 #include "chunk.hpp"
+#include "config.hpp"
+
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/alignment_of.hpp>
 
 namespace smallobject { namespace detail {
 
-const uint8_t chunk::MAX_BLOCKS = UCHAR_MAX;
+// writes a byte into every page of the memory, so that the pages are faulted in
+static void touch(uint8_t* const begin, const uint8_t* const end) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	if(begin >= end)
+		return;
+	for(volatile uint8_t* p = begin; p < end; p += _SOBJ_PAGE_SIZE)
+		*p = 0;
+	*const_cast<volatile uint8_t*>(end - 1) = 0;
+}
+
+const std::size_t chunk::MAX_BLOCKS;
+const std::size_t chunk::BLOCK_HEADER_BYTES;
+const std::size_t chunk::ALIGNMENT;
+const chunk::index_type chunk::NO_BLOCK;
+
+BOOST_STATIC_ASSERT_MSG( boost::alignment_of<long double>::value <= chunk::ALIGNMENT, "blocks must be aligned for any fundamental type" );
+BOOST_STATIC_ASSERT_MSG( boost::alignment_of<void*>::value <= chunk::ALIGNMENT, "blocks must be aligned for any fundamental type" );
 
-chunk::chunk(const uint8_t block_size, const uint8_t* begin) BOOST_NOEXCEPT_OR_NOTHROW:
+chunk::chunk(const std::size_t block_size, const std::size_t blocks, const uint8_t* begin, const std::size_t size) BOOST_NOEXCEPT_OR_NOTHROW:
 	begin_( begin ),
-	end_(begin + (MAX_BLOCKS * block_size) ),
-	free_blocks_(MAX_BLOCKS),
-	position_(0)
+	end_(begin + (blocks * block_size) ),
+	size_( static_cast<uint32_t>(size) ),
+	blocks_( static_cast<index_type>(blocks) ),
+	free_blocks_( static_cast<index_type>(blocks) ),
+	top_(0),
+	bump_(0),
+	remote_top_(NO_BLOCK)
+{}
+
+void chunk::reset() BOOST_NOEXCEPT_OR_NOTHROW
 {
-	uint8_t* p = const_cast<uint8_t*>(begin_);
-	for(uint8_t i=1; i < MAX_BLOCKS; i++) {
-		*p = i;
-		p += block_size;
+	// neither blocks memory nor the free stack is touched
+	free_blocks_ = blocks_;
+	top_ = 0;
+	bump_ = 0;
+	remote_top_.store(NO_BLOCK, boost::memory_order_relaxed);
+}
+
+void chunk::collect_remote() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	const index_type* const links = remote_links();
+	index_type idx = remote_top_.exchange(NO_BLOCK, boost::memory_order_acquire);
+	while(NO_BLOCK != idx) {
+		free_stack()[top_++] = idx;
+		++free_blocks_;
+		idx = links[idx];
 	}
 }
 
+void chunk::prefault(const std::size_t block_size) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	// released blocks and the stack below the top were written already
+	touch( reinterpret_cast<uint8_t*>(free_stack() + top_), reinterpret_cast<const uint8_t*>(free_stack() + blocks_) );
+	touch( const_cast<uint8_t*>(begin_) + bump_ * block_size, end_ );
+}
+
 } } // { namespace smallobject { namespace detail
 
@@ -0,0 +1,113 @@
+#include "arena.hpp"
+
+#ifdef SO_CHUNK_PROVISIONING
+
+#include <boost/core/no_exceptions_support.hpp>
+#include <boost/thread/thread_only.hpp>
+
+namespace smallobject { namespace detail {
+
+// chunk_provider
+chunk_provider::chunk_provider():
+	mtx_(),
+	queued_(),
+	refilled_(),
+	head_(NULL),
+	tail_(NULL),
+	current_(NULL)
+{}
+
+chunk_provider* chunk_provider::instance() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	chunk_provider *tmp = _instance.load(boost::memory_order_consume);
+	if (!tmp) {
+		unique_lock lock(_smtx);
+		tmp = _instance.load(boost::memory_order_consume);
+		if (!tmp) {
+			BOOST_TRY {
+				tmp = new chunk_provider();
+				boost::thread( &chunk_provider::run, tmp ).detach();
+			} BOOST_CATCH(...) {
+				delete tmp;
+				return NULL;
+			}
+			BOOST_CATCH_END
+			_instance.store(tmp, boost::memory_order_release);
+		}
+	}
+	return tmp;
+}
+
+void chunk_provider::run() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	boost::unique_lock<boost::mutex> lock(mtx_);
+	for(;;) {
+		while(NULL == head_)
+			queued_.wait(lock);
+		arena* ar = head_;
+		head_ = ar->next_provision_;
+		if(NULL == head_)
+			tail_ = NULL;
+		ar->next_provision_ = NULL;
+		// requests made from now on queue the arena again
+		ar->provision_queued_.store(false, boost::memory_order_release);
+		current_ = ar;
+		lock.unlock();
+		ar->provision();
+		lock.lock();
+		current_ = NULL;
+		refilled_.notify_all();
+	}
+}
+
+void chunk_provider::request(arena* const ar) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	chunk_provider* const cp = instance();
+	if(NULL == cp)
+		return;
+	BOOST_TRY {
+		boost::unique_lock<boost::mutex> lock(cp->mtx_);
+		if( ar->provision_queued_.load(boost::memory_order_relaxed) )
+			return;
+		ar->provision_queued_.store(true, boost::memory_order_relaxed);
+		if(NULL == cp->tail_)
+			cp->head_ = ar;
+		else
+			cp->tail_->next_provision_ = ar;
+		cp->tail_ = ar;
+		cp->queued_.notify_one();
+	} BOOST_CATCH(...) {
+		// lock failed, arena is not queued and the owner creates chunks itself
+	}
+	BOOST_CATCH_END
+}
+
+void chunk_provider::cancel(arena* const ar) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	chunk_provider* const cp = _instance.load(boost::memory_order_acquire);
+	if(NULL == cp)
+		return;
+	boost::unique_lock<boost::mutex> lock(cp->mtx_);
+	if( ar->provision_queued_.load(boost::memory_order_relaxed) ) {
+		arena* prev = NULL;
+		for(arena* it = cp->head_; it != ar; it = it->next_provision_)
+			prev = it;
+		if(NULL == prev)
+			cp->head_ = ar->next_provision_;
+		else
+			prev->next_provision_ = ar->next_provision_;
+		if(cp->tail_ == ar)
+			cp->tail_ = prev;
+		ar->next_provision_ = NULL;
+		ar->provision_queued_.store(false, boost::memory_order_relaxed);
+	}
+	while(cp->current_ == ar)
+		cp->refilled_.wait(lock);
+}
+
+sys::critical_section chunk_provider::_smtx;
+boost::atomic<chunk_provider*> chunk_provider::_instance(NULL);
+
+} } // namespace smallobject { namespace detail
+
+#endif // SO_CHUNK_PROVISIONING
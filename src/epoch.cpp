@@ -0,0 +1,284 @@
+#include "epoch.hpp"
+
+#include <boost/core/no_exceptions_support.hpp>
+
+namespace smallobject {
+
+// epoch_domain
+static BOOST_CONSTEXPR_OR_CONST std::size_t QUIESCENT = 0;
+
+epoch_domain::thread_record::thread_record(epoch_domain* const owner):
+	epoch(QUIESCENT),
+	in_use(true),
+	nesting(0),
+	retired_count(0),
+	next(NULL),
+	limbo(),
+	hooks(NULL),
+	domain(owner)
+{}
+
+// limbo list entry of an exited thread, parked in the domain wide list
+struct orphan_entry: public epoch_domain::retired_hook {
+	void* ptr;
+	epoch_domain::deleter_f release;
+};
+
+static void release_orphan_entry(void* const hook) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	orphan_entry* const entry = static_cast<orphan_entry*>( static_cast<epoch_domain::retired_hook*>(hook) );
+	void* const ptr = entry->ptr;
+	const epoch_domain::deleter_f release = entry->release;
+	entry->~orphan_entry();
+	sys::xfree(entry);
+	release(ptr);
+}
+
+epoch_domain* epoch_domain::instance()
+{
+	epoch_domain *tmp = _instance.load(boost::memory_order_consume);
+	if (!tmp) {
+		unique_lock lock(_smtx);
+		tmp = _instance.load(boost::memory_order_consume);
+		if (!tmp) {
+			tmp = new epoch_domain();
+			_instance.store(tmp, boost::memory_order_release);
+			std::atexit(&epoch_domain::release);
+		}
+	}
+	return tmp;
+}
+
+epoch_domain::epoch_domain():
+	global_epoch_(1),
+	records_(NULL),
+	orphans_(NULL),
+	local_(&epoch_domain::release_record)
+{}
+
+epoch_domain::~epoch_domain() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	// release the record of current thread
+	local_.reset();
+	thread_record *it = records_.exchange(NULL, boost::memory_order_acquire);
+	while(NULL != it) {
+		thread_record *rec = it;
+		it = it->next;
+		while( !rec->limbo.empty() || NULL != rec->hooks )
+			reclaim(rec, true);
+		rec->~thread_record();
+		sys::xfree(rec);
+	}
+	while( NULL != orphans_.load(boost::memory_order_acquire) )
+		reclaim_orphans(0, true);
+}
+
+void epoch_domain::release_record(thread_record* rec) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	// memory retired by the thread is reclaimed by the next collect of any thread,
+	// rather than when another thread takes the record
+	epoch_domain* const domain = rec->domain;
+	while( !rec->limbo.empty() ) {
+		void* const ptr = sys::xmalloc( sizeof(orphan_entry) );
+		// out of memory, the rest is reclaimed by the next record owner
+		if(NULL == ptr)
+			break;
+		const retired& r = rec->limbo.back();
+		orphan_entry* const entry = new (ptr) orphan_entry();
+		entry->next = NULL;
+		entry->deleter = &release_orphan_entry;
+		entry->epoch = r.epoch;
+		entry->ptr = r.ptr;
+		entry->release = r.deleter;
+		rec->limbo.pop_back();
+		domain->push_orphans(entry, entry);
+	}
+	if(NULL != rec->hooks) {
+		retired_hook *last = rec->hooks;
+		while(NULL != last->next)
+			last = last->next;
+		domain->push_orphans(rec->hooks, last);
+		rec->hooks = NULL;
+	}
+	rec->retired_count = 0;
+	rec->nesting = 0;
+	rec->epoch.store(QUIESCENT, boost::memory_order_release);
+	rec->in_use.store(false, boost::memory_order_release);
+}
+
+epoch_domain::thread_record* epoch_domain::local_record()
+{
+	thread_record *result = local_.get();
+	if(NULL != result)
+		return result;
+	// reuse a record released by finished thread
+	for(thread_record *it = records_.load(boost::memory_order_acquire); NULL != it; it = it->next) {
+		bool expected = false;
+		if( !it->in_use.load(boost::memory_order_relaxed) &&
+			it->in_use.compare_exchange_strong(expected, true, boost::memory_order_acquire) ) {
+			local_.reset(it);
+			return it;
+		}
+	}
+	void *ptr = sys::xmalloc( sizeof(thread_record) );
+	if(NULL == ptr)
+		boost::throw_exception( std::bad_alloc() );
+	result = new (ptr) thread_record(this);
+	thread_record *head = records_.load(boost::memory_order_relaxed);
+	do {
+		result->next = head;
+	} while( !records_.compare_exchange_weak(head, result, boost::memory_order_release, boost::memory_order_relaxed) );
+	local_.reset(result);
+	return result;
+}
+
+void epoch_domain::enter()
+{
+	thread_record *rec = local_record();
+	if(0 == rec->nesting++) {
+		rec->epoch.store( global_epoch_.load(boost::memory_order_seq_cst), boost::memory_order_relaxed );
+		// announce epoch before any shared pointer load
+		boost::atomic_thread_fence(boost::memory_order_seq_cst);
+	}
+}
+
+void epoch_domain::leave() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	thread_record *rec = local_.get();
+	assert(NULL != rec && rec->nesting > 0);
+	if(0 == --rec->nesting)
+		rec->epoch.store(QUIESCENT, boost::memory_order_release);
+}
+
+void epoch_domain::retire(void* ptr, deleter_f deleter)
+{
+	thread_record *rec = local_record();
+	retired r = { ptr, deleter, global_epoch_.load(boost::memory_order_seq_cst) };
+	rec->limbo.push_back(r);
+	if(++rec->retired_count >= _SOBJ_EPOCH_COLLECT_THRESHOLD) {
+		rec->retired_count = 0;
+		try_advance();
+		reclaim(rec, false);
+	}
+}
+
+void epoch_domain::retire(retired_hook* const hook, deleter_f deleter) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	hook->next = NULL;
+	hook->deleter = deleter;
+	hook->epoch = global_epoch_.load(boost::memory_order_seq_cst);
+	thread_record *rec = local_.get();
+	if(NULL == rec) {
+		BOOST_TRY {
+			rec = local_record();
+		} BOOST_CATCH(...) {
+			// out of memory, released by collect of any thread with a record
+			push_orphans(hook, hook);
+			return;
+		}
+		BOOST_CATCH_END
+	}
+	hook->next = rec->hooks;
+	rec->hooks = hook;
+	if(++rec->retired_count >= _SOBJ_EPOCH_COLLECT_THRESHOLD) {
+		rec->retired_count = 0;
+		try_advance();
+		reclaim(rec, false);
+	}
+}
+
+void epoch_domain::collect()
+{
+	thread_record *rec = local_record();
+	rec->retired_count = 0;
+	try_advance();
+	reclaim(rec, false);
+}
+
+bool epoch_domain::try_advance() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	std::size_t current = global_epoch_.load(boost::memory_order_seq_cst);
+	for(thread_record *it = records_.load(boost::memory_order_acquire); NULL != it; it = it->next) {
+		const std::size_t e = it->epoch.load(boost::memory_order_seq_cst);
+		if(QUIESCENT != e && current != e)
+			return false;
+	}
+	return global_epoch_.compare_exchange_strong(current, current + 1, boost::memory_order_seq_cst);
+}
+
+void epoch_domain::reclaim(thread_record* const rec, const bool all) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	const std::size_t safe = global_epoch_.load(boost::memory_order_seq_cst);
+	// deleters may retire more pointers, so a ready one is taken out of the limbo list
+	// before its deleter is called, without allocating memory
+	std::size_t i = 0;
+	while( i < rec->limbo.size() ) {
+		const retired r = rec->limbo[i];
+		if( all || r.epoch + 2 <= safe ) {
+			rec->limbo[i] = rec->limbo.back();
+			rec->limbo.pop_back();
+			r.deleter(r.ptr);
+		} else {
+			++i;
+		}
+	}
+	retired_hook *hooks = rec->hooks;
+	rec->hooks = NULL;
+	hooks = reclaim_hooks(hooks, safe, all);
+	if(NULL != hooks) {
+		retired_hook *last = hooks;
+		while(NULL != last->next)
+			last = last->next;
+		last->next = rec->hooks;
+		rec->hooks = hooks;
+	}
+	if( NULL != orphans_.load(boost::memory_order_relaxed) )
+		reclaim_orphans(safe, all);
+}
+
+void epoch_domain::reclaim_orphans(const std::size_t safe, const bool all) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	retired_hook *hooks = reclaim_hooks( orphans_.exchange(NULL, boost::memory_order_acquire), safe, all );
+	if(NULL != hooks) {
+		retired_hook *last = hooks;
+		while(NULL != last->next)
+			last = last->next;
+		push_orphans(hooks, last);
+	}
+}
+
+void epoch_domain::push_orphans(retired_hook* const first, retired_hook* const last) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	retired_hook *head = orphans_.load(boost::memory_order_relaxed);
+	do {
+		last->next = head;
+	} while( !orphans_.compare_exchange_weak(head, first, boost::memory_order_release, boost::memory_order_relaxed) );
+}
+
+epoch_domain::retired_hook* epoch_domain::reclaim_hooks(retired_hook* it, const std::size_t safe, const bool all) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	// deleters may retire more hooks, they go to the record list and not to the list being walked
+	retired_hook *kept = NULL;
+	while(NULL != it) {
+		retired_hook *const hook = it;
+		it = it->next;
+		if( all || hook->epoch + 2 <= safe ) {
+			hook->deleter( static_cast<void*>(hook) );
+		} else {
+			hook->next = kept;
+			kept = hook;
+		}
+	}
+	return kept;
+}
+
+void epoch_domain::release() BOOST_NOEXCEPT_OR_NOTHROW {
+	epoch_domain* instance = _instance.load(boost::memory_order_relaxed);
+	delete instance;
+	_instance.store(NULL);
+}
+
+sys::critical_section epoch_domain::_smtx;
+boost::atomic<epoch_domain*> epoch_domain::_instance(NULL);
+
+} // namespace smallobject
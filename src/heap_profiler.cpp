@@ -0,0 +1,188 @@
+#include "heap_profiler.hpp"
+#include "sys_allocator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <boost/core/no_exceptions_support.hpp>
+#include <boost/unordered_map.hpp>
+
+#if defined(__GLIBC__)
+#	include <execinfo.h>
+#endif // __GLIBC__
+
+namespace smallobject {
+
+// heap_profiler
+
+struct heap_sample {
+	std::size_t size;
+	int depth;
+	void* stack[_SOBJ_PROFILER_MAX_DEPTH];
+};
+
+typedef boost::unordered_map<
+			const void*,
+			heap_sample,
+			boost::hash<const void*>,
+			std::equal_to<const void*>,
+			sys::allocator< std::pair<const void* const, heap_sample> >
+		> heap_samples_map;
+
+typedef std::vector<heap_sample, sys::allocator<heap_sample> > heap_samples_list;
+
+// count of bytes between checks whether profiler was started
+static const std::ptrdiff_t IDLE_INTERVAL = 1024 * 1024;
+
+static boost::atomic_size_t _sample_period(0);
+// sample period of the profile, kept after stop
+static boost::atomic_size_t _profile_period(0);
+static sys::critical_section _samples_mtx;
+// never destroyed, memory can be released after static destructors
+static heap_samples_map* _samples = NULL;
+static SO_THREAD_LOCAL uint64_t _sample_rnd = 0;
+
+// returns geometrically distributed count of bytes until next sample, with the mean of period
+static std::ptrdiff_t next_sample_interval(const std::size_t period) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	if(0 == _sample_rnd)
+		_sample_rnd = reinterpret_cast<std::size_t>(&_sample_rnd) | 1;
+	_sample_rnd ^= _sample_rnd << 13;
+	_sample_rnd ^= _sample_rnd >> 7;
+	_sample_rnd ^= _sample_rnd << 17;
+	// uniform in (0,1]
+	const double u = static_cast<double>( (_sample_rnd >> 11) + 1 ) * (1.0 / 9007199254740992.0);
+	return static_cast<std::ptrdiff_t>( -std::log(u) * static_cast<double>(period) ) + 1;
+}
+
+static bool stack_less(const heap_sample& lhs, const heap_sample& rhs) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	if(lhs.depth != rhs.depth)
+		return lhs.depth < rhs.depth;
+	return std::memcmp(lhs.stack, rhs.stack, lhs.depth * sizeof(void*)) < 0;
+}
+
+static bool stack_equal(const heap_sample& lhs, const heap_sample& rhs) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	return lhs.depth == rhs.depth && 0 == std::memcmp(lhs.stack, rhs.stack, lhs.depth * sizeof(void*));
+}
+
+void heap_profiler::start(const std::size_t sample_period) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	const std::size_t period = sample_period > 0 ? sample_period : 1;
+	_profile_period.store(period, boost::memory_order_relaxed);
+	_sample_period.store(period, boost::memory_order_relaxed);
+}
+
+void heap_profiler::stop() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	_sample_period.store(0, boost::memory_order_relaxed);
+}
+
+void heap_profiler::sample(void* const ptr, const std::size_t size) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	const std::size_t period = _sample_period.load(boost::memory_order_relaxed);
+	if(0 == period) {
+		_bytes_until_sample = IDLE_INTERVAL;
+		return;
+	}
+	_bytes_until_sample = next_sample_interval(period);
+	if(NULL == ptr)
+		return;
+	heap_sample s;
+	s.size = size;
+#if defined(__GLIBC__)
+	// skip the frame of this function
+	void* frames[_SOBJ_PROFILER_MAX_DEPTH + 1];
+	const int depth = ::backtrace(frames, _SOBJ_PROFILER_MAX_DEPTH + 1);
+	s.depth = depth > 1 ? depth - 1 : 0;
+	std::memcpy(s.stack, frames + 1, s.depth * sizeof(void*) );
+#else
+	s.depth = 0;
+#endif // __GLIBC__
+	unique_lock lock(_samples_mtx);
+	BOOST_TRY {
+		if(NULL == _samples) {
+			void* mem = sys::xmalloc( sizeof(heap_samples_map) );
+			if(NULL == mem)
+				return;
+			_samples = new (mem) heap_samples_map();
+		}
+		std::pair<heap_samples_map::iterator, bool> ret = _samples->insert( std::make_pair( static_cast<const void*>(ptr), s) );
+		if(ret.second)
+			_filter[ filter_cell(ptr) ].fetch_add(1, boost::memory_order_relaxed);
+		else
+			ret.first->second = s;
+	} BOOST_CATCH(...) {
+		// sample is lost when there is no memory for it
+	}
+	BOOST_CATCH_END
+}
+
+void heap_profiler::forget(const void* const ptr) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	unique_lock lock(_samples_mtx);
+	if(NULL != _samples && 0 != _samples->erase(ptr) )
+		_filter[ filter_cell(ptr) ].fetch_sub(1, boost::memory_order_relaxed);
+}
+
+bool heap_profiler::dump(const char* path) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	heap_samples_list live;
+	BOOST_TRY {
+		unique_lock lock(_samples_mtx);
+		if(NULL != _samples) {
+			live.reserve( _samples->size() );
+			for(heap_samples_map::const_iterator it = _samples->begin(); it != _samples->end(); ++it)
+				live.push_back(it->second);
+		}
+	} BOOST_CATCH(...) {
+		return false;
+	}
+	BOOST_CATCH_END
+	std::FILE* f = std::fopen(path, "w");
+	if(NULL == f)
+		return false;
+	std::sort(live.begin(), live.end(), &stack_less);
+	std::size_t total_bytes = 0;
+	for(heap_samples_list::const_iterator it = live.begin(); it != live.end(); ++it)
+		total_bytes += it->size;
+	// gperftools heap profile, pprof un-samples counts with the sample period
+	std::fprintf(f, "heap profile: %6zu: %8zu [%6zu: %8zu] @ heap_v2/%zu\n",
+				live.size(), total_bytes, live.size(), total_bytes, _profile_period.load(boost::memory_order_relaxed) );
+	heap_samples_list::const_iterator it = live.begin();
+	while(it != live.end()) {
+		std::size_t count = 0;
+		std::size_t bytes = 0;
+		heap_samples_list::const_iterator site = it;
+		for(; it != live.end() && stack_equal(*site, *it); ++it) {
+			++count;
+			bytes += it->size;
+		}
+		std::fprintf(f, "%6zu: %8zu [%6zu: %8zu] @", count, bytes, count, bytes);
+		for(int i = 0; i < site->depth; i++)
+			std::fprintf(f, " %p", site->stack[i]);
+		std::fputc('\n', f);
+	}
+#ifdef __linux__
+	// symbolization needs memory map of the process
+	std::fputs("\nMAPPED_LIBRARIES:\n", f);
+	std::FILE* maps = std::fopen("/proc/self/maps", "r");
+	if(NULL != maps) {
+		char buff[4096];
+		std::size_t read;
+		while( 0 != (read = std::fread(buff, 1, sizeof(buff), maps) ) )
+			std::fwrite(buff, 1, read, f);
+		std::fclose(maps);
+	}
+#endif // __linux__
+	return 0 == std::fclose(f);
+}
+
+SO_THREAD_LOCAL std::ptrdiff_t heap_profiler::_bytes_until_sample = 0;
+boost::atomic<uint16_t> heap_profiler::_filter[_SOBJ_PROFILER_FILTER_SIZE];
+
+} // namespace smallobject
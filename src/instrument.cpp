@@ -0,0 +1,29 @@
+#include "instrument.hpp"
+
+namespace smallobject {
+
+// instrument
+
+bool instrument::enabled() BOOST_NOEXCEPT_OR_NOTHROW
+{
+#ifdef SO_INSTRUMENT
+	return true;
+#else
+	return false;
+#endif // SO_INSTRUMENT
+}
+
+const char* instrument::name(const slow_path_event ev) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	static const char* NAMES[SLOW_PATH_EVENTS_COUNT] = {
+		"new_chunk",
+		"chunk_scan",
+		"remote_free",
+		"shrink"
+	};
+	return ev < SLOW_PATH_EVENTS_COUNT ? NAMES[ev] : "unknown";
+}
+
+SO_THREAD_LOCAL uint64_t instrument::_events[SLOW_PATH_EVENTS_COUNT] = {0, 0, 0, 0};
+
+} // namespace smallobject
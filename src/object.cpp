@@ -1,4 +1,13 @@
 #include "object.hpp"
+#include "perf_counters.hpp"
+#include "region.hpp"
+
+#ifdef SO_HEAP_PROFILER
+#	include "heap_profiler.hpp"
+#endif // SO_HEAP_PROFILER
+#ifdef SO_TRACE
+#	include "allocation_trace.hpp"
+#endif // SO_TRACE
 
 namespace smallobject {
 
@@ -7,14 +16,32 @@ namespace smallobject {
 object::~object() BOOST_NOEXCEPT_OR_NOTHROW
 {}
 
-void* object::operator new(std::size_t bytes) BOOST_THROWS(std::bad_alloc)
+namespace detail {
+
+void* allocate_object(std::size_t bytes) BOOST_THROWS(std::bad_alloc)
 {
-	if(bytes > detail::object_allocator::MAX_SIZE)
+	if(bytes > object_allocator::MAX_SIZE)
 		return ::operator new(bytes);
+	region* active = region::current();
+	if(NULL != active)
+		return active->allocate(bytes);
 	for(;;) {
-		void* result = detail::object_allocator::instance()->malloc(bytes);
-		if(NULL != result)
+		void* result;
+		{
+			SO_PERF_REGION(ALLOCATOR_CALL_REGION);
+			result = object_allocator::instance()->malloc(bytes);
+		}
+		if(NULL != result) {
+			// hooks are compiled into the library only, so clients built with other options
+			// share the same inline allocator code
+#ifdef SO_HEAP_PROFILER
+			heap_profiler::on_malloc(result, bytes);
+#endif // SO_HEAP_PROFILER
+#ifdef SO_TRACE
+			allocation_trace::on_malloc(result, bytes);
+#endif // SO_TRACE
 			return result;
+		}
 		std::new_handler new_handler = std::get_new_handler();
 		if(NULL == new_handler)
 #ifdef BOOST_NO_EXCEPTIONS
@@ -27,14 +54,34 @@ void* object::operator new(std::size_t bytes) BOOST_THROWS(std::bad_alloc)
 	return NULL;
 }
 
-void object::operator delete(void* const ptr,std::size_t bytes) BOOST_NOEXCEPT_OR_NOTHROW {
-	if(bytes <= detail::object_allocator::MAX_SIZE) {
-		detail::object_allocator::instance()->free(ptr, bytes);
+void release_object(void* const ptr,std::size_t bytes) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	if(bytes <= object_allocator::MAX_SIZE) {
+		// memory owned by a region is released with the region reset
+		region* active = region::current();
+		if(NULL != active && active->owns(ptr))
+			return;
+#ifdef SO_HEAP_PROFILER
+		heap_profiler::on_free(ptr);
+#endif // SO_HEAP_PROFILER
+#ifdef SO_TRACE
+		allocation_trace::on_free(ptr, bytes);
+#endif // SO_TRACE
+		// allocated in a region which scope has already ended, no pool arena owns it
+		bool released;
+		{
+			SO_PERF_REGION(ALLOCATOR_CALL_REGION);
+			released = object_allocator::instance()->free(ptr, bytes);
+		}
+		assert( released || NULL != region::owner(ptr) );
+		(void)released;
 	} else {
 		::operator delete(ptr);
 	}
 }
 
+} // namespace detail
+
 } // namespace smallobject
 
 #if (defined(SO_DLL) && defined(BUILD_DLL)) && (defined(_WIN32) || defined(__WIN32__) || defined(WIN32)) && !defined(__CYGWIN__)
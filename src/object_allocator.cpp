@@ -1,15 +1,18 @@
 #include "object_allocator.hpp"
 
+#include <cstring>
+#include <stdexcept>
+
 namespace smallobject { namespace detail {
 
 // object_allocator
-BOOST_CONSTEXPR_OR_CONST std::size_t object_allocator::MAX_SIZE = sizeof(std::size_t) * 16;
+BOOST_CONSTEXPR_OR_CONST std::size_t object_allocator::MAX_SIZE;
 // 8 bytes for 32 bit and 16 bytes for 64 bit
 BOOST_CONSTEXPR_OR_CONST std::size_t object_allocator::MIN_SIZE = align_up( sizeof(std::size_t), sizeof(std::size_t)*2 );
 // 2 since object size not changed
 BOOST_CONSTEXPR_OR_CONST std::size_t object_allocator::SHIFT = MIN_SIZE / sizeof(std::size_t);
-// 14 pools
-BOOST_CONSTEXPR_OR_CONST std::size_t object_allocator::POOLS_COUNT = ( ( object_allocator::MAX_SIZE / sizeof(std::size_t) ) ) - SHIFT; // count of small object pools = 14
+// 15 pools, from MIN_SIZE to MAX_SIZE inclusive
+BOOST_CONSTEXPR_OR_CONST std::size_t object_allocator::POOLS_COUNT = ( ( object_allocator::MAX_SIZE / sizeof(std::size_t) ) ) - SHIFT + 1; // count of small object pools = 15
 
 object_allocator* object_allocator::instance()
 {
@@ -29,7 +32,10 @@ object_allocator* object_allocator::instance()
 object_allocator::object_allocator():
 	pools_( NULL )
 {
-	pool* p = static_cast<pool*>(sys::xmalloc(POOLS_COUNT * sizeof(pool) ) );
+	// pools start at a cache line boundary, and do not share cache lines
+	pool* p = static_cast<pool*>( sys::xmalloc_aligned(POOLS_COUNT * sizeof(pool), SO_CACHE_LINE_SIZE) );
+	if(NULL == p)
+		boost::throw_exception( std::bad_alloc() );
 	pools_= p;
 	for(uint8_t i = 0; i < POOLS_COUNT ; i++ ) {
 		p = new (p) pool();
@@ -44,7 +50,50 @@ object_allocator::~object_allocator() BOOST_NOEXCEPT_OR_NOTHROW {
 		p->~pool();
 		++p;
 	}
-	sys::xfree(pools_);
+	sys::xfree_aligned(pools_);
+}
+
+std::size_t object_allocator::size_classes() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	return POOLS_COUNT;
+}
+
+void object_allocator::occupancy(const std::size_t size_class, occupancy_stat& stat) const BOOST_NOEXCEPT_OR_NOTHROW
+{
+	std::memset( &stat, 0, sizeof(occupancy_stat) );
+	if(size_class >= POOLS_COUNT)
+		return;
+	stat.block_size = (size_class + SHIFT) * sizeof(std::size_t);
+	pools_[size_class].occupancy(stat);
+}
+
+void object_allocator::shrink() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	for(std::size_t i = 0; i < POOLS_COUNT; i++)
+		pools_[i].shrink();
+}
+
+bool object_allocator::reserve(const std::size_t size_class, const std::size_t count, const bool lock)
+{
+	if(size_class >= POOLS_COUNT)
+		boost::throw_exception( std::out_of_range("smallobject: no such size class") );
+	return pools_[size_class].prepare( (size_class + SHIFT) * sizeof(std::size_t), count, lock );
+}
+
+bool object_allocator::prepare_thread(const std::size_t count, const bool lock)
+{
+	bool result = true;
+	for(std::size_t i = 0; i < POOLS_COUNT; i++)
+		result &= reserve(i, count, lock);
+	return result;
+}
+
+bool object_allocator::lock_memory() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	bool result = true;
+	for(std::size_t i = 0; i < POOLS_COUNT; i++)
+		result &= pools_[i].lock();
+	return result;
 }
 
 void object_allocator::release() BOOST_NOEXCEPT_OR_NOTHROW {
@@ -0,0 +1,228 @@
+#include "perf_counters.hpp"
+#include "sys_allocator.hpp"
+
+#include <cstring>
+
+#include <boost/core/no_exceptions_support.hpp>
+#include <boost/thread/tss.hpp>
+
+#ifdef __linux__
+#	define SO_PERF_EVENT_OPEN
+#	include <linux/perf_event.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif // __linux__
+
+namespace smallobject {
+
+// perf_counters
+
+// counter group of a thread
+struct perf_group {
+	// group leader descriptor, -1 when no counter could be opened
+	int leader;
+	// count of opened counters
+	std::size_t opened;
+	// descriptors of the opened counters
+	int fds[PERF_COUNTERS_COUNT];
+	// position of a counter value in the group read, or -1 when the counter is not supported
+	int slots[PERF_COUNTERS_COUNT];
+};
+
+static SO_THREAD_LOCAL perf_group* _local_group = NULL;
+// counters could not be opened in this thread, do not try again
+static SO_THREAD_LOCAL bool _local_unavailable = false;
+
+#ifdef SO_PERF_EVENT_OPEN
+
+static int open_counter(const perf_counter counter, const int leader) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	struct perf_event_attr attr;
+	std::memset( &attr, 0, sizeof(attr) );
+	attr.size = sizeof(attr);
+	switch(counter) {
+	case CPU_CYCLES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case INSTRUCTIONS:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case L1D_MISSES:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case LLC_MISSES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		break;
+	case DTLB_MISSES:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case BRANCH_MISSES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+		break;
+	default:
+		return -1;
+	}
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// pinned group is always on the PMU, so that values need no multiplexing scale
+	attr.pinned = leader < 0 ? 1 : 0;
+	return static_cast<int>( ::syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0) );
+}
+
+#endif // SO_PERF_EVENT_OPEN
+
+static void close_group(perf_group* const group) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	_local_group = NULL;
+#ifdef SO_PERF_EVENT_OPEN
+	for(std::size_t i = 0; i < group->opened; i++)
+		::close(group->fds[i]);
+#endif // SO_PERF_EVENT_OPEN
+	sys::xfree(group);
+}
+
+static perf_group* local_group() BOOST_NOEXCEPT_OR_NOTHROW
+{
+#ifdef SO_PERF_EVENT_OPEN
+	perf_group* group = static_cast<perf_group*>( sys::xmalloc( sizeof(perf_group) ) );
+	if(NULL == group) {
+		_local_unavailable = true;
+		return NULL;
+	}
+	group->leader = -1;
+	group->opened = 0;
+	for(std::size_t i = 0; i < PERF_COUNTERS_COUNT; i++) {
+		const int fd = open_counter( static_cast<perf_counter>(i), group->leader );
+		if(fd < 0) {
+			group->slots[i] = -1;
+			continue;
+		}
+		if(group->leader < 0)
+			group->leader = fd;
+		group->slots[i] = static_cast<int>(group->opened);
+		group->fds[group->opened++] = fd;
+	}
+	if(group->leader < 0) {
+		sys::xfree(group);
+		_local_unavailable = true;
+		return NULL;
+	}
+	BOOST_TRY {
+		// closes counters on thread exit, never destroyed since threads may exit after static destructors
+		static boost::thread_specific_ptr<perf_group> *groups = new boost::thread_specific_ptr<perf_group>(&close_group);
+		groups->reset(group);
+	} BOOST_CATCH(...) {
+		close_group(group);
+		_local_unavailable = true;
+		return NULL;
+	}
+	BOOST_CATCH_END
+	_local_group = group;
+	return group;
+#else
+	_local_unavailable = true;
+	return NULL;
+#endif // SO_PERF_EVENT_OPEN
+}
+
+bool perf_counters::enabled() BOOST_NOEXCEPT_OR_NOTHROW
+{
+#ifdef SO_PERF_COUNTERS
+	return true;
+#else
+	return false;
+#endif // SO_PERF_COUNTERS
+}
+
+bool perf_counters::available() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	perf_values values;
+	return read(values);
+}
+
+const char* perf_counters::name(const perf_counter counter) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	static const char* NAMES[PERF_COUNTERS_COUNT] = {
+		"cycles",
+		"instructions",
+		"l1d_misses",
+		"llc_misses",
+		"dtlb_misses",
+		"branch_misses"
+	};
+	return counter < PERF_COUNTERS_COUNT ? NAMES[counter] : "unknown";
+}
+
+const char* perf_counters::name(const perf_region region) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	static const char* NAMES[PERF_REGIONS_COUNT] = {
+		"allocator_call",
+		"slow_path",
+		"remote_free",
+		"shrink"
+	};
+	return region < PERF_REGIONS_COUNT ? NAMES[region] : "unknown";
+}
+
+bool perf_counters::read(perf_values& result) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	std::memset( &result, 0, sizeof(result) );
+	if(_local_unavailable)
+		return false;
+	perf_group* group = _local_group;
+	if(NULL == group) {
+		group = local_group();
+		if(NULL == group)
+			return false;
+	}
+#ifdef SO_PERF_EVENT_OPEN
+	// count of values followed by the values in the group order
+	uint64_t buff[PERF_COUNTERS_COUNT + 1];
+	const ssize_t bytes = ::read( group->leader, buff, sizeof(buff) );
+	// pinned group which could not be scheduled reads end of file
+	if( bytes < static_cast<ssize_t>( sizeof(uint64_t) * (group->opened + 1) ) )
+		return false;
+	for(std::size_t i = 0; i < PERF_COUNTERS_COUNT; i++) {
+		if(group->slots[i] >= 0)
+			result.values[i] = buff[group->slots[i] + 1];
+	}
+	return true;
+#else
+	return false;
+#endif // SO_PERF_EVENT_OPEN
+}
+
+uint64_t perf_counters::totals(const perf_region region, perf_values& result) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	for(std::size_t i = 0; i < PERF_COUNTERS_COUNT; i++)
+		result.values[i] = _totals[region][i].load(boost::memory_order_relaxed);
+	return _calls[region].load(boost::memory_order_relaxed);
+}
+
+void perf_counters::reset() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	for(std::size_t r = 0; r < PERF_REGIONS_COUNT; r++) {
+		for(std::size_t i = 0; i < PERF_COUNTERS_COUNT; i++)
+			_totals[r][i].store(0, boost::memory_order_relaxed);
+		_calls[r].store(0, boost::memory_order_relaxed);
+	}
+}
+
+void perf_counters::accumulate(const perf_region region, const perf_values& start, const perf_values& end) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	for(std::size_t i = 0; i < PERF_COUNTERS_COUNT; i++)
+		_totals[region][i].fetch_add(end.values[i] - start.values[i], boost::memory_order_relaxed);
+	_calls[region].fetch_add(1, boost::memory_order_relaxed);
+}
+
+boost::atomic<uint64_t> perf_counters::_totals[PERF_REGIONS_COUNT][PERF_COUNTERS_COUNT];
+boost::atomic<uint64_t> perf_counters::_calls[PERF_REGIONS_COUNT];
+
+} // namespace smallobject
@@ -1,5 +1,9 @@
 #include "pool.hpp"
 
+#include <cstddef>
+
+#include <boost/static_assert.hpp>
+
 namespace smallobject { namespace detail {
 
 // poll
@@ -10,8 +14,13 @@ inline void pool::release_arena(arena* ar) BOOST_NOEXCEPT_OR_NOTHROW
 }
 
 pool::pool():
-	arena_(&pool::release_arena)
-{}
+	arena_(&pool::release_arena),
+	arenas_(),
+	locked_(false)
+{
+	BOOST_STATIC_ASSERT_MSG( 0 == offsetof(pool, arenas_) % SO_CACHE_LINE_SIZE, "arenas list must start a cache line" );
+	BOOST_STATIC_ASSERT_MSG( 0 == sizeof(pool) % SO_CACHE_LINE_SIZE, "pool must take whole cache lines" );
+}
 
 pool::~pool() BOOST_NOEXCEPT_OR_NOTHROW
 {
@@ -41,18 +50,64 @@ void pool::reserve(const std::size_t size)
 	if( NULL == arena_.get() ) {
 		arena_.reset( new arena(size) );
 		arenas_.push_front( arena_.get() );
+		// either lock() sees the arena in the list, or the arena sees the flag
+		if( locked_.load(boost::memory_order_seq_cst) )
+			arena_->lock();
 	}
 }
 
+bool pool::prepare(const std::size_t size, const std::size_t blocks, const bool lock)
+{
+	if(NULL == arena_.get())
+		reserve(size);
+	arena* const ar = arena_.get();
+	bool result = true;
+	if(lock)
+		result = ar->lock();
+	ar->prepare(blocks);
+	return result;
+}
+
+bool pool::lock() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	locked_.store(true, boost::memory_order_seq_cst);
+	bool result = true;
+	for(arenas_pool::iterator it = arenas_.begin(); it != arenas_.end(); ++it)
+		result &= (*it)->lock();
+	return result;
+}
 
-void pool::thread_miss_free(void * const ptr) BOOST_NOEXCEPT_OR_NOTHROW {
-	arenas_pool::iterator it = arenas_.begin();
-	arenas_pool::iterator end = arenas_.end();
-	do {
-		if( (*it)->synch_free(ptr) ) {
-			return;
+
+void pool::occupancy(occupancy_stat& stat) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	for(arenas_pool::iterator it = arenas_.begin(); it != arenas_.end(); ++it)
+		(*it)->occupancy(stat);
+}
+
+void pool::shrink() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	arena* const own = arena_.get();
+	if(NULL != own)
+		own->shrink();
+	// arenas of other threads are skipped, since the owner reads chunks without a lock
+	for(arenas_pool::iterator it = arenas_.begin(); it != arenas_.end(); ++it) {
+		arena* ar = *it;
+		if(ar != own && ar->reserve() ) {
+			ar->shrink();
+			ar->release();
 		}
-	} while(++it != end);
+	}
+}
+
+bool pool::thread_miss_free(void * const ptr) BOOST_NOEXCEPT_OR_NOTHROW {
+	SO_INSTRUMENT_EVENT(REMOTE_FREE);
+	SO_PERF_REGION(REMOTE_FREE_REGION);
+	// list is empty when no thread allocated from this pool yet, i.e. memory of a region
+	for(arenas_pool::iterator it = arenas_.begin(); it != arenas_.end(); ++it) {
+		if( (*it)->synch_free(ptr) )
+			return true;
+	}
+	return false;
 }
 
 }} //  namespace smallobject { namespace detail
@@ -0,0 +1,114 @@
+#include "ref_count.hpp"
+#include "sys_allocator.hpp"
+
+#include <boost/thread/tss.hpp>
+
+namespace smallobject {
+
+// biased_ref_count
+static biased_ref_count* const CLOSED_INBOX = reinterpret_cast<biased_ref_count*>( static_cast<std::size_t>(1) );
+
+biased_ref_count::biased_ref_count():
+	owner_( local_owner() ),
+	biased_(0),
+	merged_(false),
+	shared_(0),
+	next_(NULL)
+{}
+
+biased_ref_count::~biased_ref_count() BOOST_NOEXCEPT_OR_NOTHROW
+{}
+
+biased_ref_count::owner_record* biased_ref_count::local_owner()
+{
+	if(NULL != _local_owner)
+		return _local_owner;
+	// record is never released, since objects outlive their owner thread
+	void *ptr = sys::xmalloc( sizeof(owner_record) );
+	if(NULL == ptr)
+		boost::throw_exception( std::bad_alloc() );
+	owner_record *result = static_cast<owner_record*>(ptr);
+	new ( static_cast<void*>(&result->inbox) ) boost::atomic<biased_ref_count*>(NULL);
+	// closes owner inbox on thread exit, never destroyed since objects may be released
+	// after the static destructors and the allocator shutdown
+	static boost::thread_specific_ptr<owner_record> *owners = new boost::thread_specific_ptr<owner_record>(&biased_ref_count::close_owner);
+	owners->reset(result);
+	_local_owner = result;
+	return result;
+}
+
+void biased_ref_count::close_owner(owner_record* rec) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	_local_owner = NULL;
+	drain(rec, CLOSED_INBOX);
+}
+
+void biased_ref_count::collect() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	if(NULL != _local_owner)
+		drain(_local_owner, NULL);
+}
+
+void biased_ref_count::drain(owner_record* const rec, biased_ref_count* const replacement) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	biased_ref_count* it = rec->inbox.exchange(replacement, boost::memory_order_acq_rel);
+	while(NULL != it) {
+		biased_ref_count* next = it->next_;
+		if( it->merge_queued() )
+			delete it;
+		it = next;
+	}
+}
+
+bool biased_ref_count::merge_by_owner() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	merged_ = true;
+	const int32_t old = shared_.fetch_or(MERGED, boost::memory_order_acq_rel);
+	// queued object is deleted by the inbox drain
+	return 0 == (old & ~FLAGS) && 0 == (old & QUEUED);
+}
+
+bool biased_ref_count::merge_queued() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	const int32_t biased = merged_ ? 0 : static_cast<int32_t>(biased_) * ONE;
+	merged_ = true;
+	biased_ = 0;
+	int32_t old = shared_.load(boost::memory_order_relaxed);
+	int32_t desired;
+	do {
+		desired = ( (old + biased) | MERGED ) & ~QUEUED;
+	} while( !shared_.compare_exchange_weak(old, desired, boost::memory_order_acq_rel, boost::memory_order_relaxed) );
+	return 0 == (desired & ~FLAGS);
+}
+
+bool biased_ref_count::release_shared() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	int32_t old = shared_.load(boost::memory_order_relaxed);
+	int32_t desired;
+	do {
+		desired = old - ONE;
+		// owner may hold the rest of references, or not, only owner knows
+		if( 0 == (old & FLAGS) && (desired & ~FLAGS) <= 0 )
+			desired |= QUEUED;
+	} while( !shared_.compare_exchange_weak(old, desired, boost::memory_order_acq_rel, boost::memory_order_relaxed) );
+	if( 0 != (desired & QUEUED) )
+		return ( 0 == (old & QUEUED) ) ? enqueue() : false;
+	return 0 != (desired & MERGED) && 0 == (desired & ~FLAGS);
+}
+
+bool biased_ref_count::enqueue() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	boost::atomic<biased_ref_count*>& inbox = owner_->inbox;
+	biased_ref_count* head = inbox.load(boost::memory_order_acquire);
+	do {
+		// owner thread have exited, and never touches biased counter again
+		if(CLOSED_INBOX == head)
+			return merge_queued();
+		next_ = head;
+	} while( !inbox.compare_exchange_weak(head, this, boost::memory_order_release, boost::memory_order_acquire) );
+	return false;
+}
+
+SO_THREAD_LOCAL biased_ref_count::owner_record* biased_ref_count::_local_owner = NULL;
+
+} // namespace smallobject
@@ -0,0 +1,117 @@
+#include "region.hpp"
+
+#include "range_map.hpp"
+
+namespace smallobject {
+
+static SO_THREAD_LOCAL region* _active_region = NULL;
+
+// chunks of all regions, looked up only when memory is released out of the region scope
+typedef range_map<
+		const uint8_t*,
+		region*,
+		detail::byte_ptr_less,
+		sys::allocator< movable_pair< const range<const uint8_t*, detail::byte_ptr_less >, region* > >
+		> chunks_registry;
+
+static sys::critical_section _registry_mtx;
+// created with the first region chunk, and never destroyed since regions may outlive static objects
+static chunks_registry* _registry = NULL;
+
+static void register_chunk(detail::chunk* const cnk, region* const owner)
+{
+	unique_lock lock(_registry_mtx);
+	if(NULL == _registry) {
+		void *ptr = sys::xmalloc( sizeof(chunks_registry) );
+		if(NULL == ptr)
+			boost::throw_exception( std::bad_alloc() );
+		_registry = new (ptr) chunks_registry();
+	}
+	region* value = owner;
+	_registry->insert( cnk->begin(), cnk->end(), BOOST_MOVE_BASE(region*,value) );
+}
+
+static void unregister_chunk(detail::chunk* const cnk) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	unique_lock lock(_registry_mtx);
+	_registry->erase( _registry->find( cnk->begin() ) );
+}
+
+// region::scope
+region::scope::scope(region& r) BOOST_NOEXCEPT_OR_NOTHROW:
+	prev_(_active_region)
+{
+	_active_region = &r;
+}
+
+region::scope::~scope() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	_active_region = prev_;
+}
+
+// region
+region::region():
+	arena_(detail::object_allocator::MAX_SIZE, false),
+	chunks_(),
+	top_(NULL),
+	end_(NULL)
+{}
+
+region::~region() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	reset();
+}
+
+region* region::current() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	return _active_region;
+}
+
+void region::next_chunk()
+{
+	chunks_.reserve( chunks_.size() + 1 );
+	detail::chunk* cnk = arena_.lend();
+	BOOST_TRY {
+		register_chunk(cnk, this);
+	} BOOST_CATCH(...) {
+		arena_.reclaim(cnk);
+		BOOST_RETHROW
+	}
+	BOOST_CATCH_END
+	chunks_.push_back(cnk);
+	top_ = const_cast<uint8_t*>( cnk->begin() );
+	end_ = const_cast<uint8_t*>( cnk->end() );
+}
+
+bool region::owns(const void* ptr) const BOOST_NOEXCEPT_OR_NOTHROW
+{
+	const uint8_t* p = static_cast<const uint8_t*>(ptr);
+	// most recent chunk is the most likely owner
+	for(chunks_list::const_reverse_iterator it = chunks_.rbegin(); it != chunks_.rend(); ++it) {
+		if( p >= (*it)->begin() && p < (*it)->end() )
+			return true;
+	}
+	return false;
+}
+
+region* region::owner(const void* ptr) BOOST_NOEXCEPT_OR_NOTHROW
+{
+	unique_lock lock(_registry_mtx);
+	if(NULL == _registry)
+		return NULL;
+	chunks_registry::iterator it = _registry->find( static_cast<const uint8_t*>(ptr) );
+	return it != _registry->end() ? it->second : NULL;
+}
+
+void region::reset() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	for(chunks_list::const_iterator it = chunks_.begin(); it != chunks_.end(); ++it) {
+		unregister_chunk(*it);
+		arena_.reclaim(*it);
+	}
+	chunks_.clear();
+	top_ = NULL;
+	end_ = NULL;
+}
+
+} // namespace smallobject
@@ -0,0 +1,68 @@
+#define BOOST_TEST_MODULE alignment
+#include <boost/test/included/unit_test.hpp>
+
+#include <vector>
+
+#include <object_allocator.hpp>
+#include <region.hpp>
+
+using smallobject::detail::chunk;
+using smallobject::detail::object_allocator;
+using smallobject::region;
+
+// blocks of a chunk start at ALIGNMENT, so a block is aligned to the greatest power of two
+// dividing its size, up to ALIGNMENT
+static std::size_t expected_alignment(const std::size_t size)
+{
+	const std::size_t result = size & (~size + 1);
+	return result < chunk::ALIGNMENT ? result : chunk::ALIGNMENT;
+}
+
+static bool aligned(const void* ptr, const std::size_t alignment)
+{
+	return 0 == reinterpret_cast<std::size_t>(ptr) % alignment;
+}
+
+BOOST_AUTO_TEST_CASE(header_size_aligned)
+{
+	for(std::size_t blocks = 0; blocks < 100; blocks++) {
+	//X
+		BOOST_CHECK_GE( chunk::header_size(blocks), sizeof(chunk) + blocks * sizeof(chunk::index_type) );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(every_size_class)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	// enough blocks to fill several growing chunks of every size class
+	const std::size_t count = 10000;
+	// size classes step down by sizeof(std::size_t) from MAX_SIZE
+	for(std::size_t i = 0; i < object_allocator::size_classes(); i++) {
+		const std::size_t size = object_allocator::MAX_SIZE - i * sizeof(std::size_t);
+		std::vector<void*> blocks;
+		blocks.reserve(count);
+		std::size_t misaligned = 0;
+		for(std::size_t i = 0; i < count; i++) {
+			void* const ptr = alloc->malloc(size);
+			if( !aligned(ptr, expected_alignment(size) ) )
+				++misaligned;
+			blocks.push_back(ptr);
+		}
+		BOOST_CHECK_MESSAGE( 0 == misaligned, "size " << size << ": " << misaligned << " misaligned blocks" );
+		for(std::size_t i = 0; i < blocks.size(); i++)
+			BOOST_REQUIRE( alloc->free(blocks[i], size) );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(region_allocations)
+{
+	region r;
+	// 16 byte blocks stay aligned to 16 bytes in every chunk of the region
+	for(int i = 0; i < 0x10000; i++)
+		BOOST_REQUIRE( aligned( r.allocate(16), 16 ) );
+	r.reset();
+	for(int i = 0; i < 0x10000; i++) {
+		const std::size_t bytes = 1 + (i * 7) % object_allocator::MAX_SIZE;
+		BOOST_REQUIRE( aligned( r.allocate(bytes), sizeof(std::size_t) ) );
+	}
+}
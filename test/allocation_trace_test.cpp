@@ -0,0 +1,180 @@
+#define BOOST_TEST_MODULE allocation_trace
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <allocation_trace.hpp>
+
+using smallobject::allocation_trace;
+using smallobject::trace_block_header;
+using smallobject::trace_file_header;
+using smallobject::trace_record;
+
+static const char* const LOG_PATH = "allocation_trace_test.log";
+
+struct traced_call {
+	uint32_t thread;
+	trace_record rec;
+};
+
+struct trace_log {
+	trace_file_header header;
+	std::vector<traced_call> calls;
+	// whether blocks take exactly the data size
+	bool consistent;
+};
+
+// reads the log the same way the replay tool does
+static bool read_log(trace_log& log)
+{
+	log.calls.clear();
+	log.consistent = false;
+	std::FILE* f = std::fopen(LOG_PATH, "rb");
+	if(NULL == f)
+		return false;
+	if( 1 != std::fread(&log.header, sizeof(trace_file_header), 1, f) ) {
+		std::fclose(f);
+		return false;
+	}
+	uint64_t left = log.header.data_size;
+	trace_block_header block;
+	while( left >= sizeof(block) && 1 == std::fread(&block, sizeof(block), 1, f) ) {
+		left -= sizeof(block);
+		if( 0 == block.count || left < block.count * sizeof(trace_record) )
+			break;
+		for(uint32_t i = 0; i < block.count; i++) {
+			traced_call call;
+			call.thread = block.thread;
+			if( 1 != std::fread(&call.rec, sizeof(trace_record), 1, f) )
+				break;
+			log.calls.push_back(call);
+		}
+		left -= block.count * sizeof(trace_record);
+	}
+	// nothing follows the data
+	log.consistent = 0 == left && EOF == std::fgetc(f);
+	std::fclose(f);
+	return true;
+}
+
+static const void* fake_address(const std::size_t base, const std::size_t i)
+{
+	return reinterpret_cast<const void*>( base + i * 16 );
+}
+
+// records a malloc and free pair per block, sizes cycle through the size classes
+static void record_calls(const std::size_t base, const std::size_t count)
+{
+	for(std::size_t i = 0; i < count; i++)
+		allocation_trace::on_malloc( fake_address(base, i), 16 + (i % 15) * 8 );
+	for(std::size_t i = 0; i < count; i++)
+		allocation_trace::on_free( fake_address(base, i), 16 + (i % 15) * 8 );
+}
+
+// checks the calls of one thread came back in the recorded order
+static void check_calls(const trace_log& log, const std::size_t base, const std::size_t count)
+{
+	std::vector<trace_record> own;
+	uint32_t thread = UINT32_MAX;
+	for(std::vector<traced_call>::const_iterator it = log.calls.begin(); it != log.calls.end(); ++it) {
+		if( it->rec.address() < base || it->rec.address() >= base + count * 16 )
+			continue;
+		if(UINT32_MAX == thread)
+			thread = it->thread;
+		BOOST_REQUIRE_EQUAL( it->thread, thread );
+		own.push_back(it->rec);
+	}
+	BOOST_REQUIRE_EQUAL( own.size(), count * 2 );
+	for(std::size_t i = 0; i < own.size(); i++) {
+		const std::size_t block = i % count;
+		BOOST_CHECK_EQUAL( own[i].op(), i < count ? trace_record::MALLOC : trace_record::FREE );
+		BOOST_CHECK_EQUAL( own[i].address(), base + block * 16 );
+		BOOST_CHECK_EQUAL( own[i].size(), 16 + (block % 15) * 8 );
+		if(i > 0)
+			BOOST_CHECK_LE( own[i-1].timestamp, own[i].timestamp );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(round_trip)
+{
+	static const std::size_t MAIN_BASE = 0x100000;
+	static const std::size_t THREAD_BASE = 0x900000;
+	// more calls than a buffer holds, so that full buffers are flushed before the stop
+	static const std::size_t COUNT = _SOBJ_TRACE_BUFFER_RECORDS + 100;
+	BOOST_REQUIRE( allocation_trace::start(LOG_PATH, std::size_t(1) << 20) );
+	record_calls(MAIN_BASE, COUNT);
+	boost::thread( boost::bind(&record_calls, THREAD_BASE, 100) ).join();
+	allocation_trace::stop();
+	// not recorded after the stop
+	record_calls(MAIN_BASE, 10);
+	trace_log log;
+	BOOST_REQUIRE( read_log(log) );
+	BOOST_CHECK_EQUAL( 0, std::memcmp(log.header.magic, "SOTRACE1", 8) );
+	BOOST_CHECK_EQUAL( log.header.dropped, 0u );
+	BOOST_CHECK_EQUAL( log.header.threads, 2u );
+	BOOST_CHECK( log.consistent );
+	BOOST_CHECK_EQUAL( log.calls.size(), COUNT * 2 + 200 );
+	check_calls(log, MAIN_BASE, COUNT);
+	check_calls(log, THREAD_BASE, 100);
+	std::remove(LOG_PATH);
+}
+
+BOOST_AUTO_TEST_CASE(dropped_beyond_capacity)
+{
+	// room for the header and a few records only
+	static const std::size_t CAPACITY = sizeof(trace_file_header) + 1024;
+	BOOST_REQUIRE( allocation_trace::start(LOG_PATH, CAPACITY) );
+	record_calls(0x100000, _SOBJ_TRACE_BUFFER_RECORDS);
+	allocation_trace::stop();
+	trace_log log;
+	BOOST_REQUIRE( read_log(log) );
+	BOOST_CHECK_EQUAL( log.header.dropped, 2u * _SOBJ_TRACE_BUFFER_RECORDS );
+	BOOST_CHECK_EQUAL( log.header.data_size, 0u );
+	BOOST_CHECK( log.consistent );
+	BOOST_CHECK( log.calls.empty() );
+	std::remove(LOG_PATH);
+}
+
+static boost::atomic_bool _stopped(false);
+
+static void record_until_stopped(const std::size_t base)
+{
+	std::size_t i = 0;
+	while( !_stopped.load(boost::memory_order_relaxed) ) {
+		allocation_trace::on_malloc( fake_address(base, i % 1024), 32 );
+		allocation_trace::on_free( fake_address(base, i % 1024), 32 );
+		++i;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(stop_while_recording)
+{
+	static const int THREADS = 4;
+	for(int round = 0; round < 10; round++) {
+		BOOST_REQUIRE( allocation_trace::start(LOG_PATH, std::size_t(1) << 24) );
+		_stopped.store(false);
+		boost::thread_group group;
+		for(int t = 0; t < THREADS; t++)
+			group.create_thread( boost::bind(&record_until_stopped, 0x100000 * (t + 1) ) );
+		boost::this_thread::sleep( boost::posix_time::milliseconds(5) );
+		// threads are still appending records while their buffers are flushed
+		allocation_trace::stop();
+		_stopped.store(true);
+		group.join_all();
+		trace_log log;
+		BOOST_REQUIRE( read_log(log) );
+		BOOST_CHECK( log.consistent );
+		// no record was torn by the flush
+		std::size_t torn = 0;
+		for(std::vector<traced_call>::const_iterator it = log.calls.begin(); it != log.calls.end(); ++it)
+			torn += 32 != it->rec.size() || it->thread >= log.header.threads;
+		BOOST_CHECK_EQUAL( torn, 0u );
+		std::remove(LOG_PATH);
+	}
+}
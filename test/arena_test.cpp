@@ -0,0 +1,153 @@
+#define BOOST_TEST_MODULE arena
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstring>
+#include <set>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <arena.hpp>
+#include <object_allocator.hpp>
+
+using smallobject::detail::arena;
+using smallobject::detail::chunk;
+using smallobject::detail::object_allocator;
+using smallobject::occupancy_stat;
+
+static const std::size_t BLOCK_SIZE = 48;
+
+// blocks the remote threads failed to release, checked by the main thread
+static boost::atomic<std::size_t> remote_misses(0);
+
+static void remote_free(arena* const ar, const std::vector<void*>* const blocks)
+{
+	for(std::size_t i = 0; i < blocks->size(); i++) {
+		if( !ar->synch_free( (*blocks)[i] ) )
+			++remote_misses;
+	}
+}
+
+static std::size_t used_blocks(arena* const ar)
+{
+	occupancy_stat stat;
+	std::memset( &stat, 0, sizeof(stat) );
+	ar->occupancy(stat);
+	return stat.used_blocks;
+}
+
+static std::size_t chunks_count(arena* const ar)
+{
+	occupancy_stat stat;
+	std::memset( &stat, 0, sizeof(stat) );
+	ar->occupancy(stat);
+	return stat.chunks;
+}
+
+BOOST_AUTO_TEST_CASE(remote_free_keeps_block_memory)
+{
+	arena* const ar = new arena(BLOCK_SIZE);
+	std::vector<void*> blocks;
+	for(int i = 0; i < 1000; i++) {
+		void* const ptr = ar->malloc();
+		std::memset(ptr, 0x5A, BLOCK_SIZE);
+		blocks.push_back(ptr);
+	}
+	boost::thread( boost::bind(&remote_free, ar, &blocks) ).join();
+	// queued blocks are neither written nor free until the owner collects them
+	for(std::size_t i = 0; i < blocks.size(); i++) {
+		const uint8_t* const p = static_cast<const uint8_t*>(blocks[i]);
+		for(std::size_t j = 0; j < BLOCK_SIZE; j++)
+			BOOST_REQUIRE_EQUAL( p[j], 0x5A );
+	}
+	BOOST_CHECK_EQUAL( used_blocks(ar), blocks.size() );
+	// foreign memory is not taken
+	uint8_t foreign[BLOCK_SIZE];
+	BOOST_CHECK( !ar->synch_free(foreign) );
+	// shrink collects the queued blocks, and releases the chunks
+	ar->shrink();
+	BOOST_CHECK_EQUAL( used_blocks(ar), 0u );
+	BOOST_CHECK_EQUAL( remote_misses.load(), 0u );
+	delete ar;
+}
+
+BOOST_AUTO_TEST_CASE(remote_freed_blocks_reused_once)
+{
+	arena* const ar = new arena(BLOCK_SIZE);
+	std::vector<void*> blocks;
+	for(int i = 0; i < 5000; i++)
+		blocks.push_back( ar->malloc() );
+	boost::thread( boost::bind(&remote_free, ar, &blocks) ).join();
+	// owner runs out of blocks in its chunks, and takes the queued blocks back exactly once
+	std::set<void*> live;
+	for(int i = 0; i < 10000; i++)
+		BOOST_REQUIRE( live.insert( ar->malloc() ).second );
+	for(std::set<void*>::iterator it = live.begin(); it != live.end(); ++it)
+		BOOST_REQUIRE( ar->free(*it) );
+	// queued blocks the owner did not need yet are collected by shrink
+	ar->shrink();
+	BOOST_CHECK_EQUAL( used_blocks(ar), 0u );
+	BOOST_CHECK_EQUAL( remote_misses.load(), 0u );
+	delete ar;
+}
+
+static void remote_free_rounds(arena* const ar, std::vector< std::vector<void*> >* const rounds, boost::barrier* const ready)
+{
+	for(std::size_t r = 0; r < rounds->size(); r++) {
+		ready->wait();
+		remote_free( ar, &(*rounds)[r] );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(owner_and_remote_race)
+{
+	static const std::size_t ROUNDS = 20;
+	arena* const ar = new arena(BLOCK_SIZE);
+	std::vector< std::vector<void*> > rounds(ROUNDS);
+	boost::barrier ready(2);
+	boost::thread remote( boost::bind(&remote_free_rounds, ar, &rounds, &ready) );
+	std::set<void*> live;
+	for(std::size_t r = 0; r < ROUNDS; r++) {
+		for(int i = 0; i < 2000; i++)
+			rounds[r].push_back( ar->malloc() );
+		ready.wait();
+		// owner allocates and releases while the remote thread queues the round blocks
+		for(int i = 0; i < 3000; i++) {
+			void* const ptr = ar->malloc();
+			BOOST_REQUIRE( live.insert(ptr).second );
+			if( 0 == i % 3 ) {
+				live.erase(ptr);
+				BOOST_REQUIRE( ar->free(ptr) );
+			}
+		}
+	}
+	remote.join();
+	for(std::set<void*>::iterator it = live.begin(); it != live.end(); ++it)
+		BOOST_REQUIRE( ar->free(*it) );
+	ar->shrink();
+	BOOST_CHECK_EQUAL( used_blocks(ar), 0u );
+	BOOST_CHECK_EQUAL( remote_misses.load(), 0u );
+	delete ar;
+}
+
+BOOST_AUTO_TEST_CASE(lending_arena_lends_every_chunk)
+{
+	// region arenas, no chunk is taken ahead of the first lend
+	arena* const ar = new arena(object_allocator::MAX_SIZE, false);
+	BOOST_CHECK_EQUAL( chunks_count(ar), 0u );
+	chunk* const first = ar->lend();
+	BOOST_REQUIRE( NULL != first );
+	BOOST_CHECK( first->empty() );
+	BOOST_CHECK_EQUAL( chunks_count(ar), 0u );
+	ar->reclaim(first);
+	BOOST_CHECK_EQUAL( chunks_count(ar), 1u );
+	// the only chunk of the arena is lent again, rather than a new one
+	chunk* const again = ar->lend();
+	BOOST_CHECK_EQUAL( again, first );
+	BOOST_CHECK_EQUAL( chunks_count(ar), 0u );
+	ar->reclaim(again);
+	delete ar;
+}
@@ -0,0 +1,215 @@
+#define BOOST_TEST_MODULE biased_ref_count
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstring>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <object.hpp>
+
+using smallobject::basic_object;
+using smallobject::biased_ref_count;
+
+static const int OBJECTS = 256;
+static const int THREADS = 4;
+
+// count of destructor calls per object id
+static boost::atomic_int disposed[OBJECTS];
+
+class shared_object: public basic_object<biased_ref_count> {
+public:
+	explicit shared_object(const int id):
+		basic_object<biased_ref_count>(),
+		id_(id)
+	{}
+	virtual ~shared_object() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		disposed[id_].fetch_add(1, boost::memory_order_relaxed);
+	}
+private:
+	const int id_;
+};
+
+typedef boost::intrusive_ptr<shared_object> s_shared_object;
+typedef std::vector<s_shared_object> objects_list;
+
+static void reset_disposed()
+{
+	for(int i = 0; i < OBJECTS; i++)
+		disposed[i] = 0;
+}
+
+static void check_disposed_once()
+{
+	for(int i = 0; i < OBJECTS; i++)
+		BOOST_CHECK_EQUAL( disposed[i].load(boost::memory_order_relaxed), 1 );
+}
+
+// releases the references handed by the owner, after copying and releasing each one a few times
+static void release_remote(objects_list* const refs)
+{
+	for(objects_list::iterator it = refs->begin(); it != refs->end(); ++it) {
+		for(int i = 0; i < 4; i++)
+			s_shared_object copy(*it);
+	}
+	refs->clear();
+}
+
+static void create_objects(objects_list* const owner_refs, std::vector<objects_list>* const remote_refs)
+{
+	for(int i = 0; i < OBJECTS; i++) {
+		s_shared_object obj( new shared_object(i) );
+		owner_refs->push_back(obj);
+		for(std::size_t t = 0; t < remote_refs->size(); t++)
+			(*remote_refs)[t].push_back(obj);
+	}
+}
+
+static void run_remote_release(std::vector<objects_list>& remote_refs)
+{
+	boost::thread_group group;
+	for(int t = 0; t < THREADS; t++)
+		group.create_thread( boost::bind(&release_remote, &remote_refs[t]) );
+	group.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(queued_to_owner)
+{
+	reset_disposed();
+	objects_list owner_refs;
+	std::vector<objects_list> remote_refs(THREADS);
+	// references copied by the owner are counted by the biased counter
+	create_objects(&owner_refs, &remote_refs);
+	// shared counters drop below zero, objects are queued to the owner inbox
+	run_remote_release(remote_refs);
+	for(int i = 0; i < OBJECTS; i++)
+		BOOST_CHECK_EQUAL( disposed[i].load(), 0 );
+	// owner merges the counters of the queued objects on release
+	owner_refs.clear();
+	biased_ref_count::collect();
+	check_disposed_once();
+}
+
+struct handoff {
+	const objects_list* owner_refs;
+	boost::barrier copied;
+	boost::barrier released;
+	explicit handoff(const objects_list& refs):
+		owner_refs(&refs),
+		copied(THREADS + 1),
+		released(THREADS + 1)
+	{}
+};
+
+// copies references on this thread, so that they are counted by the shared counter
+static void copy_then_release(handoff* const h)
+{
+	objects_list refs(*h->owner_refs);
+	h->copied.wait();
+	h->released.wait();
+	release_remote(&refs);
+}
+
+BOOST_AUTO_TEST_CASE(merged_by_owner)
+{
+	reset_disposed();
+	objects_list owner_refs;
+	for(int i = 0; i < OBJECTS; i++)
+		owner_refs.push_back( s_shared_object( new shared_object(i) ) );
+	handoff h(owner_refs);
+	boost::thread_group group;
+	for(int t = 0; t < THREADS; t++)
+		group.create_thread( boost::bind(&copy_then_release, &h) );
+	h.copied.wait();
+	// biased counters drop to zero and are merged, remote threads hold the rest of references
+	owner_refs.clear();
+	for(int i = 0; i < OBJECTS; i++)
+		BOOST_CHECK_EQUAL( disposed[i].load(), 0 );
+	h.released.wait();
+	group.join_all();
+	// the last remote release disposes, without the owner
+	check_disposed_once();
+}
+
+static void release_all(objects_list* const refs)
+{
+	refs->clear();
+	biased_ref_count::collect();
+}
+
+BOOST_AUTO_TEST_CASE(owner_and_remote_race)
+{
+	for(int round = 0; round < 20; round++) {
+		reset_disposed();
+		objects_list owner_refs;
+		std::vector<objects_list> remote_refs(THREADS);
+		create_objects(&owner_refs, &remote_refs);
+		boost::thread_group group;
+		for(int t = 0; t < THREADS; t++)
+			group.create_thread( boost::bind(&release_remote, &remote_refs[t]) );
+		release_all(&owner_refs);
+		group.join_all();
+		biased_ref_count::collect();
+		check_disposed_once();
+	}
+}
+
+static void create_and_exit(objects_list* const refs)
+{
+	objects_list owner_refs;
+	std::vector<objects_list> remote_refs(1);
+	create_objects(&owner_refs, &remote_refs);
+	refs->swap(remote_refs[0]);
+	// owner references are released, and the inbox is closed on thread exit
+}
+
+BOOST_AUTO_TEST_CASE(owner_thread_exited)
+{
+	reset_disposed();
+	objects_list refs;
+	boost::thread( boost::bind(&create_and_exit, &refs) ).join();
+	for(int i = 0; i < OBJECTS; i++)
+		BOOST_CHECK_EQUAL( disposed[i].load(), 0 );
+	// releasing thread merges counters itself
+	release_remote(&refs);
+	check_disposed_once();
+}
+
+static std::size_t chunks_count(const std::size_t size_class)
+{
+	smallobject::occupancy_stat stat;
+	std::memset( &stat, 0, sizeof(stat) );
+	smallobject::detail::object_allocator::instance()->occupancy(size_class, stat);
+	return stat.chunks;
+}
+
+struct block_list {
+	std::vector<void*> blocks;
+};
+
+static void free_blocks(block_list* const list)
+{
+	for(std::size_t i = 0; i < list->blocks.size(); i++)
+		smallobject::detail::release_object(list->blocks[i], 48);
+}
+
+BOOST_AUTO_TEST_CASE(remote_free_reused_by_owner)
+{
+	// size class of 48 bytes blocks
+	static const std::size_t SIZE_CLASS = 4;
+	block_list list;
+	for(int i = 0; i < 10000; i++)
+		list.blocks.push_back( smallobject::detail::allocate_object(48) );
+	const std::size_t chunks = chunks_count(SIZE_CLASS);
+	boost::thread( boost::bind(&free_blocks, &list) ).join();
+	// owner takes the blocks released by the other thread back once its free blocks run out,
+	// instead of creating new chunks
+	for(int i = 0; i < 10000; i++)
+		list.blocks[i] = smallobject::detail::allocate_object(48);
+	BOOST_CHECK_EQUAL( chunks_count(SIZE_CLASS), chunks );
+	free_blocks(&list);
+}
@@ -0,0 +1,127 @@
+#define BOOST_TEST_MODULE chunk_provider
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstring>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+#include <arena.hpp>
+
+using smallobject::detail::arena;
+using smallobject::occupancy_stat;
+
+static const std::size_t BLOCK_SIZE = 64;
+
+static occupancy_stat stat_of(arena* const ar)
+{
+	occupancy_stat stat;
+	std::memset( &stat, 0, sizeof(stat) );
+	ar->occupancy(stat);
+	return stat;
+}
+
+#ifdef SO_CHUNK_PROVISIONING
+
+// allocates blocks until the arena takes the next chunk, i.e. misses on the slow path
+static void allocate_past_chunk(arena* const ar, std::vector<void*>& blocks)
+{
+	const std::size_t chunks = stat_of(ar).chunks;
+	while( stat_of(ar).chunks == chunks )
+		blocks.push_back( ar->malloc() );
+}
+
+// waits for the provider thread, up to 10 seconds
+static bool wait_spares(arena* const ar, const std::size_t count)
+{
+	for(int i = 0; i < 10000; i++) {
+		if( stat_of(ar).spare_chunks == count )
+			return true;
+		boost::this_thread::sleep( boost::posix_time::milliseconds(1) );
+	}
+	return false;
+}
+
+static void free_all(arena* const ar, const std::vector<void*>& blocks)
+{
+	for(std::size_t i = 0; i < blocks.size(); i++)
+		BOOST_REQUIRE( ar->free(blocks[i]) );
+}
+
+BOOST_AUTO_TEST_CASE(no_spares_before_first_miss)
+{
+	arena* const ar = new arena(BLOCK_SIZE);
+	std::vector<void*> blocks;
+	for(int i = 0; i < 16; i++)
+		blocks.push_back( ar->malloc() );
+	boost::this_thread::sleep( boost::posix_time::milliseconds(50) );
+	BOOST_CHECK_EQUAL( stat_of(ar).spare_chunks, 0u );
+	free_all(ar, blocks);
+	delete ar;
+}
+
+BOOST_AUTO_TEST_CASE(refilled_after_miss)
+{
+	arena* const ar = new arena(BLOCK_SIZE);
+	std::vector<void*> blocks;
+	allocate_past_chunk(ar, blocks);
+	BOOST_REQUIRE( wait_spares(ar, _SOBJ_SPARE_CHUNKS) );
+	// the next miss takes a spare, and the provider refills it again
+	const std::size_t chunks = stat_of(ar).chunks;
+	allocate_past_chunk(ar, blocks);
+	BOOST_CHECK_EQUAL( stat_of(ar).chunks, chunks + 1 );
+	BOOST_CHECK( wait_spares(ar, _SOBJ_SPARE_CHUNKS) );
+	free_all(ar, blocks);
+	delete ar;
+}
+
+BOOST_AUTO_TEST_CASE(shrink_releases_spares)
+{
+	arena* const ar = new arena(BLOCK_SIZE);
+	std::vector<void*> blocks;
+	allocate_past_chunk(ar, blocks);
+	BOOST_REQUIRE( wait_spares(ar, _SOBJ_SPARE_CHUNKS) );
+	free_all(ar, blocks);
+	ar->shrink();
+	const occupancy_stat stat = stat_of(ar);
+	BOOST_CHECK_EQUAL( stat.spare_chunks, 0u );
+	BOOST_CHECK_EQUAL( stat.chunks, 1u );
+	delete ar;
+}
+
+BOOST_AUTO_TEST_CASE(cancel_on_destruction)
+{
+	// arenas are destroyed while queued, or while the provider thread refills them
+	for(int i = 0; i < 100; i++) {
+		arena* const ar = new arena(BLOCK_SIZE);
+		std::vector<void*> blocks;
+		allocate_past_chunk(ar, blocks);
+		if( 0 != (i % 2) )
+			boost::this_thread::yield();
+		free_all(ar, blocks);
+		delete ar;
+	}
+	// provider thread still serves the new arenas
+	arena* const ar = new arena(BLOCK_SIZE);
+	std::vector<void*> blocks;
+	allocate_past_chunk(ar, blocks);
+	BOOST_CHECK( wait_spares(ar, _SOBJ_SPARE_CHUNKS) );
+	free_all(ar, blocks);
+	delete ar;
+}
+
+#else
+
+BOOST_AUTO_TEST_CASE(no_spares_without_provisioning)
+{
+	arena* const ar = new arena(BLOCK_SIZE);
+	std::vector<void*> blocks;
+	for(int i = 0; i < 10000; i++)
+		blocks.push_back( ar->malloc() );
+	BOOST_CHECK_EQUAL( stat_of(ar).spare_chunks, 0u );
+	for(std::size_t i = 0; i < blocks.size(); i++)
+		BOOST_REQUIRE( ar->free(blocks[i]) );
+	delete ar;
+}
+
+#endif // SO_CHUNK_PROVISIONING
@@ -0,0 +1,146 @@
+#define BOOST_TEST_MODULE chunk
+#include <boost/test/included/unit_test.hpp>
+
+#include <new>
+#include <set>
+#include <vector>
+
+#include <chunk.hpp>
+#include <sys_allocator.hpp>
+
+using smallobject::detail::chunk;
+
+static const std::size_t BLOCK_SIZE = 24;
+static const std::size_t BLOCKS = 100;
+
+// chunk constructed in its own memory, as the arena does
+class test_chunk {
+public:
+	explicit test_chunk(const std::size_t blocks):
+		size_( chunk::header_size(blocks) + BLOCK_SIZE * blocks ),
+		mem_( smallobject::sys::xmalloc_aligned(size_, SO_CACHE_LINE_SIZE) )
+	{
+		BOOST_REQUIRE( NULL != mem_ );
+		cnk_ = new (mem_) chunk( BLOCK_SIZE, blocks, static_cast<uint8_t*>(mem_) + chunk::header_size(blocks), size_ );
+	}
+	~test_chunk()
+	{
+		cnk_->~chunk();
+		smallobject::sys::xfree_aligned(mem_);
+	}
+	chunk* operator->() const
+	{
+		return cnk_;
+	}
+private:
+	const std::size_t size_;
+	void* const mem_;
+	chunk* cnk_;
+};
+
+BOOST_AUTO_TEST_CASE(released_blocks_reused_last_in_first_out)
+{
+	test_chunk cnk(BLOCKS);
+	std::vector<uint8_t*> blocks;
+	for(int i = 0; i < 10; i++)
+		blocks.push_back( cnk->allocate(BLOCK_SIZE) );
+	// released in order, taken back in reverse order
+	for(int i = 2; i < 8; i++)
+		BOOST_REQUIRE( cnk->release(blocks[i], BLOCK_SIZE) );
+	for(int i = 7; i >= 2; i--)
+		BOOST_CHECK_EQUAL( cnk->allocate(BLOCK_SIZE), blocks[i] );
+	// the free stack is empty again, next block is a never allocated one
+	BOOST_CHECK_EQUAL( cnk->allocate(BLOCK_SIZE), blocks[9] + BLOCK_SIZE );
+}
+
+BOOST_AUTO_TEST_CASE(full_and_empty_boundaries)
+{
+	test_chunk cnk(BLOCKS);
+	BOOST_CHECK( cnk->empty() );
+	BOOST_CHECK_EQUAL( cnk->free_blocks(), BLOCKS );
+	std::set<uint8_t*> blocks;
+	for(std::size_t i = 0; i < BLOCKS; i++) {
+		uint8_t* const ptr = cnk->allocate(BLOCK_SIZE);
+		BOOST_REQUIRE( NULL != ptr );
+		BOOST_REQUIRE( ptr >= cnk->begin() && ptr + BLOCK_SIZE <= cnk->end() );
+		blocks.insert(ptr);
+		BOOST_CHECK( !cnk->empty() );
+	}
+	BOOST_CHECK_EQUAL( blocks.size(), BLOCKS );
+	BOOST_CHECK_EQUAL( cnk->free_blocks(), 0u );
+	// full chunk
+	BOOST_CHECK( NULL == cnk->allocate(BLOCK_SIZE) );
+	BOOST_CHECK_EQUAL( cnk->free_blocks(), 0u );
+	// one block released makes room for exactly one allocation
+	uint8_t* const last = *blocks.rbegin();
+	BOOST_REQUIRE( cnk->release(last, BLOCK_SIZE) );
+	BOOST_CHECK_EQUAL( cnk->free_blocks(), 1u );
+	BOOST_CHECK_EQUAL( cnk->allocate(BLOCK_SIZE), last );
+	BOOST_CHECK( NULL == cnk->allocate(BLOCK_SIZE) );
+	std::size_t released = 0;
+	for(std::set<uint8_t*>::iterator it = blocks.begin(); it != blocks.end(); ++it) {
+		BOOST_REQUIRE( cnk->release(*it, BLOCK_SIZE) );
+		BOOST_CHECK_EQUAL( cnk->empty(), ++released == BLOCKS );
+	}
+	BOOST_CHECK_EQUAL( cnk->free_blocks(), BLOCKS );
+}
+
+BOOST_AUTO_TEST_CASE(release_rejects_foreign_pointers)
+{
+	test_chunk cnk(BLOCKS);
+	uint8_t* const first = cnk->allocate(BLOCK_SIZE);
+	BOOST_REQUIRE_EQUAL( first, cnk->begin() );
+	const uint8_t* const begin = cnk->begin();
+	const uint8_t* const end = cnk->end();
+	BOOST_CHECK_EQUAL( end, begin + BLOCKS * BLOCK_SIZE );
+	// right before the first block, at the end and past it
+	BOOST_CHECK( !cnk->release(begin - 1, BLOCK_SIZE) );
+	BOOST_CHECK( !cnk->release(begin - BLOCK_SIZE, BLOCK_SIZE) );
+	BOOST_CHECK( !cnk->release(end, BLOCK_SIZE) );
+	BOOST_CHECK( !cnk->release(end + BLOCK_SIZE, BLOCK_SIZE) );
+	BOOST_CHECK( !cnk->release_remote(begin - 1, BLOCK_SIZE) );
+	BOOST_CHECK( !cnk->release_remote(end, BLOCK_SIZE) );
+	// nothing was taken
+	BOOST_CHECK_EQUAL( cnk->free_blocks(), BLOCKS - 1 );
+	// the last byte of the last block belongs to the chunk
+	uint8_t* last = NULL;
+	while( cnk->free_blocks() > 0 )
+		last = cnk->allocate(BLOCK_SIZE);
+	BOOST_REQUIRE( cnk->release(last + BLOCK_SIZE - 1, BLOCK_SIZE) );
+	BOOST_CHECK_EQUAL( cnk->allocate(BLOCK_SIZE), last );
+	BOOST_REQUIRE( cnk->release(first, BLOCK_SIZE) );
+}
+
+BOOST_AUTO_TEST_CASE(bump_exhausted_freed_out_of_order_and_reset)
+{
+	test_chunk cnk(BLOCKS);
+	// bump pointer hands out the blocks one after another
+	std::vector<uint8_t*> blocks;
+	for(std::size_t i = 0; i < BLOCKS; i++) {
+		uint8_t* const ptr = cnk->allocate(BLOCK_SIZE);
+		BOOST_REQUIRE_EQUAL( ptr, cnk->begin() + i * BLOCK_SIZE );
+		blocks.push_back(ptr);
+	}
+	BOOST_CHECK( NULL == cnk->allocate(BLOCK_SIZE) );
+	// every third block, then every odd one, i.e. not in address order
+	std::vector<uint8_t*> released;
+	for(std::size_t i = 0; i < BLOCKS; i += 3)
+		released.push_back(blocks[i]);
+	for(std::size_t i = 1; i < BLOCKS; i += 2)
+		if( 0 != i % 3 )
+			released.push_back(blocks[i]);
+	for(std::size_t i = 0; i < released.size(); i++)
+		BOOST_REQUIRE( cnk->release(released[i], BLOCK_SIZE) );
+	BOOST_CHECK_EQUAL( cnk->free_blocks(), released.size() );
+	// exhausted bump pointer, so reallocation comes from the free stack only
+	for(std::size_t i = released.size(); i > 0; i--)
+		BOOST_CHECK_EQUAL( cnk->allocate(BLOCK_SIZE), released[i - 1] );
+	BOOST_CHECK( NULL == cnk->allocate(BLOCK_SIZE) );
+	// reset forgets both the allocated blocks and the free stack
+	cnk->reset();
+	BOOST_CHECK( cnk->empty() );
+	BOOST_CHECK_EQUAL( cnk->free_blocks(), BLOCKS );
+	for(std::size_t i = 0; i < BLOCKS; i++)
+		BOOST_REQUIRE_EQUAL( cnk->allocate(BLOCK_SIZE), cnk->begin() + i * BLOCK_SIZE );
+	BOOST_CHECK( NULL == cnk->allocate(BLOCK_SIZE) );
+}
@@ -0,0 +1,69 @@
+#ifndef __SMALL_OBJECT_TEST_COUNTING_ALLOCATOR_HPP_INCLUDED__
+#define __SMALL_OBJECT_TEST_COUNTING_ALLOCATOR_HPP_INCLUDED__
+
+#include <cstddef>
+#include <new>
+
+#include <boost/config.hpp>
+
+// counts outstanding blocks, and throws std::bad_alloc on the allocation number fail_at,
+// template only to define the counters in the header
+template<int N = 0>
+struct basic_allocation_counter {
+	static long outstanding;
+	static long allocations;
+	static long fail_at;
+};
+template<int N>
+long basic_allocation_counter<N>::outstanding = 0;
+template<int N>
+long basic_allocation_counter<N>::allocations = 0;
+template<int N>
+long basic_allocation_counter<N>::fail_at = -1;
+
+typedef basic_allocation_counter<> allocation_counter;
+
+/// Allocator of the containers under test, fails on request and counts leaks
+template<typename T>
+class counting_allocator {
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	template<typename U>
+	struct rebind {
+		typedef counting_allocator<U> other;
+	};
+	counting_allocator() BOOST_NOEXCEPT_OR_NOTHROW
+	{}
+	template<typename U>
+	counting_allocator(const counting_allocator<U>&) BOOST_NOEXCEPT_OR_NOTHROW
+	{}
+	pointer allocate(const std::size_t n) {
+		if( allocation_counter::fail_at == allocation_counter::allocations++ )
+			throw std::bad_alloc();
+		++allocation_counter::outstanding;
+		return static_cast<pointer>( ::operator new( n * sizeof(T) ) );
+	}
+	void deallocate(pointer p, std::size_t) {
+		--allocation_counter::outstanding;
+		::operator delete(p);
+	}
+	void destroy(pointer p) {
+		p->~T();
+	}
+	bool operator==(const counting_allocator&) const {
+		return true;
+	}
+	bool operator!=(const counting_allocator&) const {
+		return false;
+	}
+};
+
+// inserts range [min, max] mapped to the value
+template<class M>
+inline bool add(M& map, const int min, const int max, const int value)
+{
+	return map.insert( int(min), int(max), int(value) );
+}
+
+#endif // __SMALL_OBJECT_TEST_COUNTING_ALLOCATOR_HPP_INCLUDED__
@@ -0,0 +1,111 @@
+#define BOOST_TEST_MODULE distributed_rwb
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <distributed_rwb.hpp>
+
+using smallobject::sys::distributed_read_write_barrier;
+
+// more threads than reader slots, so that some slots are shared
+static const int READERS = _SOBJ_RWB_SLOTS + 4;
+static const int WRITERS = 3;
+static const int ITERATIONS = 20000;
+
+struct shared_state {
+	distributed_read_write_barrier barrier;
+	boost::atomic_int readers;
+	boost::atomic_int writers;
+	boost::atomic_int violations;
+	// written under the write lock only, readers check both halves are equal
+	long first;
+	long second;
+	shared_state():
+		barrier(),
+		readers(0),
+		writers(0),
+		violations(0),
+		first(0),
+		second(0)
+	{}
+};
+
+static void reader(shared_state* const s)
+{
+	for(int i = 0; i < ITERATIONS; i++) {
+		s->barrier.read_lock();
+		s->readers.fetch_add(1, boost::memory_order_relaxed);
+		if( 0 != s->writers.load(boost::memory_order_relaxed) || s->first != s->second )
+			s->violations.fetch_add(1, boost::memory_order_relaxed);
+		if( 0 == (i & 255) )
+			boost::this_thread::yield();
+		s->readers.fetch_sub(1, boost::memory_order_relaxed);
+		s->barrier.read_unlock();
+	}
+}
+
+static void writer(shared_state* const s)
+{
+	for(int i = 0; i < ITERATIONS / 10; i++) {
+		s->barrier.write_lock();
+		if( 0 != s->writers.fetch_add(1, boost::memory_order_relaxed) || 0 != s->readers.load(boost::memory_order_relaxed) )
+			s->violations.fetch_add(1, boost::memory_order_relaxed);
+		++s->first;
+		if( 0 == (i & 15) )
+			boost::this_thread::yield();
+		++s->second;
+		s->writers.fetch_sub(1, boost::memory_order_relaxed);
+		s->barrier.write_unlock();
+	}
+}
+
+static void read_and_flag(distributed_read_write_barrier* const barrier, boost::atomic_bool* const entered)
+{
+	barrier->read_lock();
+	entered->store(true, boost::memory_order_release);
+	barrier->read_unlock();
+}
+
+BOOST_AUTO_TEST_CASE(readers_and_writers_excluded)
+{
+	shared_state s;
+	boost::thread_group group;
+	for(int i = 0; i < READERS; i++)
+		group.create_thread( boost::bind(&reader, &s) );
+	for(int i = 0; i < WRITERS; i++)
+		group.create_thread( boost::bind(&writer, &s) );
+	group.join_all();
+	BOOST_CHECK_EQUAL( s.violations.load(), 0 );
+	BOOST_CHECK_EQUAL( s.first, static_cast<long>(WRITERS) * (ITERATIONS / 10) );
+	BOOST_CHECK_EQUAL( s.first, s.second );
+}
+
+BOOST_AUTO_TEST_CASE(readers_share_the_barrier)
+{
+	distributed_read_write_barrier barrier;
+	boost::atomic_bool entered(false);
+	barrier.read_lock();
+	// another reader enters while this thread holds a read lock
+	boost::thread other( boost::bind(&read_and_flag, &barrier, &entered) );
+	BOOST_REQUIRE( other.timed_join( boost::posix_time::seconds(10) ) );
+	BOOST_CHECK( entered.load(boost::memory_order_acquire) );
+	barrier.read_unlock();
+}
+
+BOOST_AUTO_TEST_CASE(writer_blocks_readers)
+{
+	distributed_read_write_barrier barrier;
+	boost::atomic_bool entered(false);
+	barrier.write_lock();
+	boost::thread other( boost::bind(&read_and_flag, &barrier, &entered) );
+	boost::this_thread::sleep( boost::posix_time::milliseconds(100) );
+	BOOST_CHECK( !entered.load(boost::memory_order_acquire) );
+	barrier.write_unlock();
+	BOOST_REQUIRE( other.timed_join( boost::posix_time::seconds(10) ) );
+	BOOST_CHECK( entered.load(boost::memory_order_acquire) );
+	// reader left, writer enters again
+	barrier.write_lock();
+	barrier.write_unlock();
+}
@@ -0,0 +1,165 @@
+#define BOOST_TEST_MODULE epoch
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <epoch.hpp>
+#include <object.hpp>
+
+using smallobject::epoch_domain;
+using smallobject::basic_object;
+using smallobject::deferred_ref_count;
+
+static boost::atomic_int deleted(0);
+
+static void count_deleted(void*)
+{
+	deleted.fetch_add(1, boost::memory_order_relaxed);
+}
+
+class deferred_object: public basic_object<deferred_ref_count> {
+public:
+	deferred_object():
+		basic_object<deferred_ref_count>()
+	{}
+	virtual ~deferred_object() BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		deleted.fetch_add(1, boost::memory_order_relaxed);
+	}
+};
+
+typedef boost::intrusive_ptr<deferred_object> s_deferred_object;
+
+struct reader_state {
+	epoch_domain* domain;
+	boost::atomic_bool inside;
+	boost::atomic_bool leave;
+	explicit reader_state(epoch_domain& d):
+		domain(&d),
+		inside(false),
+		leave(false)
+	{}
+};
+
+static void hold_guard(reader_state* const s)
+{
+	epoch_domain::guard guard(*s->domain);
+	s->inside.store(true, boost::memory_order_release);
+	while( !s->leave.load(boost::memory_order_acquire) )
+		boost::this_thread::yield();
+}
+
+BOOST_AUTO_TEST_CASE(retired_after_two_advances)
+{
+	deleted = 0;
+	epoch_domain domain;
+	int value = 0;
+	domain.retire(&value, &count_deleted);
+	domain.collect();
+	BOOST_CHECK_EQUAL( deleted.load(), 0 );
+	domain.collect();
+	BOOST_CHECK_EQUAL( deleted.load(), 1 );
+}
+
+BOOST_AUTO_TEST_CASE(reader_delays_reclamation)
+{
+	deleted = 0;
+	epoch_domain domain;
+	reader_state s(domain);
+	boost::thread reader( boost::bind(&hold_guard, &s) );
+	while( !s.inside.load(boost::memory_order_acquire) )
+		boost::this_thread::yield();
+	int value = 0;
+	domain.retire(&value, &count_deleted);
+	for(int i = 0; i < 10; i++)
+		domain.collect();
+	// reader may still see the pointer
+	BOOST_CHECK_EQUAL( deleted.load(), 0 );
+	s.leave.store(true, boost::memory_order_release);
+	reader.join();
+	domain.collect();
+	domain.collect();
+	BOOST_CHECK_EQUAL( deleted.load(), 1 );
+}
+
+BOOST_AUTO_TEST_CASE(domain_destructor_releases_limbo)
+{
+	deleted = 0;
+	{
+		epoch_domain domain;
+		int values[3];
+		for(int i = 0; i < 3; i++)
+			domain.retire(&values[i], &count_deleted);
+	}
+	BOOST_CHECK_EQUAL( deleted.load(), 3 );
+}
+
+struct retiring_thread {
+	epoch_domain* domain;
+	int* values;
+	epoch_domain::retired_hook* hooks;
+};
+
+static void retire_and_exit(retiring_thread* const t)
+{
+	for(int i = 0; i < 3; i++) {
+		t->domain->retire(&t->values[i], &count_deleted);
+		t->domain->retire(&t->hooks[i], &count_deleted);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(exited_thread_limbo_reclaimed_by_collect)
+{
+	deleted = 0;
+	epoch_domain domain;
+	// the collecting thread has its own record, the exited thread record stays free
+	domain.collect();
+	int values[3];
+	epoch_domain::retired_hook hooks[3];
+	retiring_thread t = { &domain, values, hooks };
+	boost::thread( boost::bind(&retire_and_exit, &t) ).join();
+	domain.collect();
+	domain.collect();
+	BOOST_CHECK_EQUAL( deleted.load(), 6 );
+}
+
+BOOST_AUTO_TEST_CASE(deferred_object_reclaimed_after_two_advances)
+{
+	epoch_domain* const domain = epoch_domain::instance();
+	// flush objects retired before
+	domain->collect();
+	domain->collect();
+	deleted = 0;
+	{
+		s_deferred_object obj( new deferred_object() );
+		s_deferred_object copy(obj);
+	}
+	BOOST_CHECK_EQUAL( deleted.load(), 0 );
+	domain->collect();
+	BOOST_CHECK_EQUAL( deleted.load(), 0 );
+	domain->collect();
+	BOOST_CHECK_EQUAL( deleted.load(), 1 );
+}
+
+BOOST_AUTO_TEST_CASE(deferred_object_read_inside_guard)
+{
+	epoch_domain* const domain = epoch_domain::instance();
+	deleted = 0;
+	reader_state s(*domain);
+	boost::thread reader( boost::bind(&hold_guard, &s) );
+	while( !s.inside.load(boost::memory_order_acquire) )
+		boost::this_thread::yield();
+	// many releases, so that the collect threshold is crossed by the releasing thread
+	for(int i = 0; i < 200; i++)
+		s_deferred_object( new deferred_object() );
+	domain->collect();
+	domain->collect();
+	BOOST_CHECK_EQUAL( deleted.load(), 0 );
+	s.leave.store(true, boost::memory_order_release);
+	reader.join();
+	domain->collect();
+	domain->collect();
+	BOOST_CHECK_EQUAL( deleted.load(), 200 );
+}
@@ -0,0 +1,154 @@
+#define BOOST_TEST_MODULE flat_range_map
+#include <boost/test/included/unit_test.hpp>
+
+#include <vector>
+
+#include <sys_allocator.hpp>
+#include <flat_range_map.hpp>
+
+#include "counting_allocator.hpp"
+
+using smallobject::flat_range_map;
+using smallobject::movable_pair;
+using smallobject::range;
+
+typedef flat_range_map<int, int> int_map;
+typedef int_map::value_type int_value;
+
+typedef flat_range_map<int, int, std::less<int>, counting_allocator< movable_pair< const range<int, std::less<int> >, int > > > counted_map;
+
+static bool is_odd(const int_value& v)
+{
+	return 0 != (v.second & 1);
+}
+
+BOOST_AUTO_TEST_CASE(insert_and_find)
+{
+	int_map map;
+	BOOST_CHECK( map.empty() );
+	// inserted out of order
+	BOOST_CHECK( add(map, 20, 29, 2) );
+	BOOST_CHECK( add(map, 0, 9, 0) );
+	BOOST_CHECK( add(map, 10, 19, 1) );
+	BOOST_CHECK_EQUAL( map.size(), 3u );
+	for(int key = 0; key < 30; key++) {
+		int_map::iterator it = map.find(key);
+		BOOST_REQUIRE( it != map.end() );
+		BOOST_CHECK_EQUAL( it->second, key / 10 );
+	}
+	BOOST_CHECK( map.find(-1) == map.end() );
+	BOOST_CHECK( map.find(30) == map.end() );
+}
+
+BOOST_AUTO_TEST_CASE(iteration_is_sorted)
+{
+	int_map map;
+	for(int i = 99; i >= 0; i--)
+		BOOST_REQUIRE( add(map, i * 10, i * 10 + 5, i) );
+	int expected = 0;
+	for(int_map::iterator it = map.begin(); it != map.end(); ++it)
+		BOOST_CHECK_EQUAL( it->second, expected++ );
+	BOOST_CHECK_EQUAL( expected, 100 );
+	// gaps between the ranges are not found
+	BOOST_CHECK( map.find(7) == map.end() );
+}
+
+BOOST_AUTO_TEST_CASE(overlap_rejected)
+{
+	int_map map;
+	BOOST_REQUIRE( add(map, 10, 20, 1) );
+	// same range, range inside and range around an existing one
+	BOOST_CHECK( !add(map, 10, 20, 2) );
+	BOOST_CHECK( !add(map, 12, 15, 2) );
+	BOOST_CHECK( !add(map, 10, 15, 2) );
+	BOOST_CHECK( !add(map, 0, 30, 2) );
+	BOOST_CHECK_EQUAL( map.size(), 1u );
+	BOOST_CHECK_EQUAL( map.find(15)->second, 1 );
+	BOOST_CHECK( add(map, 21, 25, 2) );
+	BOOST_CHECK( add(map, 0, 9, 0) );
+	BOOST_CHECK_EQUAL( map.size(), 3u );
+	BOOST_CHECK( !add(map, 22, 23, 3) );
+	BOOST_CHECK( !add(map, 1, 2, 3) );
+	BOOST_CHECK_EQUAL( map.size(), 3u );
+}
+
+BOOST_AUTO_TEST_CASE(erase)
+{
+	int_map map;
+	for(int i = 0; i < 10; i++)
+		add(map, i * 10, i * 10 + 9, i);
+	map.erase( map.find(55) );
+	BOOST_CHECK_EQUAL( map.size(), 9u );
+	BOOST_CHECK( map.find(55) == map.end() );
+	BOOST_CHECK_EQUAL( map.find(65)->second, 6 );
+	BOOST_CHECK_EQUAL( map.find(45)->second, 4 );
+	// end is ignored
+	map.erase( map.end() );
+	BOOST_CHECK_EQUAL( map.size(), 9u );
+	// erased range can be inserted again
+	BOOST_CHECK( add(map, 50, 59, 5) );
+	BOOST_CHECK_EQUAL( map.find(55)->second, 5 );
+}
+
+BOOST_AUTO_TEST_CASE(erase_if)
+{
+	int_map map;
+	for(int i = 0; i < 100; i++)
+		add(map, i * 10, i * 10 + 9, i);
+	BOOST_CHECK_EQUAL( map.erase_if(&is_odd), 50u );
+	BOOST_CHECK_EQUAL( map.size(), 50u );
+	int expected = 0;
+	for(int_map::iterator it = map.begin(); it != map.end(); ++it, expected += 2)
+		BOOST_CHECK_EQUAL( it->second, expected );
+	for(int i = 0; i < 100; i++) {
+		const bool found = map.find(i * 10 + 5) != map.end();
+		BOOST_CHECK_EQUAL( found, 0 == (i & 1) );
+	}
+	BOOST_CHECK_EQUAL( map.erase_if(&is_odd), 0u );
+}
+
+BOOST_AUTO_TEST_CASE(assign)
+{
+	std::vector<int_value> source;
+	for(int i = 0; i < 100; i++)
+		source.push_back( int_value( range<int, std::less<int> >(i * 10, i * 10 + 9), i ) );
+	int_map map;
+	add(map, -10, -1, -1);
+	map.assign( source.begin(), source.end() );
+	BOOST_CHECK_EQUAL( map.size(), 100u );
+	BOOST_CHECK( map.find(-5) == map.end() );
+	for(int i = 0; i < 100; i++)
+		BOOST_CHECK_EQUAL( map.find(i * 10 + 9)->second, i );
+	// assigned map accepts inserts between the ranges
+	BOOST_CHECK( add(map, 1000, 1009, 100) );
+	BOOST_CHECK( !add(map, 992, 995, 100) );
+}
+
+BOOST_AUTO_TEST_CASE(grow_failure_does_not_leak)
+{
+	allocation_counter::allocations = 0;
+	allocation_counter::fail_at = 1;
+	{
+		counted_map map;
+		// first growth allocates keys, then fails on values
+		BOOST_CHECK_THROW( add(map, 0, 9, 0), std::bad_alloc );
+		BOOST_CHECK( map.empty() );
+		BOOST_CHECK_EQUAL( allocation_counter::outstanding, 0 );
+		allocation_counter::fail_at = -1;
+		for(int i = 0; i < 100; i++)
+			BOOST_REQUIRE( add(map, i * 10, i * 10 + 9, i) );
+		// a failure in the middle of growth keeps the content
+		allocation_counter::fail_at = allocation_counter::allocations + 1;
+		for(int i = 100; i < 1000; i++) {
+			try {
+				add(map, i * 10, i * 10 + 9, i);
+			} catch(std::bad_alloc&) {
+				break;
+			}
+		}
+		allocation_counter::fail_at = -1;
+		for(std::size_t i = 0; i < map.size(); i++)
+			BOOST_CHECK_EQUAL( map.find( static_cast<int>(i) * 10 )->second, static_cast<int>(i) );
+	}
+	BOOST_CHECK_EQUAL( allocation_counter::outstanding, 0 );
+}
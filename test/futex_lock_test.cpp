@@ -0,0 +1,100 @@
+#define BOOST_TEST_MODULE futex_lock
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <critical_section.hpp>
+
+// futex_lock on Linux, the platform spin lock otherwise
+typedef smallobject::sys::critical_section lock_type;
+
+static const int THREADS = 8;
+static const int ITERATIONS = 100000;
+
+struct shared_counter {
+	lock_type lock;
+	// not atomic, lost updates show broken mutual exclusion
+	long value;
+	// count of threads inside the critical section
+	boost::atomic_int inside;
+	boost::atomic_int violations;
+	shared_counter():
+		lock(),
+		value(0),
+		inside(0),
+		violations(0)
+	{}
+};
+
+static void increment(shared_counter* const c)
+{
+	for(int i = 0; i < ITERATIONS; i++) {
+		c->lock.lock();
+		if( 0 != c->inside.fetch_add(1, boost::memory_order_relaxed) )
+			c->violations.fetch_add(1, boost::memory_order_relaxed);
+		++c->value;
+		// give the scheduler a chance to preempt the owner inside the section
+		if( 0 == (i & 1023) )
+			boost::this_thread::yield();
+		c->inside.fetch_sub(1, boost::memory_order_relaxed);
+		c->lock.unlock();
+	}
+}
+
+static void try_lock_from_other(lock_type* const lock, bool* const acquired)
+{
+	*acquired = lock->try_lock();
+	if(*acquired)
+		lock->unlock();
+}
+
+static void lock_and_flag(lock_type* const lock, boost::atomic_bool* const entered)
+{
+	lock->lock();
+	entered->store(true, boost::memory_order_release);
+	lock->unlock();
+}
+
+BOOST_AUTO_TEST_CASE(mutual_exclusion)
+{
+	shared_counter c;
+	boost::thread_group group;
+	for(int i = 0; i < THREADS; i++)
+		group.create_thread( boost::bind(&increment, &c) );
+	group.join_all();
+	BOOST_CHECK_EQUAL( c.value, static_cast<long>(THREADS) * ITERATIONS );
+	BOOST_CHECK_EQUAL( c.violations.load(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE(try_lock)
+{
+	lock_type lock;
+	BOOST_REQUIRE( lock.try_lock() );
+	bool acquired = true;
+	boost::thread( boost::bind(&try_lock_from_other, &lock, &acquired) ).join();
+	BOOST_CHECK( !acquired );
+	lock.unlock();
+	boost::thread( boost::bind(&try_lock_from_other, &lock, &acquired) ).join();
+	BOOST_CHECK( acquired );
+	BOOST_CHECK( lock.try_lock() );
+	lock.unlock();
+}
+
+BOOST_AUTO_TEST_CASE(parked_waiter_woken_on_unlock)
+{
+	lock_type lock;
+	boost::atomic_bool entered(false);
+	lock.lock();
+	boost::thread waiter( boost::bind(&lock_and_flag, &lock, &entered) );
+	// long enough for the waiter to run out of spinning and park
+	boost::this_thread::sleep( boost::posix_time::milliseconds(100) );
+	BOOST_CHECK( !entered.load(boost::memory_order_acquire) );
+	lock.unlock();
+	BOOST_REQUIRE( waiter.timed_join( boost::posix_time::seconds(10) ) );
+	BOOST_CHECK( entered.load(boost::memory_order_acquire) );
+	// lock left unlocked after the contended hand off
+	BOOST_CHECK( lock.try_lock() );
+	lock.unlock();
+}
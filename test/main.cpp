@@ -134,7 +134,7 @@ static const size_t OBJECTS_COUNT = ((1 << 20) * 32)  / TOTAL_TEST_SIZE;
 static const size_t TESTS_COUNT = 16;
 
 template<class W, class B, class P>
-void BOOST_NOINLINE initialize(W* w, B *b, P *p, W* w1) {
+void BOOST_NOINLINE initialize(W*& w, B*& b, P*& p, W*& w1) {
 	w = new W();
 	b = new B();
 	p = new P();
@@ -151,11 +151,6 @@ void BOOST_NOINLINE release(W* w, B *b, P *p, W* w1) {
 	delete w1;
 }
 
-#if defined( __GNUC__) && ! defined( __clang__)
-#pragma GCC push_options
-#pragma GCC optimize ("O0")
-#endif // __GNUC__
-
 void BOOST_NOINLINE so_routine()
 {
 	Widget* w[2] = {nullptr,nullptr};
@@ -179,16 +174,13 @@ void BOOST_NOINLINE libc_routine()
 	}
 }
 
-#if defined( __GNUC__) && ! defined( __clang__)
-#pragma GCC pop_options
-#endif // __GNUC__
-
 typedef void (*routine_f)();
 typedef double (*benchmark_f)(routine_f);
 
 double multi_threads_benchmark(routine_f routine) {
 	auto start = std::chrono::steady_clock::now();
-	std::vector<std::thread> workers(THREADS);
+	std::vector<std::thread> workers;
+	workers.reserve(THREADS);
 	for(size_t i=0; i < THREADS; i++) {
 		workers.push_back( std::thread( std::bind( routine ) ) );
 	}
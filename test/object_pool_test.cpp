@@ -0,0 +1,136 @@
+#define BOOST_TEST_MODULE object_pool
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstring>
+#include <set>
+#include <stdexcept>
+
+#include <object_pool.hpp>
+
+using smallobject::object_pool;
+
+static int constructed = 0;
+static int destroyed = 0;
+
+// the largest size class
+struct widget {
+	char payload[ smallobject::detail::object_allocator::MAX_SIZE - sizeof(int) ];
+	int tag;
+	widget():
+		tag(0)
+	{
+		std::memset(payload, 0x5A, sizeof(payload));
+		++constructed;
+	}
+	~widget()
+	{
+		++destroyed;
+	}
+};
+
+static bool fail_construct = false;
+
+struct fragile {
+	std::size_t value;
+	fragile():
+		value(42)
+	{
+		if(fail_construct)
+			throw std::runtime_error("constructor failure");
+	}
+};
+
+static void reset_counters()
+{
+	constructed = 0;
+	destroyed = 0;
+}
+
+BOOST_AUTO_TEST_CASE(construct_and_destroy)
+{
+	reset_counters();
+	{
+		object_pool<widget> pool;
+		std::set<widget*> objects;
+		for(int i = 0; i < 1000; i++) {
+			widget* w = pool.create();
+			BOOST_REQUIRE( NULL != w );
+			BOOST_CHECK_EQUAL( w->tag, 0 );
+			BOOST_CHECK_EQUAL( w->payload[0], 0x5A );
+			w->tag = i;
+			// every object has its own memory
+			BOOST_REQUIRE( objects.insert(w).second );
+		}
+		BOOST_CHECK_EQUAL( constructed, 1000 );
+		for(std::set<widget*>::iterator it = objects.begin(); it != objects.end(); ++it)
+			pool.destroy(*it);
+		BOOST_CHECK_EQUAL( destroyed, 1000 );
+		BOOST_CHECK_EQUAL( pool.cached(), 0u );
+	}
+	BOOST_CHECK_EQUAL( destroyed, 1000 );
+}
+
+BOOST_AUTO_TEST_CASE(cache_reuse)
+{
+	reset_counters();
+	{
+		object_pool<widget> pool(4);
+		widget* objects[6];
+		for(int i = 0; i < 6; i++)
+			objects[i] = pool.create();
+		for(int i = 0; i < 6; i++)
+			pool.destroy(objects[i]);
+		// cache keeps 4 constructed objects, the rest is destroyed
+		BOOST_CHECK_EQUAL( pool.cached(), 4u );
+		BOOST_CHECK_EQUAL( destroyed, 2 );
+		// cached objects are returned without construction, the last cached first
+		for(int i = 3; i >= 0; i--)
+			BOOST_CHECK_EQUAL( pool.create(), objects[i] );
+		BOOST_CHECK_EQUAL( constructed, 6 );
+		BOOST_CHECK_EQUAL( pool.cached(), 0u );
+		widget* w = pool.create();
+		BOOST_CHECK_EQUAL( constructed, 7 );
+		pool.destroy(w);
+		for(int i = 0; i < 4; i++)
+			pool.destroy(objects[i]);
+		BOOST_CHECK_EQUAL( pool.cached(), 4u );
+		BOOST_CHECK_EQUAL( destroyed, 3 );
+	}
+	// destructor purges the cache
+	BOOST_CHECK_EQUAL( destroyed, 7 );
+}
+
+BOOST_AUTO_TEST_CASE(purge)
+{
+	reset_counters();
+	object_pool<widget> pool(100);
+	widget* objects[100];
+	for(int i = 0; i < 100; i++)
+		objects[i] = pool.create();
+	for(int i = 0; i < 100; i++)
+		pool.destroy(objects[i]);
+	BOOST_CHECK_EQUAL( pool.cached(), 100u );
+	BOOST_CHECK_EQUAL( destroyed, 0 );
+	pool.purge();
+	BOOST_CHECK_EQUAL( pool.cached(), 0u );
+	BOOST_CHECK_EQUAL( destroyed, 100 );
+	// pool still allocates after its memory was returned
+	widget* w = pool.create();
+	BOOST_CHECK_EQUAL( constructed, 101 );
+	pool.destroy(w);
+}
+
+BOOST_AUTO_TEST_CASE(constructor_failure_releases_memory)
+{
+	object_pool<fragile> pool;
+	fragile* first = pool.create();
+	pool.destroy(first);
+	fail_construct = true;
+	BOOST_CHECK_THROW( pool.create(), std::runtime_error );
+	fail_construct = false;
+	// memory of the failed object is reused
+	fragile* second = pool.create();
+	BOOST_CHECK_EQUAL( second, first );
+	BOOST_CHECK_EQUAL( second->value, 42u );
+	pool.destroy(second);
+}
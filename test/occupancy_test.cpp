@@ -0,0 +1,103 @@
+#define BOOST_TEST_MODULE occupancy
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstring>
+#include <vector>
+
+#include <arena.hpp>
+#include <object_allocator.hpp>
+
+using smallobject::detail::arena;
+using smallobject::detail::object_allocator;
+using smallobject::occupancy_stat;
+
+static const std::size_t BLOCK_SIZE = 32;
+
+static occupancy_stat stat_of(arena* const ar)
+{
+	occupancy_stat stat;
+	std::memset( &stat, 0, sizeof(stat) );
+	ar->occupancy(stat);
+	return stat;
+}
+
+// count of chunks in all histogram buckets
+static std::size_t histogram_chunks(const occupancy_stat& stat)
+{
+	std::size_t result = 0;
+	for(std::size_t i = 0; i < _SOBJ_OCCUPANCY_BUCKETS; i++)
+		result += stat.histogram[i];
+	return result;
+}
+
+BOOST_AUTO_TEST_CASE(empty_chunk_in_first_bucket)
+{
+	arena* const ar = new arena(BLOCK_SIZE);
+	const occupancy_stat stat = stat_of(ar);
+	BOOST_CHECK_EQUAL( stat.arenas, 1u );
+	BOOST_CHECK_EQUAL( stat.chunks, 1u );
+	BOOST_CHECK_EQUAL( stat.empty_chunks, 1u );
+	BOOST_CHECK_EQUAL( stat.used_blocks, 0u );
+	BOOST_CHECK_EQUAL( stat.histogram[0], 1u );
+	BOOST_CHECK_EQUAL( histogram_chunks(stat), 1u );
+	delete ar;
+}
+
+BOOST_AUTO_TEST_CASE(buckets_by_share_of_used_blocks)
+{
+	arena* const ar = new arena(BLOCK_SIZE);
+	const std::size_t blocks = stat_of(ar).free_blocks;
+	BOOST_REQUIRE_GE( blocks, 2u * _SOBJ_OCCUPANCY_BUCKETS );
+	std::vector<void*> used;
+	// exactly a half of blocks used is the middle bucket
+	while( used.size() < blocks / 2 )
+		used.push_back( ar->malloc() );
+	occupancy_stat stat = stat_of(ar);
+	const std::size_t half = (blocks / 2) * _SOBJ_OCCUPANCY_BUCKETS / blocks;
+	BOOST_CHECK_EQUAL( stat.histogram[half], 1u );
+	BOOST_CHECK_EQUAL( stat.used_blocks + stat.free_blocks, blocks );
+	// a full chunk is the last bucket
+	while( used.size() < blocks )
+		used.push_back( ar->malloc() );
+	stat = stat_of(ar);
+	BOOST_CHECK_EQUAL( stat.chunks, 1u );
+	BOOST_CHECK_EQUAL( stat.free_blocks, 0u );
+	BOOST_CHECK_EQUAL( stat.histogram[_SOBJ_OCCUPANCY_BUCKETS - 1], 1u );
+	// a single block left free is not full yet
+	BOOST_REQUIRE( ar->free( used.back() ) );
+	used.pop_back();
+	stat = stat_of(ar);
+	BOOST_CHECK_EQUAL( stat.histogram[ (blocks - 1) * _SOBJ_OCCUPANCY_BUCKETS / blocks ], 1u );
+	BOOST_CHECK_EQUAL( histogram_chunks(stat), 1u );
+	for(std::size_t i = 0; i < used.size(); i++)
+		BOOST_REQUIRE( ar->free(used[i]) );
+	delete ar;
+}
+
+BOOST_AUTO_TEST_CASE(bytes_add_up)
+{
+	arena* const ar = new arena(BLOCK_SIZE);
+	std::vector<void*> used;
+	for(int i = 0; i < 10000; i++)
+		used.push_back( ar->malloc() );
+	const occupancy_stat stat = stat_of(ar);
+	BOOST_CHECK_EQUAL( stat.used_blocks, used.size() );
+	BOOST_CHECK_EQUAL( histogram_chunks(stat), stat.chunks );
+	BOOST_CHECK_EQUAL( stat.reserved_bytes, stat.header_bytes + stat.alignment_bytes + (stat.used_blocks + stat.free_blocks) * BLOCK_SIZE );
+	for(std::size_t i = 0; i < used.size(); i++)
+		BOOST_REQUIRE( ar->free(used[i]) );
+	delete ar;
+}
+
+BOOST_AUTO_TEST_CASE(size_class_out_of_range)
+{
+	object_allocator* const allocator = object_allocator::instance();
+	occupancy_stat stat;
+	std::memset( &stat, 0xFF, sizeof(stat) );
+	allocator->occupancy(object_allocator::size_classes(), stat);
+	BOOST_CHECK_EQUAL( stat.block_size, 0u );
+	BOOST_CHECK_EQUAL( stat.arenas, 0u );
+	BOOST_CHECK_EQUAL( stat.chunks, 0u );
+	allocator->occupancy(0, stat);
+	BOOST_CHECK_EQUAL( stat.block_size, 2 * sizeof(std::size_t) );
+}
@@ -0,0 +1,82 @@
+#define BOOST_TEST_MODULE perf_counters
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstring>
+#include <vector>
+
+#include <object.hpp>
+#include <perf_counters.hpp>
+
+using smallobject::perf_counters;
+using smallobject::perf_values;
+
+static bool all_zero(const perf_values& values)
+{
+	for(std::size_t i = 0; i < smallobject::PERF_COUNTERS_COUNT; i++) {
+		if(0 != values.values[i])
+			return false;
+	}
+	return true;
+}
+
+BOOST_AUTO_TEST_CASE(failed_read_returns_zeros)
+{
+	perf_values values;
+	std::memset( &values, 0xFF, sizeof(values) );
+	const bool read = perf_counters::read(values);
+	BOOST_CHECK_EQUAL( read, perf_counters::available() );
+	// i.e. no PMU in a virtual machine, or perf events are not permitted
+	if(!read)
+		BOOST_CHECK( all_zero(values) );
+}
+
+BOOST_AUTO_TEST_CASE(disabled_regions_stay_zero)
+{
+	perf_counters::reset();
+	std::vector<void*> blocks;
+	for(int i = 0; i < 1000; i++)
+		blocks.push_back( smallobject::detail::allocate_object(32) );
+	for(std::size_t i = 0; i < blocks.size(); i++)
+		smallobject::detail::release_object(blocks[i], 32);
+	for(std::size_t r = 0; r < smallobject::PERF_REGIONS_COUNT; r++) {
+		perf_values totals;
+		std::memset( &totals, 0xFF, sizeof(totals) );
+		const uint64_t calls = perf_counters::totals( static_cast<smallobject::perf_region>(r), totals );
+		if( !perf_counters::enabled() || !perf_counters::available() ) {
+			BOOST_CHECK_EQUAL( calls, 0u );
+			BOOST_CHECK( all_zero(totals) );
+		}
+	}
+	if( perf_counters::enabled() && perf_counters::available() ) {
+		perf_values totals;
+		BOOST_CHECK_EQUAL( perf_counters::totals(smallobject::ALLOCATOR_CALL_REGION, totals), 2000u );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(accumulate_and_reset)
+{
+	perf_counters::reset();
+	perf_values start;
+	perf_values end;
+	for(std::size_t i = 0; i < smallobject::PERF_COUNTERS_COUNT; i++) {
+		start.values[i] = 100 * i;
+		end.values[i] = 100 * i + i + 1;
+	}
+	perf_counters::accumulate(smallobject::SHRINK_REGION, start, end);
+	perf_counters::accumulate(smallobject::SHRINK_REGION, start, end);
+	perf_values totals;
+	BOOST_CHECK_EQUAL( perf_counters::totals(smallobject::SHRINK_REGION, totals), 2u );
+	for(std::size_t i = 0; i < smallobject::PERF_COUNTERS_COUNT; i++)
+		BOOST_CHECK_EQUAL( totals.values[i], 2 * (i + 1) );
+	perf_counters::reset();
+	BOOST_CHECK_EQUAL( perf_counters::totals(smallobject::SHRINK_REGION, totals), 0u );
+	BOOST_CHECK( all_zero(totals) );
+}
+
+BOOST_AUTO_TEST_CASE(region_names)
+{
+	BOOST_CHECK_EQUAL( perf_counters::name(smallobject::ALLOCATOR_CALL_REGION), "allocator_call" );
+	BOOST_CHECK_EQUAL( perf_counters::name(smallobject::SHRINK_REGION), "shrink" );
+	BOOST_CHECK_EQUAL( perf_counters::name(smallobject::PERF_REGIONS_COUNT), "unknown" );
+	BOOST_CHECK_EQUAL( perf_counters::name(smallobject::PERF_COUNTERS_COUNT), "unknown" );
+}
@@ -0,0 +1,165 @@
+#define BOOST_TEST_MODULE range_map
+#include <boost/test/included/unit_test.hpp>
+
+#include <vector>
+
+#include <sys_allocator.hpp>
+#include <range_map.hpp>
+
+#include "counting_allocator.hpp"
+
+using smallobject::range_map;
+using smallobject::synchronized_range_map;
+using smallobject::movable_pair;
+using smallobject::range;
+
+typedef range<int, std::less<int> > int_range;
+typedef range_map<int, int> int_map;
+typedef int_map::value_type int_value;
+
+typedef range_map<int, int, std::less<int>, counting_allocator< movable_pair< const int_range, int > > > counted_map;
+
+template<class M>
+static std::size_t count(M& map)
+{
+	std::size_t result = 0;
+	for(typename M::iterator it = map.begin(); it != map.end(); ++it)
+		++result;
+	return result;
+}
+
+// checks the map holds ranges [i*10, i*10+9] mapped to i for every value in ascending order
+template<class M>
+static void check_content(M& map, const std::vector<int>& values)
+{
+	BOOST_REQUIRE_EQUAL( count(map), values.size() );
+	std::size_t i = 0;
+	for(typename M::iterator it = map.begin(); it != map.end(); ++it, ++i)
+		BOOST_CHECK_EQUAL( it->second, values[i] );
+	for(i = 0; i < values.size(); i++) {
+		typename M::iterator it = map.find(values[i] * 10 + 5);
+		BOOST_REQUIRE( it != map.end() );
+		BOOST_CHECK_EQUAL( it->second, values[i] );
+	}
+}
+
+static bool is_odd(const int_value& v)
+{
+	return 0 != (v.second & 1);
+}
+
+static bool is_any(const int_value&)
+{
+	return true;
+}
+
+BOOST_AUTO_TEST_CASE(insert_find_erase)
+{
+	int_map map;
+	BOOST_CHECK( map.empty() );
+	std::vector<int> values;
+	// inserted out of order, so that the tree re-balances
+	for(int i = 0; i < 64; i++)
+		BOOST_REQUIRE( add(map, ( (i * 37) % 64 ) * 10, ( (i * 37) % 64 ) * 10 + 9, (i * 37) % 64 ) );
+	for(int i = 0; i < 64; i++)
+		values.push_back(i);
+	check_content(map, values);
+	BOOST_CHECK( !add(map, 100, 109, 0) );
+	BOOST_CHECK( !add(map, 102, 105, 0) );
+	map.erase( map.find(105) );
+	BOOST_CHECK( map.find(105) == map.end() );
+	values.erase( values.begin() + 10 );
+	check_content(map, values);
+}
+
+BOOST_AUTO_TEST_CASE(erase_if_keeps_order_and_lookup)
+{
+	for(int n = 0; n < 130; n += 13) {
+		int_map map;
+		std::vector<int> kept;
+		for(int i = 0; i < n; i++) {
+			add(map, i * 10, i * 10 + 9, i);
+			if( 0 == (i & 1) )
+				kept.push_back(i);
+		}
+		BOOST_CHECK_EQUAL( map.erase_if(&is_odd), static_cast<std::size_t>(n / 2) );
+		check_content(map, kept);
+		// rebuilt tree accepts inserts and erases
+		for(int i = 1; i < n; i += 2)
+			BOOST_REQUIRE( add(map, i * 10, i * 10 + 9, i) );
+		std::vector<int> all;
+		for(int i = 0; i < n; i++)
+			all.push_back(i);
+		check_content(map, all);
+		BOOST_CHECK_EQUAL( map.erase_if(&is_any), static_cast<std::size_t>(n) );
+		BOOST_CHECK( map.empty() );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(assign_replaces_content)
+{
+	for(int n = 0; n < 130; n += 13) {
+		std::vector<int_value> source;
+		std::vector<int> values;
+		for(int i = 0; i < n; i++) {
+			source.push_back( int_value( int_range(i * 10, i * 10 + 9), i ) );
+			values.push_back(i);
+		}
+		int_map map;
+		add(map, -10, -1, -1);
+		map.assign( source.begin(), source.end() );
+		BOOST_CHECK( map.find(-5) == map.end() );
+		check_content(map, values);
+		BOOST_CHECK( add(map, n * 10, n * 10 + 9, n) );
+		values.push_back(n);
+		check_content(map, values);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(nodes_released)
+{
+	allocation_counter::allocations = 0;
+	allocation_counter::fail_at = -1;
+	{
+		counted_map map;
+		for(int i = 0; i < 100; i++)
+			add(map, i * 10, i * 10 + 9, i);
+		BOOST_CHECK_EQUAL( allocation_counter::outstanding, 100 );
+		map.erase_if( &is_odd );
+		BOOST_CHECK_EQUAL( allocation_counter::outstanding, 50 );
+	}
+	BOOST_CHECK_EQUAL( allocation_counter::outstanding, 0 );
+}
+
+BOOST_AUTO_TEST_CASE(assign_failure_keeps_appended_prefix)
+{
+	std::vector<int_value> source;
+	for(int i = 0; i < 100; i++)
+		source.push_back( int_value( int_range(i * 10, i * 10 + 9), i ) );
+	allocation_counter::allocations = 0;
+	allocation_counter::fail_at = 40;
+	{
+		counted_map map;
+		BOOST_CHECK_THROW( map.assign( source.begin(), source.end() ), std::bad_alloc );
+		allocation_counter::fail_at = -1;
+		// nodes appended before the failure make a valid tree
+		std::vector<int> values;
+		for(int i = 0; i < 40; i++)
+			values.push_back(i);
+		check_content(map, values);
+		BOOST_CHECK_EQUAL( allocation_counter::outstanding, 40 );
+	}
+	BOOST_CHECK_EQUAL( allocation_counter::outstanding, 0 );
+}
+
+BOOST_AUTO_TEST_CASE(synchronized_bulk_operations)
+{
+	synchronized_range_map<int, int> map;
+	std::vector<int_value> source;
+	for(int i = 0; i < 50; i++)
+		source.push_back( int_value( int_range(i * 10, i * 10 + 9), i ) );
+	map.assign( source.begin(), source.end() );
+	BOOST_CHECK_EQUAL( map.erase_if(&is_odd), 25u );
+	BOOST_CHECK( map.find(15) == map.end() );
+	BOOST_CHECK_EQUAL( map.find(25)->second, 2 );
+}
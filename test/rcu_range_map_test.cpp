@@ -0,0 +1,230 @@
+#define BOOST_TEST_MODULE rcu_range_map
+#include <boost/test/included/unit_test.hpp>
+
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <sys_allocator.hpp>
+#include <rcu_range_map.hpp>
+
+#include "counting_allocator.hpp"
+
+using smallobject::rcu_range_map;
+using smallobject::epoch_domain;
+using smallobject::movable_pair;
+using smallobject::range;
+
+typedef range<int, std::less<int> > int_range;
+typedef movable_pair< const int_range, int > int_value;
+
+typedef rcu_range_map<int, int> int_map;
+typedef rcu_range_map<int, int, std::less<int>, counting_allocator<int_value> > counted_map;
+
+struct collector {
+	std::vector<int>* values;
+	explicit collector(std::vector<int>& v):
+		values(&v)
+	{}
+	void operator()(const int_value& v) const {
+		values->push_back(v.second);
+	}
+};
+
+// checks the map holds ranges [i*10, i*10+9] mapped to i for every value in ascending order
+template<class M>
+static void check_content(const M& map, const std::vector<int>& values)
+{
+	std::vector<int> visited;
+	map.for_each( collector(visited) );
+	BOOST_REQUIRE_EQUAL( visited.size(), values.size() );
+	for(std::size_t i = 0; i < values.size(); i++) {
+		BOOST_CHECK_EQUAL( visited[i], values[i] );
+		int found = -1;
+		BOOST_REQUIRE( map.find(values[i] * 10 + 5, found) );
+		BOOST_CHECK_EQUAL( found, values[i] );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(insert_find_erase)
+{
+	epoch_domain domain;
+	int_map map(domain);
+	BOOST_CHECK( map.empty() );
+	std::vector<int> values;
+	for(int i = 0; i < 64; i++) {
+		const int v = (i * 37) % 64;
+		BOOST_REQUIRE( add(map, v * 10, v * 10 + 9, v) );
+		values.push_back(i);
+	}
+	check_content(map, values);
+	BOOST_CHECK( !add(map, 100, 109, 0) );
+	BOOST_CHECK( !add(map, 102, 105, 0) );
+	int found = -1;
+	BOOST_CHECK( !map.find(-1, found) );
+	BOOST_CHECK( !map.find(640, found) );
+	for(int i = 0; i < 64; i += 3) {
+		BOOST_REQUIRE( map.erase(i * 10 + 1) );
+		BOOST_CHECK( !map.find(i * 10 + 1, found) );
+	}
+	BOOST_CHECK( !map.erase(1) );
+	values.clear();
+	for(int i = 0; i < 64; i++)
+		if( 0 != (i % 3) )
+			values.push_back(i);
+	check_content(map, values);
+	map.clear();
+	BOOST_CHECK( map.empty() );
+}
+
+BOOST_AUTO_TEST_CASE(failed_write_keeps_published_tree)
+{
+	allocation_counter::allocations = 0;
+	allocation_counter::fail_at = -1;
+	{
+		epoch_domain domain;
+		{
+			counted_map map(domain);
+			std::vector<int> values;
+			for(int i = 0; i < 100; i += 2) {
+				add(map, i * 10, i * 10 + 9, i);
+				values.push_back(i);
+			}
+			// fail every allocation of an insert, and of an erase in turn
+			for(long skip = 0; skip < 64; skip++) {
+				allocation_counter::fail_at = allocation_counter::allocations + skip;
+				bool inserted = false;
+				try {
+					inserted = add(map, 510, 519, 51);
+				} catch(std::bad_alloc&) {
+				}
+				allocation_counter::fail_at = -1;
+				if(inserted)
+					break;
+				check_content(map, values);
+			}
+			int found = -1;
+			BOOST_REQUIRE( map.find(515, found) );
+			for(long skip = 0; skip < 64; skip++) {
+				allocation_counter::fail_at = allocation_counter::allocations + skip;
+				bool erased = false;
+				try {
+					erased = map.erase(515);
+				} catch(std::bad_alloc&) {
+				}
+				allocation_counter::fail_at = -1;
+				if(erased)
+					break;
+				BOOST_REQUIRE( map.find(515, found) );
+			}
+			BOOST_CHECK( !map.find(515, found) );
+			check_content(map, values);
+			domain.collect();
+		}
+	}
+	// retired and rolled back nodes were all released
+	BOOST_CHECK_EQUAL( allocation_counter::outstanding, 0 );
+}
+
+BOOST_AUTO_TEST_CASE(failed_clear_keeps_published_tree)
+{
+	allocation_counter::allocations = 0;
+	allocation_counter::fail_at = -1;
+	{
+		epoch_domain domain;
+		{
+			counted_map map(domain);
+			std::vector<int> values;
+			for(int i = 0; i < 200; i++) {
+				add(map, i * 10, i * 10 + 9, i);
+				values.push_back(i);
+			}
+			// retired list grows while the whole tree is collected
+			bool cleared = false;
+			for(long skip = 0; skip < 64 && !cleared; skip++) {
+				allocation_counter::fail_at = allocation_counter::allocations + skip;
+				try {
+					map.clear();
+					cleared = true;
+				} catch(std::bad_alloc&) {
+				}
+				allocation_counter::fail_at = -1;
+				if(!cleared)
+					check_content(map, values);
+			}
+			BOOST_CHECK( cleared );
+			BOOST_CHECK( map.empty() );
+			// next write does not retire the nodes of a failed clear again
+			add(map, 0, 9, 0);
+			domain.collect();
+		}
+	}
+	BOOST_CHECK_EQUAL( allocation_counter::outstanding, 0 );
+}
+
+static const int STABLE = 64;
+static const int READERS = 4;
+
+struct shared_state {
+	int_map& map;
+	boost::atomic_bool stop;
+	boost::atomic_int errors;
+	explicit shared_state(int_map& m):
+		map(m),
+		stop(false),
+		errors(0)
+	{}
+};
+
+struct order_checker {
+	int* last;
+	int* errors;
+	void operator()(const int_value& v) const {
+		if( v.second <= *last )
+			++*errors;
+		*last = v.second;
+	}
+};
+
+static void read_stable(shared_state* const s)
+{
+	while( !s->stop.load(boost::memory_order_acquire) ) {
+		// even ranges are never modified by the writer
+		for(int i = 0; i < STABLE * 2; i += 2) {
+			int found = -1;
+			if( !s->map.find(i * 10 + 5, found) || found != i )
+				s->errors.fetch_add(1, boost::memory_order_relaxed);
+		}
+		int last = -1;
+		int errors = 0;
+		order_checker check = { &last, &errors };
+		s->map.for_each(check);
+		if(0 != errors)
+			s->errors.fetch_add(errors, boost::memory_order_relaxed);
+		boost::this_thread::yield();
+	}
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_readers)
+{
+	int_map map;
+	for(int i = 0; i < STABLE * 2; i += 2)
+		add(map, i * 10, i * 10 + 9, i);
+	shared_state s(map);
+	boost::thread_group group;
+	for(int i = 0; i < READERS; i++)
+		group.create_thread( boost::bind(&read_stable, &s) );
+	// writer inserts and erases odd ranges between the stable ones
+	for(int round = 0; round < 200; round++) {
+		for(int i = 1; i < STABLE * 2; i += 2)
+			BOOST_REQUIRE( add(map, i * 10, i * 10 + 9, i) );
+		for(int i = 1; i < STABLE * 2; i += 2)
+			BOOST_REQUIRE( map.erase(i * 10) );
+		if( 0 == (round & 7) )
+			boost::this_thread::yield();
+	}
+	s.stop.store(true, boost::memory_order_release);
+	group.join_all();
+	BOOST_CHECK_EQUAL( s.errors.load(), 0 );
+}
@@ -0,0 +1,125 @@
+#define BOOST_TEST_MODULE region
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/thread/thread.hpp>
+
+#include <object.hpp>
+#include <region.hpp>
+
+using smallobject::basic_object;
+using smallobject::plain_ref_count;
+using smallobject::region;
+
+// a size class no other test object uses, so that its pool has no arenas yet
+class request_object: public basic_object<plain_ref_count> {
+public:
+	request_object():
+		basic_object<plain_ref_count>()
+	{
+		payload[0] = 1;
+	}
+	char payload[ smallobject::detail::object_allocator::MAX_SIZE - 2 * sizeof(void*) ];
+};
+
+class heap_object: public basic_object<plain_ref_count> {
+public:
+	heap_object():
+		basic_object<plain_ref_count>(),
+		value(0)
+	{}
+	std::size_t value;
+};
+
+static void delete_object(request_object* const obj)
+{
+	delete obj;
+}
+
+BOOST_AUTO_TEST_CASE(allocate_in_scope)
+{
+	region r;
+	BOOST_CHECK( NULL == region::current() );
+	request_object* objects[100];
+	{
+		region::scope scope(r);
+		BOOST_CHECK_EQUAL( region::current(), &r );
+		for(int i = 0; i < 100; i++) {
+			objects[i] = new request_object();
+			BOOST_CHECK( r.owns(objects[i]) );
+			BOOST_CHECK_EQUAL( region::owner(objects[i]), &r );
+		}
+		// deleted objects are left to the region
+		for(int i = 0; i < 50; i++)
+			delete objects[i];
+		BOOST_CHECK( r.owns(objects[0]) );
+	}
+	BOOST_CHECK( NULL == region::current() );
+	for(int i = 50; i < 100; i++)
+		BOOST_CHECK_EQUAL( objects[i]->payload[0], 1 );
+}
+
+BOOST_AUTO_TEST_CASE(delete_after_scope_ended)
+{
+	region r;
+	request_object* objects[10];
+	{
+		region::scope scope(r);
+		for(int i = 0; i < 10; i++)
+			objects[i] = new request_object();
+	}
+	// no scope is active, and no pool arena owns the memory
+	for(int i = 0; i < 5; i++) {
+		BOOST_CHECK_EQUAL( region::owner(objects[i]), &r );
+		delete objects[i];
+	}
+	// from a thread which never used the region
+	for(int i = 5; i < 10; i++)
+		boost::thread( boost::bind(&delete_object, objects[i]) ).join();
+	// memory is still owned by the region until the reset
+	BOOST_CHECK( r.owns(objects[0]) );
+	r.reset();
+	BOOST_CHECK( NULL == region::owner(objects[0]) );
+	// pools still work after the misses
+	request_object* obj = new request_object();
+	BOOST_CHECK( NULL == region::owner(obj) );
+	delete obj;
+}
+
+BOOST_AUTO_TEST_CASE(nested_scopes)
+{
+	region outer;
+	region inner;
+	region::scope outer_scope(outer);
+	heap_object* a = new heap_object();
+	{
+		region::scope inner_scope(inner);
+		heap_object* b = new heap_object();
+		BOOST_CHECK( inner.owns(b) );
+		BOOST_CHECK( !outer.owns(b) );
+		// deleted in the inner scope, owned by the outer region
+		delete a;
+		BOOST_CHECK_EQUAL( region::owner(a), &outer );
+	}
+	BOOST_CHECK_EQUAL( region::current(), &outer );
+}
+
+BOOST_AUTO_TEST_CASE(chunks_grow)
+{
+	region r;
+	const std::size_t bytes = smallobject::detail::object_allocator::MAX_SIZE;
+	const uint8_t* prev = static_cast<const uint8_t*>( r.allocate(bytes) );
+	std::size_t chunks = 1;
+	// 8 MiB of the largest blocks
+	for(int i = 0; i < 0x10000; i++) {
+		const uint8_t* ptr = static_cast<const uint8_t*>( r.allocate(bytes) );
+		if(ptr != prev + bytes)
+			++chunks;
+		prev = ptr;
+	}
+	// chunks double up to the maximum chunk size, instead of staying at the minimum
+	BOOST_CHECK_LT( chunks, 32u );
+	r.reset();
+	// chunks are reused after the reset
+	for(int i = 0; i < 0x10000; i++)
+		BOOST_REQUIRE( NULL != r.allocate(bytes) );
+}
@@ -0,0 +1,183 @@
+#define BOOST_TEST_MODULE reserve
+#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <arena.hpp>
+#include <object_allocator.hpp>
+
+using smallobject::detail::arena;
+using smallobject::detail::chunk;
+using smallobject::detail::object_allocator;
+using smallobject::occupancy_stat;
+
+// bytes of the process memory locked in RAM
+static std::size_t locked_bytes()
+{
+	std::size_t result = 0;
+	std::FILE* status = std::fopen("/proc/self/status", "r");
+	if(NULL == status)
+		return 0;
+	char line[256];
+	while( NULL != std::fgets(line, sizeof(line), status) ) {
+		unsigned long kb = 0;
+		if( 1 == std::sscanf(line, "VmLck: %lu kB", &kb) )
+			result = static_cast<std::size_t>(kb) * 1024;
+	}
+	std::fclose(status);
+	return result;
+}
+
+// whether the memory lock limit leaves room for the bytes
+static bool can_lock(const std::size_t bytes)
+{
+	struct rlimit limit;
+	if( 0 != ::getrlimit(RLIMIT_MEMLOCK, &limit) )
+		return false;
+	return RLIM_INFINITY == limit.rlim_cur || locked_bytes() + bytes <= limit.rlim_cur;
+}
+
+// minor page faults of the calling thread so far, chunk provider thread faults are not counted
+static long minor_faults()
+{
+	struct rusage usage;
+#ifdef RUSAGE_THREAD
+	if( 0 != ::getrusage(RUSAGE_THREAD, &usage) )
+#else
+	if( 0 != ::getrusage(RUSAGE_SELF, &usage) )
+#endif // RUSAGE_THREAD
+		return 0;
+	return usage.ru_minflt;
+}
+
+// chunks of a size class in all arenas
+static std::size_t chunks_count(const std::size_t size_class)
+{
+	occupancy_stat stat;
+	object_allocator::instance()->occupancy(size_class, stat);
+	return stat.chunks;
+}
+
+BOOST_AUTO_TEST_CASE(reserved_allocations_take_no_chunk_and_no_fault)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	const std::size_t size_class = 3;
+	const std::size_t size = object_allocator::MAX_SIZE - (object_allocator::size_classes() - 1 - size_class) * sizeof(std::size_t);
+	const std::size_t reserved = 10000;
+	// written before the measure, so that storing the pointers does not fault
+	std::vector<void*> blocks(reserved, static_cast<void*>(NULL) );
+	BOOST_REQUIRE( alloc->reserve(size_class, reserved) );
+	const std::size_t chunks = chunks_count(size_class);
+	const long faults = minor_faults();
+	for(std::size_t i = 0; i < reserved; i++)
+		blocks[i] = alloc->malloc(size);
+	const long taken = minor_faults() - faults;
+	BOOST_CHECK_EQUAL( chunks_count(size_class), chunks );
+	BOOST_CHECK_EQUAL( taken, 0 );
+	BOOST_CHECK( std::find(blocks.begin(), blocks.end(), static_cast<void*>(NULL)) == blocks.end() );
+	for(std::size_t i = 0; i < blocks.size(); i++)
+		BOOST_REQUIRE( alloc->free(blocks[i], size) );
+	alloc->shrink();
+}
+
+BOOST_AUTO_TEST_CASE(prepared_thread_allocations_take_no_chunk)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	const std::size_t classes = object_allocator::size_classes();
+	const std::size_t reserved = 1000;
+	BOOST_REQUIRE( alloc->prepare_thread(reserved) );
+	std::vector<std::size_t> chunks(classes);
+	for(std::size_t i = 0; i < classes; i++)
+		chunks[i] = chunks_count(i);
+	std::vector<void*> blocks(reserved * classes, static_cast<void*>(NULL) );
+	const long faults = minor_faults();
+	for(std::size_t i = 0; i < classes; i++) {
+		const std::size_t size = object_allocator::MAX_SIZE - (classes - 1 - i) * sizeof(std::size_t);
+		for(std::size_t j = 0; j < reserved; j++)
+			blocks[i * reserved + j] = alloc->malloc(size);
+	}
+	const long taken = minor_faults() - faults;
+	BOOST_CHECK_EQUAL( taken, 0 );
+	for(std::size_t i = 0; i < classes; i++) {
+		BOOST_CHECK_EQUAL( chunks_count(i), chunks[i] );
+		const std::size_t size = object_allocator::MAX_SIZE - (classes - 1 - i) * sizeof(std::size_t);
+		for(std::size_t j = 0; j < reserved; j++)
+			BOOST_REQUIRE( alloc->free(blocks[i * reserved + j], size) );
+	}
+	alloc->shrink();
+}
+
+BOOST_AUTO_TEST_CASE(reserve_rejects_unknown_size_class)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	BOOST_CHECK_THROW( alloc->reserve(object_allocator::size_classes(), 1), std::out_of_range );
+	BOOST_CHECK_THROW( alloc->reserve(static_cast<std::size_t>(-1), 1), std::out_of_range );
+}
+
+BOOST_AUTO_TEST_CASE(locked_reserve_then_grow)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	// the smallest size class, size classes step down by sizeof(std::size_t) from MAX_SIZE
+	const std::size_t size_class = 0;
+	const std::size_t size = object_allocator::MAX_SIZE - (object_allocator::size_classes() - 1) * sizeof(std::size_t);
+	const std::size_t reserved = 1000;
+	// false when the memory lock limit is low, allocation works anyway
+	const bool locked = alloc->reserve(size_class, reserved, true);
+	BOOST_TEST_MESSAGE( "reserved memory " << (locked ? "locked" : "not locked") );
+	// far more blocks than reserved, so that the arena takes new chunks
+	std::vector<void*> blocks;
+	for(std::size_t i = 0; i < reserved * 100; i++) {
+		void* const ptr = alloc->malloc(size);
+		BOOST_REQUIRE( NULL != ptr );
+		std::memset(ptr, 0x5A, size);
+		blocks.push_back(ptr);
+	}
+	for(std::size_t i = 0; i < blocks.size(); i++)
+		BOOST_REQUIRE( alloc->free(blocks[i], size) );
+	alloc->shrink();
+	void* const ptr = alloc->malloc(size);
+	BOOST_CHECK( NULL != ptr );
+	BOOST_CHECK( alloc->free(ptr, size) );
+}
+
+BOOST_AUTO_TEST_CASE(lent_chunks_locked)
+{
+	arena* const ar = new arena(object_allocator::MAX_SIZE);
+	const bool locked = ar->lock();
+	const std::size_t before = locked_bytes();
+	// every lend takes a new and larger chunk, since none of the lent chunks is reclaimed yet
+	std::vector<chunk*> lent;
+	std::size_t lent_bytes = 0;
+	bool lockable = locked;
+	for(int i = 0; i < 6; i++) {
+		chunk* const cnk = ar->lend();
+		BOOST_REQUIRE( NULL != cnk );
+		lockable = lockable && can_lock( cnk->size() );
+		std::memset( const_cast<uint8_t*>( cnk->begin() ), 0x5A, cnk->end() - cnk->begin() );
+		lent.push_back(cnk);
+		lent_bytes += cnk->size();
+	}
+	const std::size_t after = locked_bytes();
+	// VmLck is zero when the kernel does not report it
+	lockable = lockable && 0 != before;
+	if(lockable)
+		BOOST_CHECK_GE( after - before, lent_bytes );
+	else
+		BOOST_TEST_MESSAGE( "memory lock limit is too low, lent chunks lock is not checked" );
+	// reclaimed chunks are lent again
+	for(std::size_t i = 0; i < lent.size(); i++)
+		ar->reclaim( lent[i] );
+	chunk* const again = ar->lend();
+	BOOST_CHECK( std::find(lent.begin(), lent.end(), again) != lent.end() );
+	ar->reclaim(again);
+	delete ar;
+	// arena unlocks the reclaimed chunks as well
+	if(lockable)
+		BOOST_CHECK_LT( locked_bytes(), before );
+}
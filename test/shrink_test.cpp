@@ -0,0 +1,102 @@
+#define BOOST_TEST_MODULE shrink
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstring>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <object_allocator.hpp>
+
+using smallobject::detail::object_allocator;
+using smallobject::occupancy_stat;
+
+// block size of a size class
+static std::size_t size_of(const std::size_t size_class)
+{
+	return object_allocator::MAX_SIZE - (object_allocator::size_classes() - 1 - size_class) * sizeof(std::size_t);
+}
+
+static occupancy_stat stat_of(const std::size_t size_class)
+{
+	occupancy_stat stat;
+	std::memset( &stat, 0, sizeof(stat) );
+	object_allocator::instance()->occupancy(size_class, stat);
+	return stat;
+}
+
+BOOST_AUTO_TEST_CASE(drained_chunks_released)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	// every test takes its own size class, so that no other arena is counted
+	const std::size_t size_class = 5;
+	const std::size_t size = size_of(size_class);
+	std::vector<void*> live;
+	for(int i = 0; i < 50000; i++)
+		live.push_back( alloc->malloc(size) );
+	const occupancy_stat full = stat_of(size_class);
+	BOOST_REQUIRE_GT( full.chunks, 2u );
+	BOOST_CHECK_EQUAL( full.used_blocks, live.size() );
+	// older chunks are drained, the newest ones keep the rest of the live set
+	const std::size_t drained = 40000;
+	for(std::size_t i = 0; i < drained; i++)
+		BOOST_REQUIRE( alloc->free(live[i], size) );
+	const occupancy_stat before = stat_of(size_class);
+	BOOST_REQUIRE_GT( before.empty_chunks, 0u );
+	alloc->shrink();
+	const occupancy_stat after = stat_of(size_class);
+	BOOST_CHECK_EQUAL( after.empty_chunks, 0u );
+	BOOST_CHECK_EQUAL( after.chunks, before.chunks - before.empty_chunks );
+	BOOST_CHECK_EQUAL( after.used_blocks, live.size() - drained );
+	BOOST_CHECK_LT( after.reserved_bytes, before.reserved_bytes );
+	// the drained arena keeps a single empty chunk
+	for(std::size_t i = drained; i < live.size(); i++)
+		BOOST_REQUIRE( alloc->free(live[i], size) );
+	alloc->shrink();
+	const occupancy_stat drained_stat = stat_of(size_class);
+	BOOST_CHECK_EQUAL( drained_stat.arenas, 1u );
+	BOOST_CHECK_EQUAL( drained_stat.chunks, 1u );
+	BOOST_CHECK_EQUAL( drained_stat.empty_chunks, 1u );
+	BOOST_CHECK_EQUAL( drained_stat.used_blocks, 0u );
+}
+
+// allocates and releases a live set, then keeps its arena until the main thread lets it exit
+static void drain_and_wait(const std::size_t size, boost::barrier* const drained, boost::barrier* const shrunk)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	std::vector<void*> live;
+	for(int i = 0; i < 50000; i++)
+		live.push_back( alloc->malloc(size) );
+	for(std::size_t i = 0; i < live.size(); i++)
+		alloc->free(live[i], size);
+	drained->wait();
+	shrunk->wait();
+}
+
+BOOST_AUTO_TEST_CASE(live_thread_arena_skipped)
+{
+	object_allocator* const alloc = object_allocator::instance();
+	const std::size_t size_class = 6;
+	boost::barrier drained(2);
+	boost::barrier shrunk(2);
+	boost::thread owner( boost::bind(&drain_and_wait, size_of(size_class), &drained, &shrunk) );
+	drained.wait();
+	const occupancy_stat before = stat_of(size_class);
+	BOOST_REQUIRE_EQUAL( before.arenas, 1u );
+	BOOST_REQUIRE_GT( before.empty_chunks, 1u );
+	BOOST_CHECK_EQUAL( before.used_blocks, 0u );
+	// the owner thread is alive and reads its chunks without a lock
+	alloc->shrink();
+	const occupancy_stat skipped = stat_of(size_class);
+	BOOST_CHECK_EQUAL( skipped.chunks, before.chunks );
+	BOOST_CHECK_EQUAL( skipped.empty_chunks, before.empty_chunks );
+	shrunk.wait();
+	// arena is shrunk on the owner thread exit
+	owner.join();
+	const occupancy_stat exited = stat_of(size_class);
+	BOOST_CHECK_EQUAL( exited.arenas, 1u );
+	BOOST_CHECK_EQUAL( exited.chunks, 1u );
+	BOOST_CHECK_EQUAL( exited.empty_chunks, 1u );
+}